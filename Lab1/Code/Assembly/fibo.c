@@ -1,10 +1,13 @@
 /*
  * SP ASM: Simple Processor assembler
  *
- * usage: fibo
+ * usage: fibo [-x] program_name
+ *
+ * writes hex words, one per line, or an sp executable with -x
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define ADD 0
 #define SUB 1
@@ -38,7 +41,76 @@ static void asm_cmd(int opcode, int dst, int src0, int src1, int immediate)
 	mem[pc++] = inst;
 }
 
-static void assemble_program(char *program_name)
+/*
+ * sp executable: a header, a section table and the words of the code and
+ * data sections, little endian. code is [0, code_end), data runs from the
+ * first to the last non-zero word after it, the zeros around the data are
+ * bss sections.
+ */
+#define SP_EXE_MAGIC	0x58455053	/* "SPEX" */
+#define SP_EXE_VERSION	1
+#define SP_EXE_CODE	1
+#define SP_EXE_DATA	2
+#define SP_EXE_BSS	4
+
+static void put_word(FILE *fp, unsigned int word)
+{
+	fputc(word & 0xff, fp);
+	fputc((word >> 8) & 0xff, fp);
+	fputc((word >> 16) & 0xff, fp);
+	fputc((word >> 24) & 0xff, fp);
+}
+
+int nr_sections, section_type[4], section_start[4], section_size[4];
+
+static void add_section(int type, int start, int size)
+{
+	section_type[nr_sections] = type;
+	section_start[nr_sections] = start;
+	section_size[nr_sections] = size;
+	nr_sections++;
+}
+
+static void write_exe(FILE *fp, int code_end, int last_addr)
+{
+	int first, last, offset, i, addr;
+
+	for (first = code_end; first < last_addr && !mem[first]; first++)
+		;
+	for (last = last_addr - 1; last >= first && !mem[last]; last--)
+		;
+	nr_sections = 0;
+	add_section(SP_EXE_CODE, 0, code_end);
+	if (first > code_end)
+		add_section(SP_EXE_BSS, code_end, first - code_end);
+	if (last >= first) {
+		add_section(SP_EXE_DATA, first, last + 1 - first);
+		if (last + 1 < last_addr)
+			add_section(SP_EXE_BSS, last + 1, last_addr - last - 1);
+	}
+
+	put_word(fp, SP_EXE_MAGIC);
+	put_word(fp, SP_EXE_VERSION);
+	put_word(fp, 0);			// entry
+	put_word(fp, nr_sections);
+	offset = 16 + nr_sections * 16;
+	for (i = 0; i < nr_sections; i++) {
+		put_word(fp, section_type[i]);
+		put_word(fp, section_start[i]);
+		put_word(fp, section_size[i]);
+		put_word(fp, section_type[i] == SP_EXE_BSS ? 0 : offset);
+		if (section_type[i] != SP_EXE_BSS)
+			offset += section_size[i] * 4;
+	}
+	for (i = 0; i < nr_sections; i++) {
+		if (section_type[i] == SP_EXE_BSS)
+			continue;
+		for (addr = section_start[i]; addr < section_start[i] + section_size[i]; addr++)
+			put_word(fp, mem[addr]);
+	}
+}
+
+static void assemble_program(char *program_name, int exe)
 {
 	FILE *fp;
 	int addr, i, last_addr;
@@ -70,11 +142,16 @@ static void assemble_program(char *program_name)
 
 	last_addr = 1040;
 
-	fp = fopen(program_name, "w");
+	fp = fopen(program_name, exe ? "wb" : "w");
 	if (fp == NULL) {
 		printf("couldn't open file %s\n", program_name);
 		exit(1);
 	}
+	if (exe) {
+		write_exe(fp, pc, last_addr);
+		fclose(fp);
+		return;
+	}
 	addr = 0;
 	while (addr < last_addr) {
 		fprintf(fp, "%08x\n", mem[addr]);
@@ -86,12 +163,14 @@ static void assemble_program(char *program_name)
 int main(int argc, char *argv[])
 {
 	
-	if (argc != 2){
-		printf("usage: asm program_name\n");
+	int exe = (argc == 3 && strcmp(argv[1], "-x") == 0);
+
+	if (argc != 2 && !exe){
+		printf("usage: asm [-x] program_name\n");
 		return -1;
 	}else{
-		assemble_program(argv[1]);
-		printf("SP assembler generated machine code and saved it as %s\n", argv[1]);
+		assemble_program(argv[argc - 1], exe);
+		printf("SP assembler generated %s and saved it as %s\n", exe ? "an executable" : "machine code", argv[argc - 1]);
 		return 0;
 	}
 	
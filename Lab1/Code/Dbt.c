@@ -0,0 +1,471 @@
+/*!
+******************************************************************************
+\file Dbt.c
+\date 17 October 2026
+\author Rony Kositsky & Ofir Guthman
+\brief
+    dynamic binary translation of the sp program to x86-64
+
+\details
+    native code keeps rbx on the registers, r12 on the memory, r13 on the
+    translated words map, r14 on the block entries and r15 on the context.
+    the immediate register is a constant in the code and written back on
+    every exit from a block. a block adds its length to the count on entry
+    and takes back what it didn't run when it leaves early.
+
+\par Copyright
+(c) Copyright 2021 Ofir & Rony
+\par
+ALL RIGHTS RESERVED
+*****************************************************************************/
+
+/************************************
+*      include                      *
+************************************/
+#include "Dbt.h"
+#include "Mapper.h"
+//
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__)) && !defined(ISS_NO_DBT)
+#define DBT_X86_64
+#include <sys/mman.h>
+#endif
+
+/************************************
+*      definitions                 *
+************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#define DBT_BUFFER_SIZE     (16 << 20)
+#define DBT_BLOCK_LENGTH    64
+#define DBT_BLOCK_ROOM      (16 << 10)      // code a block can take, more than DBT_BLOCK_LENGTH instructions and their stubs
+//
+// x86 registers
+#define EAX     0
+#define ECX     1
+
+#ifdef DBT_X86_64
+
+/************************************
+*       types                       *
+************************************/
+typedef enum
+{
+    DBT_CONTINUE = 0,       // at ctx pc
+    DBT_HALT,               // at ctx pc
+    DBT_INVALID,            // at ctx pc, on ctx address
+    DBT_SELF_MODIFIED       // a translated word was written, flush and continue at ctx pc
+}dbt_status_e;
+
+typedef struct
+{
+    uint32_t *registers;
+    uint32_t *memory;
+    uint8_t *code;          // non zero for translated words
+    uint8_t **blocks;       // block entry by pc
+    uint64_t count;
+    uint32_t pc;
+    uint32_t status;        // dbt_status_e
+    uint32_t address;
+}dbt_context_s;
+
+// an exit out of the block body, emitted after it
+typedef struct
+{
+    dbt_status_e status;
+    uint8_t *jump;          // rel32 of the jump to the stub
+    uint16_t pc;
+    uint32_t index;         // of the instruction in the block
+    uint32_t immediate;
+}dbt_stub_s;
+
+// enters the block, returns the exit jump to chain or NULL
+typedef uint8_t *(*dbt_enter_f)(dbt_context_s *context, uint8_t *block);
+
+/************************************
+*      variables                    *
+************************************/
+static uint8_t *gBuffer = NULL;
+static uint8_t *gEmit = NULL;
+static uint8_t *gFlushed = NULL;            // first byte after the enter and leave code
+static uint8_t *gLeave = NULL;
+static dbt_enter_f gEnter = NULL;
+static uint32_t gFlushes = 0;
+//
+static uint8_t gCode[MAX_MEMORY_SIZE];
+static uint8_t *gBlocks[MAX_MEMORY_SIZE];
+
+/************************************
+*      static functions             *
+************************************/
+static bool init(void);
+static void flush(void);
+static uint8_t *translate(const uint32_t *memory, uint16_t pc);
+static bool valid_opcode(uint32_t command);
+//
+static void emit8(uint8_t value);
+static void emit32(uint32_t value);
+static void emit64(uint64_t value);
+static uint8_t *emit_jump(uint8_t opcode2);
+static void emit_load(int reg, uint16_t source, uint32_t immediate);
+static void emit_store(int reg, uint16_t dst);
+static void emit_exit(uint16_t pc, uint32_t immediate);
+static void emit_leave(dbt_status_e status, uint16_t pc, uint32_t uncount, uint32_t immediate);
+static void patch32(uint8_t *at, uint8_t *to);
+
+/************************************
+*       API implementation          *
+************************************/
+bool Dbt_Run(uint32_t *registers, uint32_t *memory, uint16_t pc, dbt_result_s *result)
+{
+    dbt_context_s context;
+    uint8_t *block, *chain = NULL;
+    uint32_t flushes;
+
+    if (init() == false)
+        return false;
+
+    memset(&context, 0, sizeof(context));
+    context.registers = registers;
+    context.memory = memory;
+    context.code = gCode;
+    context.blocks = gBlocks;
+
+    for (;;)
+    {
+        block = gBlocks[pc];
+        if (block == NULL)
+        {
+            flushes = gFlushes;
+            block = translate(memory, pc);
+            if (flushes != gFlushes)
+                chain = NULL;               // went with the buffer
+        }
+        // the exit we came out of jumps straight here from now on
+        if (chain != NULL)
+            patch32(chain + 1, block);
+
+        context.status = DBT_CONTINUE;
+        chain = gEnter(&context, block);
+        pc = (uint16_t)context.pc;
+
+        switch (context.status)
+        {
+            case DBT_CONTINUE:
+                break;
+            case DBT_SELF_MODIFIED:
+                flush();
+                chain = NULL;
+                break;
+            default:
+                result->pc = pc;
+                result->count = context.count;
+                result->invalid = context.status == DBT_INVALID;
+                result->address = context.address;
+                return true;
+        }
+    }
+}
+
+/************************************
+* static implementation             *
+************************************/
+static bool init(void)
+{
+    if (gBuffer != NULL)
+        return true;
+
+    gBuffer = mmap(NULL, DBT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (gBuffer == MAP_FAILED)
+    {
+        gBuffer = NULL;
+        return false;
+    }
+    gEmit = gBuffer;
+
+    // enter: save the callee saved registers, load the pointers and jump to the block
+    gEnter = (dbt_enter_f)gEmit;
+    emit8(0x53);                                                        // push rbx
+    emit8(0x41); emit8(0x54);                                           // push r12
+    emit8(0x41); emit8(0x55);                                           // push r13
+    emit8(0x41); emit8(0x56);                                           // push r14
+    emit8(0x41); emit8(0x57);                                           // push r15
+    emit8(0x49); emit8(0x89); emit8(0xff);                              // mov r15, rdi
+    emit8(0x49); emit8(0x8b); emit8(0x5f); emit8(offsetof(dbt_context_s, registers));  // mov rbx, [r15 + registers]
+    emit8(0x4d); emit8(0x8b); emit8(0x67); emit8(offsetof(dbt_context_s, memory));     // mov r12, [r15 + memory]
+    emit8(0x4d); emit8(0x8b); emit8(0x6f); emit8(offsetof(dbt_context_s, code));       // mov r13, [r15 + code]
+    emit8(0x4d); emit8(0x8b); emit8(0x77); emit8(offsetof(dbt_context_s, blocks));     // mov r14, [r15 + blocks]
+    emit8(0xff); emit8(0xe6);                                           // jmp rsi
+    //
+    // leave: rax holds the exit to chain
+    gLeave = gEmit;
+    emit8(0x41); emit8(0x5f);                                           // pop r15
+    emit8(0x41); emit8(0x5e);                                           // pop r14
+    emit8(0x41); emit8(0x5d);                                           // pop r13
+    emit8(0x41); emit8(0x5c);                                           // pop r12
+    emit8(0x5b);                                                        // pop rbx
+    emit8(0xc3);                                                        // ret
+
+    gFlushed = gEmit;
+    return true;
+}
+
+static void flush(void)
+{
+    gEmit = gFlushed;
+    memset(gCode, 0, sizeof(gCode));
+    memset(gBlocks, 0, sizeof(gBlocks));
+    gFlushes++;
+}
+
+static uint8_t *translate(const uint32_t *memory, uint16_t pc)
+{
+    static dbt_stub_s stubs[2 * DBT_BLOCK_LENGTH];
+    uint32_t nrStubs = 0, length = 0;
+    uint8_t *block, *count, *notTaken;
+    bool end = false;
+    decoded_s decoded;
+    uint16_t at = pc;
+    uint32_t branchValue;
+
+    if (gEmit + DBT_BLOCK_ROOM > gBuffer + DBT_BUFFER_SIZE)
+        flush();
+
+    block = gEmit;
+    gBlocks[pc] = block;
+    // add qword [r15 + count], length
+    emit8(0x49); emit8(0x83); emit8(0x47); emit8(offsetof(dbt_context_s, count));
+    count = gEmit;
+    emit8(0);
+
+    while (end == false)
+    {
+        // an invalid opcode is reported when it runs, it starts its own block
+        if (length > 0 && valid_opcode(memory[at]) == false)
+        {
+            emit_exit(at, decoded.immediate);
+            break;
+        }
+
+        Mapper_Decode(&decoded, memory[at]);
+        gCode[at] = 1;
+        length++;
+        // like Jump(), the pc after the jump less one
+        branchValue = (uint16_t)(at + 1) - 1;
+
+        // the decoder gives a function of no effect to what can't have one
+        if (decoded.OperationFunction != decoded.opcode->OperationFunction)
+        {
+            // nothing
+        }
+        else switch (decoded.opcode->code)
+        {
+            case ADD:
+            case SUB:
+            case AND:
+            case OR:
+            case XOR:
+            case LSF:
+            case RSF:
+                emit_load(EAX, decoded.src0, decoded.immediate);
+                emit_load(ECX, decoded.src1, decoded.immediate);
+                switch (decoded.opcode->code)
+                {
+                    case ADD: emit8(0x01); emit8(0xc8); break;  // add eax, ecx
+                    case SUB: emit8(0x29); emit8(0xc8); break;  // sub eax, ecx
+                    case AND: emit8(0x21); emit8(0xc8); break;  // and eax, ecx
+                    case OR:  emit8(0x09); emit8(0xc8); break;  // or eax, ecx
+                    case XOR: emit8(0x31); emit8(0xc8); break;  // xor eax, ecx
+                    case LSF: emit8(0xd3); emit8(0xe0); break;  // shl eax, cl
+                    default:  emit8(0xd3); emit8(0xe8); break;  // shr eax, cl
+                }
+                emit_store(EAX, decoded.dst);
+                break;
+
+            case LHI:
+                emit_load(EAX, decoded.dst, decoded.immediate);
+                emit8(0x25); emit32(0x0000ffff);                // and eax, 0xffff
+                emit8(0x0d); emit32(decoded.immediate << 16);   // or eax, immediate << 16
+                emit_store(EAX, decoded.dst);
+                break;
+
+            case LD:
+            case ST:
+                emit_load(ECX, decoded.src1, decoded.immediate);
+                emit8(0x81); emit8(0xf9); emit32(MAX_MEMORY_SIZE - 1);  // cmp ecx, MAX_MEMORY_SIZE - 1
+                stubs[nrStubs] = (dbt_stub_s){ DBT_INVALID, emit_jump(0x87), at, length - 1, decoded.immediate };   // ja
+                nrStubs++;
+                if (decoded.opcode->code == LD)
+                {
+                    emit8(0x41); emit8(0x8b); emit8(0x04); emit8(0x8c);         // mov eax, [r12 + rcx * 4]
+                    emit_store(EAX, decoded.dst);
+                    break;
+                }
+                emit_load(EAX, decoded.src0, decoded.immediate);
+                emit8(0x41); emit8(0x89); emit8(0x04); emit8(0x8c);             // mov [r12 + rcx * 4], eax
+                emit8(0x41); emit8(0x80); emit8(0x7c); emit8(0x0d); emit8(0); emit8(0);    // cmp byte [r13 + rcx], 0
+                stubs[nrStubs] = (dbt_stub_s){ DBT_SELF_MODIFIED, emit_jump(0x85), (uint16_t)(at + 1), length - 1, decoded.immediate };   // jne
+                nrStubs++;
+                break;
+
+            case JLT:
+            case JLE:
+            case JEQ:
+            case JNE:
+                emit_load(EAX, decoded.src0, decoded.immediate);
+                emit_load(ECX, decoded.src1, decoded.immediate);
+                emit8(0x39); emit8(0xc8);                                       // cmp eax, ecx
+                switch (decoded.opcode->code)
+                {
+                    case JLT: notTaken = emit_jump(0x83); break;                // jae
+                    case JLE: notTaken = emit_jump(0x87); break;                // ja
+                    case JEQ: notTaken = emit_jump(0x85); break;                // jne
+                    default:  notTaken = emit_jump(0x84); break;                // je
+                }
+                emit8(0xc7); emit8(0x43); emit8(4 * BRANCH_REGISTER_STORE_VALUE); emit32(branchValue);
+                emit_exit(decoded.immediate, decoded.immediate);
+                patch32(notTaken, gEmit);
+                emit_exit((uint16_t)(at + 1), decoded.immediate);
+                end = true;
+                break;
+
+            case JIN:
+                // to the block of the target if there is one, out to translate it otherwise
+                emit_load(EAX, decoded.src0, decoded.immediate);
+                emit8(0xc7); emit8(0x43); emit8(4 * BRANCH_REGISTER_STORE_VALUE); emit32(branchValue);
+                emit8(0x0f); emit8(0xb7); emit8(0xc0);                          // movzx eax, ax
+                emit8(0xc7); emit8(0x43); emit8(4 * IMMEDIATE_REGISTER); emit32(decoded.immediate);
+                emit8(0x49); emit8(0x8b); emit8(0x14); emit8(0xc6);             // mov rdx, [r14 + rax * 8]
+                emit8(0x48); emit8(0x85); emit8(0xd2);                          // test rdx, rdx
+                emit8(0x74); emit8(0x02);                                       // jz miss
+                emit8(0xff); emit8(0xe2);                                       // jmp rdx
+                emit8(0x41); emit8(0x89); emit8(0x47); emit8(offsetof(dbt_context_s, pc));    // miss: mov [r15 + pc], eax
+                emit8(0x31); emit8(0xc0);                                       // xor eax, eax
+                emit8(0xe9); emit32(0);                                         // jmp leave
+                patch32(gEmit - 4, gLeave);
+                end = true;
+                break;
+
+            default:
+                // HLT, and an invalid opcode the decoder made one
+                emit_leave(DBT_HALT, at, 0, decoded.immediate);
+                end = true;
+                break;
+        }
+
+        if (end == false && length == DBT_BLOCK_LENGTH)
+        {
+            emit_exit((uint16_t)(at + 1), decoded.immediate);
+            end = true;
+        }
+        at++;
+    }
+    *count = (uint8_t)length;
+
+    // the early exits, they take back the instructions after theirs
+    for (uint32_t i = 0; i < nrStubs; i++)
+    {
+        patch32(stubs[i].jump, gEmit);
+        if (stubs[i].status == DBT_INVALID)
+        {
+            emit8(0x41); emit8(0x89); emit8(0x4f); emit8(offsetof(dbt_context_s, address));  // mov [r15 + address], ecx
+        }
+        emit_leave(stubs[i].status, stubs[i].pc, length - 1 - stubs[i].index, stubs[i].immediate);
+    }
+    return block;
+}
+
+static bool valid_opcode(uint32_t command)
+{
+    uint32_t opcode = (command >> 25) & 0x1f;
+
+    return opcode <= ST || (opcode >= JLT && opcode <= JIN) || opcode == HLT;
+}
+
+static void emit8(uint8_t value)
+{
+    *gEmit++ = value;
+}
+
+static void emit32(uint32_t value)
+{
+    memcpy(gEmit, &value, sizeof(value));
+    gEmit += sizeof(value);
+}
+
+static void emit64(uint64_t value)
+{
+    memcpy(gEmit, &value, sizeof(value));
+    gEmit += sizeof(value);
+}
+
+// jcc rel32, returns the rel32 to patch
+static uint8_t *emit_jump(uint8_t opcode2)
+{
+    emit8(0x0f); emit8(opcode2);
+    emit32(0);
+    return gEmit - 4;
+}
+
+static void emit_load(int reg, uint16_t source, uint32_t immediate)
+{
+    if (source == IMMEDIATE_REGISTER)
+    {
+        emit8(0xb8 + reg); emit32(immediate);                           // mov reg, immediate
+        return;
+    }
+    emit8(0x8b); emit8(0x43 | (reg << 3)); emit8(4 * source);          // mov reg, [rbx + 4 * source]
+}
+
+static void emit_store(int reg, uint16_t dst)
+{
+    emit8(0x89); emit8(0x43 | (reg << 3)); emit8(4 * dst);             // mov [rbx + 4 * dst], reg
+}
+
+// leave for pc, through a jump chained later on
+static void emit_exit(uint16_t pc, uint32_t immediate)
+{
+    uint8_t *chain;
+
+    emit8(0xc7); emit8(0x43); emit8(4 * IMMEDIATE_REGISTER); emit32(immediate);
+    chain = gEmit;
+    emit8(0xe9); emit32(0);                                             // jmp next, the block for pc once chained
+    emit8(0x41); emit8(0xc7); emit8(0x47); emit8(offsetof(dbt_context_s, pc)); emit32(pc);
+    emit8(0x48); emit8(0xb8); emit64((uint64_t)(uintptr_t)chain);       // mov rax, chain
+    emit8(0xe9); emit32(0);                                             // jmp leave
+    patch32(gEmit - 4, gLeave);
+}
+
+static void emit_leave(dbt_status_e status, uint16_t pc, uint32_t uncount, uint32_t immediate)
+{
+    emit8(0xc7); emit8(0x43); emit8(4 * IMMEDIATE_REGISTER); emit32(immediate);
+    emit8(0x41); emit8(0xc7); emit8(0x47); emit8(offsetof(dbt_context_s, status)); emit32(status);
+    emit8(0x41); emit8(0xc7); emit8(0x47); emit8(offsetof(dbt_context_s, pc)); emit32(pc);
+    if (uncount > 0)
+    {
+        emit8(0x49); emit8(0x83); emit8(0x6f); emit8(offsetof(dbt_context_s, count)); emit8((uint8_t)uncount);  // sub qword [r15 + count], uncount
+    }
+    emit8(0x31); emit8(0xc0);                                           // xor eax, eax
+    emit8(0xe9); emit32(0);                                             // jmp leave
+    patch32(gEmit - 4, gLeave);
+}
+
+// point the rel32 at at to to
+static void patch32(uint8_t *at, uint8_t *to)
+{
+    int32_t rel = (int32_t)(to - (at + 4));
+
+    memcpy(at, &rel, sizeof(rel));
+}
+
+#else
+
+bool Dbt_Run(uint32_t *registers, uint32_t *memory, uint16_t pc, dbt_result_s *result)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*!
+******************************************************************************
+\file Dbt.h
+\date 17 October 2026
+\author Rony Kositsky & Ofir Guthman
+\brief
+    dynamic binary translation of the sp program to x86-64
+
+\details
+    basic blocks are translated to native code the first time they run
+    and then run from the code buffer. a block ends at a jump, a HALT or
+    after DBT_BLOCK_LENGTH instructions, and its exits are chained to the
+    blocks they go to once those are translated. a store to a translated
+    word flushes the whole buffer, the program goes on translating again.
+    there is no per-instruction trace here, tracing runs on the
+    interpreter.
+    only on x86-64 linux and macos, and not when built with ISS_NO_DBT.
+
+\par Copyright
+(c) Copyright 2021 Ofir & Rony
+\par
+ALL RIGHTS RESERVED
+*****************************************************************************/
+
+#ifndef __DBT_H_
+#define __DBT_H_
+
+/************************************
+*      include                      *
+************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/************************************
+*       types                       *
+************************************/
+typedef struct
+{
+    uint16_t pc;            // pc of the last instruction run
+    uint64_t count;         // instructions run
+    bool invalid;           // ended on a memory access out of range
+    uint32_t address;       // the address of that access
+} dbt_result_s;
+
+/************************************
+*       API                         *
+************************************/
+/*!
+******************************************************************************
+\brief
+ Run the program till HALT or an invalid memory access, translated.
+
+\details
+ the run stops on the access itself, the caller reports it and halts as
+ the interpreter does.
+
+\param
+ [in,out] registers - NUMBER_OF_REGISTERS registers
+ [in,out] memory - MAX_MEMORY_SIZE words
+ [in] pc - program counter to start at
+ [out] result - where and how the run ended
+
+\return true when the program ran, false when there is no translation
+        here and nothing ran
+*****************************************************************************/
+bool Dbt_Run(uint32_t *registers, uint32_t *memory, uint16_t pc, dbt_result_s *result);
+
+#endif // __DBT_H_
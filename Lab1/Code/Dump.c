@@ -0,0 +1,116 @@
+/*!
+******************************************************************************
+\file Dump.c
+\date 17 October 2026
+\author Rony Kositsky & Ofir Guthman
+\brief
+    memory dump writer
+
+\details
+
+\par Copyright
+(c) Copyright 2021 Ofir & Rony
+\par
+ALL RIGHTS RESERVED
+*****************************************************************************/
+
+/************************************
+*      include                      *
+************************************/
+#include "Dump.h"
+//
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/************************************
+*      definitions                 *
+************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#define LINE_SIZE           9       // "%08x\n"
+#define DELTA_LINE_SIZE     14      // "%04x %08x\n"
+#define FNV_OFFSET_BASIS    0xcbf29ce484222325ULL
+#define FNV_PRIME           0x100000001b3ULL
+
+// the two digits of every byte value, byte b at gHexPairs[2 * b]
+#define HEX_ROW(h)  h "0" h "1" h "2" h "3" h "4" h "5" h "6" h "7" \
+                    h "8" h "9" h "a" h "b" h "c" h "d" h "e" h "f"
+
+/************************************
+*      variables                    *
+************************************/
+static const char gHexPairs[] =
+    HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3") HEX_ROW("4") HEX_ROW("5") HEX_ROW("6") HEX_ROW("7")
+    HEX_ROW("8") HEX_ROW("9") HEX_ROW("a") HEX_ROW("b") HEX_ROW("c") HEX_ROW("d") HEX_ROW("e") HEX_ROW("f");
+
+/************************************
+*      static functions             *
+************************************/
+static char *put_byte(char *p, uint32_t byte);
+static char *put_word(char *p, uint32_t word);
+
+/************************************
+*       API implementation          *
+************************************/
+bool Dump_Write(FILE *dumpFile, const uint32_t *memory, const uint32_t *base, uint32_t size)
+{
+    char *buffer, *p;
+    bool written;
+
+    buffer = malloc((size_t)size * (base != NULL ? DELTA_LINE_SIZE : LINE_SIZE) + 1);
+    if (buffer == NULL)
+        return false;
+
+    p = buffer;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (base != NULL)
+        {
+            if (memory[i] == base[i])
+                continue;
+            p = put_byte(p, (i >> 8) & 0xff);
+            p = put_byte(p, i & 0xff);
+            *p++ = ' ';
+        }
+        p = put_word(p, memory[i]);
+        *p++ = '\n';
+    }
+
+    written = fwrite(buffer, 1, (size_t)(p - buffer), dumpFile) == (size_t)(p - buffer) && fflush(dumpFile) == 0;
+    free(buffer);
+    return written;
+}
+
+uint64_t Dump_Hash(const uint32_t *memory, uint32_t size)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        for (uint32_t j = 0, word = memory[i]; j < sizeof(uint32_t); j++, word >>= 8)
+        {
+            hash ^= word & 0xff;
+            hash *= FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+/************************************
+* static implementation             *
+************************************/
+static char *put_byte(char *p, uint32_t byte)
+{
+    memcpy(p, &gHexPairs[2 * byte], 2);
+    return p + 2;
+}
+
+static char *put_word(char *p, uint32_t word)
+{
+    p = put_byte(p, word >> 24);
+    p = put_byte(p, (word >> 16) & 0xff);
+    p = put_byte(p, (word >> 8) & 0xff);
+    return put_byte(p, word & 0xff);
+}
@@ -0,0 +1,66 @@
+/*!
+******************************************************************************
+\file Dump.h
+\date 17 October 2026
+\author Rony Kositsky & Ofir Guthman
+\brief
+    memory dump writer
+
+\details
+    a full dump is a line of 8 hex digits per word. a delta dump only has
+    the words that differ from a base image, as a line of the 4 digit
+    address and the word. the lines are formatted with a table of digit
+    pairs into one buffer that is written in one piece.
+
+\par Copyright
+(c) Copyright 2021 Ofir & Rony
+\par
+ALL RIGHTS RESERVED
+*****************************************************************************/
+
+#ifndef __DUMP_H_
+#define __DUMP_H_
+
+/************************************
+*      include                      *
+************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/************************************
+*       API                         *
+************************************/
+/*!
+******************************************************************************
+\brief
+ Write a memory dump.
+
+\param
+ [in] dumpFile - dump output
+ [in] memory - words to dump
+ [in] base - image to compare with for a delta dump, NULL for a full dump
+ [in] size - number of words
+
+\return true on success, false when out of memory or the write fails
+*****************************************************************************/
+bool Dump_Write(FILE *dumpFile, const uint32_t *memory, const uint32_t *base, uint32_t size);
+
+/*!
+******************************************************************************
+\brief
+ Hash memory contents.
+
+\details
+ 64 bit fnv-1a of the little endian bytes of the words, equal dumps have
+ equal hashes.
+
+\param
+ [in] memory - words to hash
+ [in] size - number of words
+
+\return the hash
+*****************************************************************************/
+uint64_t Dump_Hash(const uint32_t *memory, uint32_t size);
+
+#endif // __DUMP_H_
@@ -0,0 +1,292 @@
+/*!
+******************************************************************************
+\file Loader.c
+\date 17 October 2026
+\author Rony Kositsky & Ofir Guthman
+\brief
+    memory image loader
+
+\details
+
+\par Copyright
+(c) Copyright 2021 Ofir & Rony
+\par
+ALL RIGHTS RESERVED
+*****************************************************************************/
+
+/************************************
+*      include                      *
+************************************/
+#include "Loader.h"
+//
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/************************************
+*      definitions                 *
+************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#define MAX_HEX_DIGITS      8
+
+/************************************
+*       types                       *
+************************************/
+typedef enum
+{
+    BYTE_OTHER = 0,     // not in a well formed text image
+    BYTE_HEX,
+    BYTE_BLANK,
+    BYTE_NEW_LINE
+}byte_class_e;
+
+/************************************
+*      variables                    *
+************************************/
+static const uint8_t gByteClass[256] =
+{
+    ['0'] = BYTE_HEX, ['1'] = BYTE_HEX, ['2'] = BYTE_HEX, ['3'] = BYTE_HEX, ['4'] = BYTE_HEX,
+    ['5'] = BYTE_HEX, ['6'] = BYTE_HEX, ['7'] = BYTE_HEX, ['8'] = BYTE_HEX, ['9'] = BYTE_HEX,
+    ['a'] = BYTE_HEX, ['b'] = BYTE_HEX, ['c'] = BYTE_HEX, ['d'] = BYTE_HEX, ['e'] = BYTE_HEX, ['f'] = BYTE_HEX,
+    ['A'] = BYTE_HEX, ['B'] = BYTE_HEX, ['C'] = BYTE_HEX, ['D'] = BYTE_HEX, ['E'] = BYTE_HEX, ['F'] = BYTE_HEX,
+    [' '] = BYTE_BLANK, ['\t'] = BYTE_BLANK, ['\r'] = BYTE_BLANK,
+    ['\n'] = BYTE_NEW_LINE
+};
+
+static const uint8_t gHexValue[256] =
+{
+    ['1'] = 1, ['2'] = 2, ['3'] = 3, ['4'] = 4, ['5'] = 5, ['6'] = 6, ['7'] = 7, ['8'] = 8, ['9'] = 9,
+    ['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15,
+    ['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15
+};
+
+/************************************
+*      static functions             *
+************************************/
+static const uint8_t *map_file(FILE *imageFile, size_t *size);
+static void unmap_file(const uint8_t *data, size_t size);
+static bool is_text(const uint8_t *data, size_t size);
+static int32_t parse_text(const uint8_t *data, size_t size, const char *imageName, uint32_t *memory, uint32_t maxWords);
+static int32_t parse_binary(const uint8_t *data, size_t size, const char *imageName, uint32_t *memory, uint32_t maxWords);
+static int32_t parse_exe(const uint8_t *data, size_t size, const char *imageName, uint32_t *memory, uint32_t maxWords, uint32_t *entry);
+static uint32_t get_word(const uint8_t *data);
+
+/************************************
+*       API implementation          *
+************************************/
+int32_t Loader_LoadImage(FILE *imageFile, const char *imageName, uint32_t *memory, uint32_t maxWords, uint32_t *entry)
+{
+    const uint8_t *data;
+    size_t size;
+    int32_t words;
+
+    data = map_file(imageFile, &size);
+    if (data == NULL && size != 0)
+    {
+        printf("Error: failed reading %s. \n", imageName);
+        return -1;
+    }
+
+    *entry = 0;
+    if (size >= sizeof(uint32_t) && get_word(data) == SP_EXE_MAGIC)
+        words = parse_exe(data, size, imageName, memory, maxWords, entry);
+    else if (is_text(data, size) == true)
+        words = parse_text(data, size, imageName, memory, maxWords);
+    else
+        words = parse_binary(data, size, imageName, memory, maxWords);
+
+    unmap_file(data, size);
+    return words;
+}
+
+/************************************
+* static implementation             *
+************************************/
+// NULL for an empty file
+static const uint8_t *map_file(FILE *imageFile, size_t *size)
+{
+#ifdef _WIN32
+    uint8_t *data;
+    long length;
+
+    *size = 0;
+    if (fseek(imageFile, 0, SEEK_END) != 0 || (length = ftell(imageFile)) < 0 || fseek(imageFile, 0, SEEK_SET) != 0)
+    {
+        *size = 1;
+        return NULL;
+    }
+    *size = (size_t)length;
+    if (length == 0)
+        return NULL;
+    data = malloc(*size);
+    if (data != NULL && fread(data, 1, *size, imageFile) != *size)
+    {
+        free(data);
+        data = NULL;
+    }
+    return data;
+#else
+    struct stat st;
+    void *data;
+
+    *size = 0;
+    if (fstat(fileno(imageFile), &st) != 0)
+    {
+        *size = 1;
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    if (*size == 0)
+        return NULL;
+    data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fileno(imageFile), 0);
+    return data == MAP_FAILED ? NULL : data;
+#endif
+}
+
+static void unmap_file(const uint8_t *data, size_t size)
+{
+    if (data == NULL)
+        return;
+#ifdef _WIN32
+    free((void *)data);
+#else
+    munmap((void *)data, size);
+#endif
+}
+
+static bool is_text(const uint8_t *data, size_t size)
+{
+    // a bad text image is still text, a binary has control or 8 bit bytes
+    for (size_t i = 0; i < size; i++)
+    {
+        if (gByteClass[data[i]] == BYTE_OTHER && (data[i] < ' ' || data[i] > '~'))
+            return false;
+    }
+    return true;
+}
+
+static int32_t parse_text(const uint8_t *data, size_t size, const char *imageName, uint32_t *memory, uint32_t maxWords)
+{
+    const uint8_t *p = data, *end = data + size;
+    uint32_t words = 0, line = 1, word, digits;
+
+    while (p < end && words < maxWords)
+    {
+        while (p < end && gByteClass[*p] == BYTE_BLANK)
+            p++;
+        if (p == end)
+            break;
+        if (*p == '\n')
+        {
+            p++;
+            line++;
+            continue;
+        }
+
+        for (word = 0, digits = 0; p < end && gByteClass[*p] == BYTE_HEX; p++, digits++)
+            word = (word << 4) | gHexValue[*p];
+        while (p < end && gByteClass[*p] == BYTE_BLANK)
+            p++;
+        if (digits == 0 || digits > MAX_HEX_DIGITS || (p < end && *p != '\n'))
+        {
+            printf("Error: %s line %u is not a hex word. \n", imageName, line);
+            return -1;
+        }
+        memory[words++] = word;
+    }
+    return (int32_t)words;
+}
+
+static int32_t parse_binary(const uint8_t *data, size_t size, const char *imageName, uint32_t *memory, uint32_t maxWords)
+{
+    uint32_t words = 0;
+
+    if (size % sizeof(uint32_t) != 0)
+    {
+        printf("Error: %s is neither hex words nor 32 bit binary words. \n", imageName);
+        return -1;
+    }
+    for (; words < maxWords && words < size / sizeof(uint32_t); words++, data += sizeof(uint32_t))
+        memory[words] = get_word(data);
+    return (int32_t)words;
+}
+
+static int32_t parse_exe(const uint8_t *data, size_t size, const char *imageName, uint32_t *memory, uint32_t maxWords, uint32_t *entry)
+{
+    sp_exe_header_s header;
+    sp_exe_section_s section;
+    const uint8_t *table;
+    uint32_t end = 0;
+
+    if (size < sizeof(header))
+    {
+        printf("Error: %s has a truncated header. \n", imageName);
+        return -1;
+    }
+    header.version = get_word(data + 4);
+    header.entry = get_word(data + 8);
+    header.numberOfSections = get_word(data + 12);
+    if (header.version != SP_EXE_VERSION)
+    {
+        printf("Error: %s version %u is not supported. \n", imageName, header.version);
+        return -1;
+    }
+    if (header.numberOfSections > SP_EXE_MAX_SECTIONS || sizeof(header) + header.numberOfSections * sizeof(section) > size)
+    {
+        printf("Error: %s has a bad section table. \n", imageName);
+        return -1;
+    }
+    if (header.entry >= maxWords)
+    {
+        printf("Error: %s entry %u is out of memory. \n", imageName, header.entry);
+        return -1;
+    }
+
+    table = data + sizeof(header);
+    for (uint32_t i = 0; i < header.numberOfSections; i++, table += sizeof(section))
+    {
+        section.type = get_word(table);
+        section.address = get_word(table + 4);
+        section.size = get_word(table + 8);
+        section.offset = get_word(table + 12);
+        if (section.type == 0 || (section.type & ~(SP_EXE_CODE | SP_EXE_DATA | SP_EXE_BSS)) != 0 ||
+            ((section.type & SP_EXE_BSS) != 0 && section.type != SP_EXE_BSS))
+        {
+            printf("Error: %s section %u has a bad type %u. \n", imageName, i, section.type);
+            return -1;
+        }
+        if (section.address >= maxWords || section.size > maxWords - section.address)
+        {
+            printf("Error: %s section %u is out of memory. \n", imageName, i);
+            return -1;
+        }
+        if (section.type == SP_EXE_BSS)
+            memset(&memory[section.address], 0, section.size * sizeof(uint32_t));
+        else if (section.offset > size || section.size > (size - section.offset) / sizeof(uint32_t))
+        {
+            printf("Error: %s section %u is truncated. \n", imageName, i);
+            return -1;
+        }
+        else
+        {
+            for (uint32_t j = 0; j < section.size; j++)
+                memory[section.address + j] = get_word(data + section.offset + j * sizeof(uint32_t));
+        }
+        if (section.address + section.size > end)
+            end = section.address + section.size;
+    }
+
+    *entry = header.entry;
+    return (int32_t)end;
+}
+
+static uint32_t get_word(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
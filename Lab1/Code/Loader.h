@@ -0,0 +1,92 @@
+/*!
+******************************************************************************
+\file Loader.h
+\date 17 October 2026
+\author Rony Kositsky & Ofir Guthman
+\brief
+    memory image loader
+
+\details
+    an image is a text file of hex words, one per line, or a raw little
+    endian binary of 32 bit words. a file holding a control character
+    other than a blank or new line, or a byte above 127, is taken as
+    binary. in a text image blank lines are skipped and a word has 1 to
+    8 digits, any other line is an error.
+    the file is mapped (read in one piece on windows) and parsed in place.
+    a binary starting with SP_EXE_MAGIC is an sp executable: a header, a
+    table of sections and the words of the code and data sections, all
+    little endian 32 bit words. the iss has one memory for code and data, a
+    bss section is zero filled. execution starts at the entry pc.
+
+\par Copyright
+(c) Copyright 2021 Ofir & Rony
+\par
+ALL RIGHTS RESERVED
+*****************************************************************************/
+
+#ifndef __LOADER_H_
+#define __LOADER_H_
+
+/************************************
+*      include                      *
+************************************/
+#include <stdio.h>
+#include <stdint.h>
+
+/************************************
+*      definitions                 *
+************************************/
+#define SP_EXE_MAGIC            0x58455053  // "SPEX"
+#define SP_EXE_VERSION          1
+#define SP_EXE_MAX_SECTIONS     64
+
+/************************************
+*       types                       *
+************************************/
+typedef enum
+{
+    SP_EXE_CODE = 1,
+    SP_EXE_DATA = 2,        // a section of code and data is 3
+    SP_EXE_BSS = 4
+}sp_exe_section_type_e;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t numberOfSections;
+}sp_exe_header_s;
+
+typedef struct
+{
+    uint32_t type;
+    uint32_t address;       // first word
+    uint32_t size;          // in words
+    uint32_t offset;        // of the words in the file in bytes, 0 for bss
+}sp_exe_section_s;
+
+/************************************
+*       API                         *
+************************************/
+/*!
+******************************************************************************
+\brief
+ Load a memory image.
+
+\details
+ words of a text or raw image past maxWords are ignored, sections of an
+ executable must fit.
+
+\param
+ [in] imageFile - file containing the image, opened for reading
+ [in] imageName - name of the file for the error messages
+ [out] memory - the words of the image
+ [in] maxWords - size of memory
+ [out] entry - pc of the first instruction, 0 but for executables
+
+\return one past the last word loaded, -1 on a bad image
+*****************************************************************************/
+int32_t Loader_LoadImage(FILE *imageFile, const char *imageName, uint32_t *memory, uint32_t maxWords, uint32_t *entry);
+
+#endif // __LOADER_H_
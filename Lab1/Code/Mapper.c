@@ -17,6 +17,8 @@ ALL RIGHTS RESERVED
 *      include                      *
 ************************************/
 #include "Mapper.h"
+#include "Loader.h"
+#include "Dbt.h"
 //
 #include <stdint.h>
 #include <stdbool.h>
@@ -28,14 +30,57 @@ ALL RIGHTS RESERVED
 *      definitions                 *
 ************************************/
 #define _CRT_SECURE_NO_WARNINGS
-#define BRANCH_REGISTER_STORE_VALUE 7
-#define IMMEDIATE_REGISTER          1
-//
 #define HALT_INSTRUCTION_COMMAND    (0x30000000)
+//
+// gcc and clang take the address of a label, the threaded engine jumps through it
+#if defined(__GNUC__) || defined(__clang__)
+#define THREADED_COMPUTED_GOTO
+#endif
 
 /************************************
 *       types                       *
 ************************************/
+// threaded code handlers, zero so a cleared slot is translated on its first run
+typedef enum
+{
+	T_TRANSLATE = 0,
+	T_ADD,
+	T_SUB,
+	T_LSF,
+	T_RSF,
+	T_AND,
+	T_OR,
+	T_XOR,
+	T_LHI,
+	T_LD,
+	T_ST,
+	T_JLT,
+	T_JLE,
+	T_JEQ,
+	T_JNE,
+	T_JIN,
+	T_HLT,
+	T_NOP,
+	// superinstructions, the instructions after the first have their own slots
+	T_LD_ADD,
+	T_ADD_JLT,
+	T_ADD_JLE,
+	T_ADD_JEQ,
+	T_ADD_JNE,
+	T_ST_ADD_JLT,
+	T_ST_ADD_JLE,
+	T_ST_ADD_JEQ,
+	T_ST_ADD_JNE
+}threaded_e;
+
+typedef struct
+{
+	uint8_t handler;    // threaded_e
+	uint8_t dst;
+	uint8_t src0;
+	uint8_t src1;
+	uint32_t immediate;
+}threaded_s;
 
 /************************************
 *      variables                    *
@@ -46,6 +91,12 @@ static uint16_t gProgramCounter = 0;
 static bool gProgramIsRunning = true;
 //
 static bool gInvalidOperation = false;
+//
+// predecode cache, by pc
+static decoded_s gDecoded[MAX_MEMORY_SIZE];
+//
+// threaded code, by pc
+static threaded_s gThreaded[MAX_MEMORY_SIZE];
 
 /************************************
 *      static functions             *
@@ -66,15 +117,22 @@ static bool gInvalidOperation = false;
 /*19*/  static void Jne(uint16_t dst, uint16_t src0, uint16_t src1);
 /*20*/  static void Jin(uint16_t dst, uint16_t src0, uint16_t src1);
 /*24*/  static void Hlt(uint16_t dst, uint16_t src0, uint16_t src1);
+        static void None(uint16_t dst, uint16_t src0, uint16_t src1);
 //
 //
 static bool check_for_memory_error(uint32_t address);
 static bool register_violation(uint16_t dst, uint16_t src0, uint16_t src1);
 
 static void Jump(uint16_t pc_location);
+static const opcode_s *find_opcode(uint16_t opcode);
+static void translate(uint16_t pc);
+static threaded_e translate_single(uint16_t pc, bool ahead);
+static void invalidate(uint32_t address);
+static bool known_opcode(uint16_t opcode);
 //
 //
 //
+// the functions take operands Mapper_Decode() has checked
 static opcode_s OpcodeMapping[NUMBER_OF_OPCODES] =
 {
 	{ADD,	"ADD", 	Add},
@@ -98,26 +156,20 @@ static opcode_s OpcodeMapping[NUMBER_OF_OPCODES] =
 /************************************
 *       API implementation          *
 ************************************/
-uint16_t Mapper_InitMemory(FILE *memoryFile)
+uint16_t Mapper_InitMemory(FILE *memoryFile, const char *memoryFileName)
 {
-    uint16_t lineInProgram = 0;
-    while (lineInProgram < MAX_MEMORY_SIZE && fscanf(memoryFile, "%08x", (unsigned int*)&(gMemory[lineInProgram])) != EOF)
-		lineInProgram++;
+    uint32_t entry;
+    int32_t lineInProgram = Loader_LoadImage(memoryFile, memoryFileName, gMemory, MAX_MEMORY_SIZE, &entry);
+    if (lineInProgram < 0)
+        exit(1);
 
-    return lineInProgram;
+    gProgramCounter = (uint16_t)entry;
+    return (uint16_t)lineInProgram;
 }
 
 opcode_s Mapper_GetOpcode(uint16_t opcode)
 {
-    for(int i = 0; i < NUMBER_OF_OPCODES; i++)
-	{
-		if (OpcodeMapping[i].code == opcode)
-			return OpcodeMapping[i];
-	}
-    //
-    // We get an invalid opcode, so we will exit
-    printf("Wrong opcode was passed (%u), exit the program", opcode);
-    return OpcodeMapping[NUMBER_OF_OPCODES - 1];    // return halt command
+    return *find_opcode(opcode);
 }
 
 bool Mapper_IsProgramRunning(void)
@@ -130,6 +182,11 @@ uint32_t Mapper_GetFromMemory(uint16_t location)
     return gMemory[location];
 }
 
+const uint32_t *Mapper_GetMemory(void)
+{
+    return gMemory;
+}
+
 uint32_t Mapper_GetNextInstruction(uint16_t *pc)
 {
     if (gInvalidOperation == true)
@@ -142,6 +199,290 @@ uint32_t Mapper_GetNextInstruction(uint16_t *pc)
     return mem;
 }
 
+const decoded_s *Mapper_GetNextDecoded(uint16_t *pc)
+{
+    static decoded_s halt;
+    decoded_s *decoded;
+
+    if (gInvalidOperation == true)
+    {
+        if (halt.opcode == NULL)
+            Mapper_Decode(&halt, HALT_INSTRUCTION_COMMAND);
+        gRegisterArray[IMMEDIATE_REGISTER] = halt.immediate;
+        return &halt;
+    }
+
+    *pc = gProgramCounter;
+    //
+    decoded = &gDecoded[gProgramCounter];
+    if (decoded->opcode == NULL)
+        Mapper_Decode(decoded, gMemory[gProgramCounter]);
+    gProgramCounter++;
+    gRegisterArray[IMMEDIATE_REGISTER] = decoded->immediate;
+    return decoded;
+}
+
+uint32_t Mapper_Run(uint16_t *pc)
+{
+    uint32_t *r = gRegisterArray;
+    uint16_t next = gProgramCounter, at = gProgramCounter;
+    uint32_t count = 0, address;
+    threaded_s *ins;
+
+#ifdef THREADED_COMPUTED_GOTO
+    static const void *handlers[] =
+    {
+        [T_TRANSLATE] = &&L_T_TRANSLATE,
+        [T_ADD] = &&L_T_ADD, [T_SUB] = &&L_T_SUB, [T_LSF] = &&L_T_LSF, [T_RSF] = &&L_T_RSF,
+        [T_AND] = &&L_T_AND, [T_OR] = &&L_T_OR, [T_XOR] = &&L_T_XOR, [T_LHI] = &&L_T_LHI,
+        [T_LD] = &&L_T_LD, [T_ST] = &&L_T_ST,
+        [T_JLT] = &&L_T_JLT, [T_JLE] = &&L_T_JLE, [T_JEQ] = &&L_T_JEQ, [T_JNE] = &&L_T_JNE, [T_JIN] = &&L_T_JIN,
+        [T_HLT] = &&L_T_HLT, [T_NOP] = &&L_T_NOP,
+        [T_LD_ADD] = &&L_T_LD_ADD,
+        [T_ADD_JLT] = &&L_T_ADD_JLT, [T_ADD_JLE] = &&L_T_ADD_JLE, [T_ADD_JEQ] = &&L_T_ADD_JEQ, [T_ADD_JNE] = &&L_T_ADD_JNE,
+        [T_ST_ADD_JLT] = &&L_T_ST_ADD_JLT, [T_ST_ADD_JLE] = &&L_T_ST_ADD_JLE,
+        [T_ST_ADD_JEQ] = &&L_T_ST_ADD_JEQ, [T_ST_ADD_JNE] = &&L_T_ST_ADD_JNE,
+    };
+#define HANDLER(handler)    L_##handler:
+#define DISPATCH()          goto *handlers[ins->handler]
+#else
+#define HANDLER(handler)    case handler:
+#define DISPATCH()          goto dispatch
+#endif
+    // fetch the instruction at next and set the immediate register, a
+    // superinstruction steps to the instructions after its first this way
+#define STEP()                                      \
+    do {                                            \
+        at = next++;                                \
+        ins = &gThreaded[at];                       \
+        r[IMMEDIATE_REGISTER] = ins->immediate;     \
+        count++;                                    \
+    } while (0)
+    // and run it
+#define NEXT()                                      \
+    do {                                            \
+        STEP();                                     \
+        DISPATCH();                                 \
+    } while (0)
+    // like Jump(), r7 gets the pc of the jump. the target is read first,
+    // JIN r7 returns to the r7 from before it
+#define JUMP(pc_location)                                       \
+    do {                                                        \
+        uint16_t target = (uint16_t)(pc_location);              \
+        r[BRANCH_REGISTER_STORE_VALUE] = next - 1;              \
+        next = target;                                          \
+    } while (0)
+#define DO_ADD()        r[ins->dst] = r[ins->src0] + r[ins->src1]
+#define DO_LD()                                                 \
+    do {                                                        \
+        address = r[ins->src1];                                 \
+        if (check_for_memory_error(address) == true)            \
+            goto invalid;                                       \
+        r[ins->dst] = gMemory[address];                         \
+    } while (0)
+#define DO_ST()                                                 \
+    do {                                                        \
+        address = r[ins->src1];                                 \
+        if (check_for_memory_error(address) == true)            \
+            goto invalid;                                       \
+        gMemory[address] = r[ins->src0];                        \
+        invalidate(address);                                    \
+    } while (0)
+#define DO_JUMP(condition)                                      \
+    do {                                                        \
+        if (r[ins->src0] condition r[ins->src1])                \
+            JUMP(r[IMMEDIATE_REGISTER]);                        \
+    } while (0)
+    // a store to the rest of the superinstruction at at, it goes on one by one
+#define STORED_AHEAD()  ((uint16_t)(address - at - 1) < 2)
+
+    NEXT();
+#ifndef THREADED_COMPUTED_GOTO
+dispatch:
+    switch (ins->handler)
+    {
+#endif
+    HANDLER(T_TRANSLATE)
+        translate(at);
+        r[IMMEDIATE_REGISTER] = ins->immediate;
+        DISPATCH();
+    HANDLER(T_ADD)
+        DO_ADD();
+        NEXT();
+    HANDLER(T_SUB)
+        r[ins->dst] = r[ins->src0] - r[ins->src1];
+        NEXT();
+    HANDLER(T_LSF)
+        r[ins->dst] = r[ins->src0] << r[ins->src1];
+        NEXT();
+    HANDLER(T_RSF)
+        r[ins->dst] = r[ins->src0] >> r[ins->src1];
+        NEXT();
+    HANDLER(T_AND)
+        r[ins->dst] = r[ins->src0] & r[ins->src1];
+        NEXT();
+    HANDLER(T_OR)
+        r[ins->dst] = r[ins->src0] | r[ins->src1];
+        NEXT();
+    HANDLER(T_XOR)
+        r[ins->dst] = r[ins->src0] ^ r[ins->src1];
+        NEXT();
+    HANDLER(T_LHI)
+        r[ins->dst] &= 0x0000FFFF;
+        r[ins->dst] |= (r[IMMEDIATE_REGISTER] << 16);
+        NEXT();
+    HANDLER(T_LD)
+        DO_LD();
+        NEXT();
+    HANDLER(T_ST)
+        DO_ST();
+        NEXT();
+    HANDLER(T_JLT)
+        DO_JUMP(<);
+        NEXT();
+    HANDLER(T_JLE)
+        DO_JUMP(<=);
+        NEXT();
+    HANDLER(T_JEQ)
+        DO_JUMP(==);
+        NEXT();
+    HANDLER(T_JNE)
+        DO_JUMP(!=);
+        NEXT();
+    HANDLER(T_JIN)
+        JUMP(r[ins->src0]);
+        NEXT();
+    HANDLER(T_NOP)
+        NEXT();
+    HANDLER(T_HLT)
+        goto halt;
+    HANDLER(T_LD_ADD)
+        DO_LD();
+        STEP();
+        DO_ADD();
+        NEXT();
+    HANDLER(T_ADD_JLT)
+        DO_ADD();
+        STEP();
+        DO_JUMP(<);
+        NEXT();
+    HANDLER(T_ADD_JLE)
+        DO_ADD();
+        STEP();
+        DO_JUMP(<=);
+        NEXT();
+    HANDLER(T_ADD_JEQ)
+        DO_ADD();
+        STEP();
+        DO_JUMP(==);
+        NEXT();
+    HANDLER(T_ADD_JNE)
+        DO_ADD();
+        STEP();
+        DO_JUMP(!=);
+        NEXT();
+    HANDLER(T_ST_ADD_JLT)
+        DO_ST();
+        if (STORED_AHEAD())
+            NEXT();
+        STEP();
+        DO_ADD();
+        STEP();
+        DO_JUMP(<);
+        NEXT();
+    HANDLER(T_ST_ADD_JLE)
+        DO_ST();
+        if (STORED_AHEAD())
+            NEXT();
+        STEP();
+        DO_ADD();
+        STEP();
+        DO_JUMP(<=);
+        NEXT();
+    HANDLER(T_ST_ADD_JEQ)
+        DO_ST();
+        if (STORED_AHEAD())
+            NEXT();
+        STEP();
+        DO_ADD();
+        STEP();
+        DO_JUMP(==);
+        NEXT();
+    HANDLER(T_ST_ADD_JNE)
+        DO_ST();
+        if (STORED_AHEAD())
+            NEXT();
+        STEP();
+        DO_ADD();
+        STEP();
+        DO_JUMP(!=);
+        NEXT();
+#ifndef THREADED_COMPUTED_GOTO
+    }
+#endif
+
+invalid:
+    // Mapper_GetNextDecoded() gives a HALT at the same pc after an invalid operation
+    r[IMMEDIATE_REGISTER] = HALT_INSTRUCTION_COMMAND & 0xffff;
+    count++;
+halt:
+    gProgramIsRunning = false;
+    gProgramCounter = next;
+    *pc = at;
+    return count;
+
+#undef HANDLER
+#undef DISPATCH
+#undef STEP
+#undef NEXT
+#undef JUMP
+#undef DO_ADD
+#undef DO_LD
+#undef DO_ST
+#undef DO_JUMP
+#undef STORED_AHEAD
+}
+
+uint32_t Mapper_RunTranslated(uint16_t *pc)
+{
+    dbt_result_s result;
+
+    if (Dbt_Run(gRegisterArray, gMemory, gProgramCounter, &result) == false)
+        return Mapper_Run(pc);
+
+    if (result.invalid == true)
+    {
+        // reported here, then the HALT Mapper_GetNextDecoded() gives
+        check_for_memory_error(result.address);
+        gRegisterArray[IMMEDIATE_REGISTER] = HALT_INSTRUCTION_COMMAND & 0xffff;
+        result.count++;
+    }
+    gProgramIsRunning = false;
+    gProgramCounter = result.pc + 1;
+    *pc = result.pc;
+    return (uint32_t)result.count;
+}
+
+void Mapper_Decode(decoded_s *decoded, uint32_t command)
+{
+    decoded->command = command;
+    decoded->immediate = command & 0xffff;
+    decoded->src1 = (command >> 16) & 0x7;
+    decoded->src0 = (command >> 19) & 0x7;
+    decoded->dst = (command >> 22) & 0x7;
+    decoded->opcode = find_opcode((command >> 25) & 0x1f);
+    decoded->OperationFunction = decoded->opcode->OperationFunction;
+
+    if (register_violation(decoded->dst, decoded->src0, decoded->src1) == true)
+    {
+        decoded->OperationFunction = None;
+        return;
+    }
+    // r0 and the immediate register can't be written
+    if (decoded->opcode->code <= LD && decoded->dst <= IMMEDIATE_REGISTER)
+        decoded->OperationFunction = None;
+}
+
 uint16_t Mapper_GetProgramCounter(void)
 {
     return gProgramCounter;
@@ -157,77 +498,58 @@ void Mapper_GetRegistersSnapshot(uint32_t regs[NUMBER_OF_REGISTERS])
     memcpy((uint8_t *)regs, (uint8_t *)gRegisterArray, sizeof(gRegisterArray));
 }
 
+uint32_t Mapper_GetRegister(uint16_t index)
+{
+    return gRegisterArray[index];
+}
+
 /************************************
 * static implementation             *
 ************************************/
 static void Add(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (dst <= IMMEDIATE_REGISTER || register_violation(dst, src0, src1) == true)
-        return;
-
 	gRegisterArray[dst] = gRegisterArray[src0] + gRegisterArray[src1];
 }
 
 static void Sub(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (dst <= IMMEDIATE_REGISTER || register_violation(dst, src0, src1) == true)
-        return;
-
 	gRegisterArray[dst] = gRegisterArray[src0] - gRegisterArray[src1];
 }
 
 static void Lsf(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (dst <= IMMEDIATE_REGISTER || register_violation(dst, src0, src1) == true)
-        return;
-
 	gRegisterArray[dst] = gRegisterArray[src0] << gRegisterArray[src1];
 }
 
 static void Rsf(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (dst <= IMMEDIATE_REGISTER || register_violation(dst, src0, src1) == true)
-        return;
-
 	gRegisterArray[dst] = gRegisterArray[src0] >> gRegisterArray[src1];
 }
 
 static void And(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (dst <= IMMEDIATE_REGISTER || register_violation(dst, src0, src1) == true)
-        return;
-
 	gRegisterArray[dst] = gRegisterArray[src0] & gRegisterArray[src1];
 }
 
 static void Or(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (dst <= IMMEDIATE_REGISTER || register_violation(dst, src0, src1) == true)
-        return;
-
     gRegisterArray[dst] = gRegisterArray[src0] | gRegisterArray[src1];
 }
 
 static void Xor(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (dst <= IMMEDIATE_REGISTER || register_violation(dst, src0, src1) == true)
-        return;
-    
    gRegisterArray[dst] = gRegisterArray[src0] ^ gRegisterArray[src1];
 }
 
 static void Lhi(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (dst <= IMMEDIATE_REGISTER || register_violation(dst, src0, src1) == true)
-        return;
-    
     gRegisterArray[dst] &= 0x0000FFFF;                                    // clean 16bit MSB
     gRegisterArray[dst] |= (gRegisterArray[IMMEDIATE_REGISTER] << 16);    // store immediate value at the 16bit MSB
 }
 
 static void Ld(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (dst <= IMMEDIATE_REGISTER || check_for_memory_error(gRegisterArray[src1]) == true || register_violation(dst, src0, src1) == true)
+    if (check_for_memory_error(gRegisterArray[src1]) == true)
         return;
 
     gRegisterArray[dst] = gMemory[gRegisterArray[src1]];
@@ -235,53 +557,40 @@ static void Ld(uint16_t dst, uint16_t src0, uint16_t src1)
 
 static void St(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (check_for_memory_error(gRegisterArray[src1]) == true || register_violation(dst, src0, src1) == true)
+    if (check_for_memory_error(gRegisterArray[src1]) == true)
         return;
 
-	gMemory[gRegisterArray[src1]] = gRegisterArray[src0];
+    gMemory[gRegisterArray[src1]] = gRegisterArray[src0];
+    gDecoded[gRegisterArray[src1]].opcode = NULL;       // code written over runs decoded again
+    gThreaded[gRegisterArray[src1]].handler = T_TRANSLATE;
 }
 
 static void Jlt(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (register_violation(dst, src0, src1) == true)
-        return;
-
     if (gRegisterArray[src0] < gRegisterArray[src1])
 		Jump(gRegisterArray[IMMEDIATE_REGISTER]);
 }
 
 static void Jle(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (register_violation(dst, src0, src1) == true)
-        return;
-        
     if (gRegisterArray[src0] <= gRegisterArray[src1])
 		Jump(gRegisterArray[IMMEDIATE_REGISTER]);
 }
 
 static void Jeq(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (register_violation(dst, src0, src1) == true)
-        return;
-        
 	if (gRegisterArray[src0] == gRegisterArray[src1])
 		Jump(gRegisterArray[IMMEDIATE_REGISTER]);
 }
 
 static void Jne(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (register_violation(dst, src0, src1) == true)
-        return;
-        
 	if (gRegisterArray[src0] != gRegisterArray[src1])
 		Jump(gRegisterArray[IMMEDIATE_REGISTER]);    
 }
 
 static void Jin(uint16_t dst, uint16_t src0, uint16_t src1)
 {
-    if (register_violation(dst, src0, src1) == true)
-        return;
-        
     Jump(gRegisterArray[src0]);    
 }
 
@@ -290,12 +599,112 @@ static void Hlt(uint16_t dst, uint16_t src0, uint16_t src1)
 	gProgramIsRunning = 0;
 }
 
+static void None(uint16_t dst, uint16_t src0, uint16_t src1)
+{
+}
+
 static void Jump(uint16_t pc_location)
 {
     gRegisterArray[BRANCH_REGISTER_STORE_VALUE] = gProgramCounter - 1; // taking -1 because we increment the counter before executing the function
 	gProgramCounter = pc_location;
 }
 
+static const opcode_s *find_opcode(uint16_t opcode)
+{
+    for(int i = 0; i < NUMBER_OF_OPCODES; i++)
+	{
+		if (OpcodeMapping[i].code == opcode)
+			return &OpcodeMapping[i];
+	}
+    //
+    // We get an invalid opcode, so we will exit
+    printf("Wrong opcode was passed (%u), exit the program", opcode);
+    return &OpcodeMapping[NUMBER_OF_OPCODES - 1];    // return halt command
+}
+
+// translate pc, the first instruction of a superinstruction when it starts one
+static void translate(uint16_t pc)
+{
+    threaded_e handler = translate_single(pc, false), second, third;
+
+    if (handler == T_LD || handler == T_ADD || handler == T_ST)
+    {
+        second = translate_single(pc + 1, true);
+        if (handler == T_LD && second == T_ADD)
+            handler = T_LD_ADD;
+        else if (handler == T_ADD && second >= T_JLT && second <= T_JNE)
+            handler = T_ADD_JLT + (second - T_JLT);
+        else if (handler == T_ST && second == T_ADD)
+        {
+            third = translate_single(pc + 2, true);
+            if (third >= T_JLT && third <= T_JNE)
+                handler = T_ST_ADD_JLT + (third - T_JLT);
+        }
+    }
+    gThreaded[pc].handler = handler;
+}
+
+// the operands of the slot and its handler alone. the handler isn't set,
+// the slot may be the second or third of a superinstruction.
+static threaded_e translate_single(uint16_t pc, bool ahead)
+{
+    threaded_s *threaded = &gThreaded[pc];
+    uint32_t command = gMemory[pc];
+    decoded_s decoded;
+
+    // an invalid opcode is reported when it runs, not when looked at ahead of it
+    if (ahead == true && known_opcode((command >> 25) & 0x1f) == false)
+        return T_HLT;
+
+    Mapper_Decode(&decoded, command);
+    threaded->dst = (uint8_t)decoded.dst;
+    threaded->src0 = (uint8_t)decoded.src0;
+    threaded->src1 = (uint8_t)decoded.src1;
+    threaded->immediate = decoded.immediate;
+    if (decoded.OperationFunction == None)
+        return T_NOP;
+
+    switch (decoded.opcode->code)
+    {
+        case ADD: return T_ADD;
+        case SUB: return T_SUB;
+        case LSF: return T_LSF;
+        case RSF: return T_RSF;
+        case AND: return T_AND;
+        case OR:  return T_OR;
+        case XOR: return T_XOR;
+        case LHI: return T_LHI;
+        case LD:  return T_LD;
+        case ST:  return T_ST;
+        case JLT: return T_JLT;
+        case JLE: return T_JLE;
+        case JEQ: return T_JEQ;
+        case JNE: return T_JNE;
+        case JIN: return T_JIN;
+        default:  return T_HLT;
+    }
+}
+
+// a store of the threaded engine to address drops its translations, and the
+// superinstructions reaching over it. St() has none of those to drop.
+static void invalidate(uint32_t address)
+{
+    gDecoded[address].opcode = NULL;
+    gThreaded[address].handler = T_TRANSLATE;
+    gThreaded[(uint16_t)(address - 1)].handler = T_TRANSLATE;
+    gThreaded[(uint16_t)(address - 2)].handler = T_TRANSLATE;
+}
+
+static bool known_opcode(uint16_t opcode)
+{
+    for(int i = 0; i < NUMBER_OF_OPCODES; i++)
+	{
+		if (OpcodeMapping[i].code == opcode)
+			return true;
+	}
+    return false;
+}
+
 static bool check_for_memory_error(uint32_t address)
 {
     if (address >= MAX_MEMORY_SIZE)
@@ -31,6 +31,8 @@ ALL RIGHTS RESERVED
 #define MAX_LINE			10
 #define MAX_MEMORY_SIZE 	(1 << 16)
 #define NUMBER_OF_REGISTERS 8
+#define BRANCH_REGISTER_STORE_VALUE 7
+#define IMMEDIATE_REGISTER          1
 
 /************************************
 *       types                       *
@@ -62,6 +64,18 @@ typedef struct
 	void (*OperationFunction)(uint16_t dst, uint16_t src0, uint16_t src1);   // opcode operation function
 }opcode_s;
 
+// an instruction as the predecode cache holds it, see Mapper_GetNextDecoded()
+typedef struct
+{
+	uint32_t command;                                                        // instruction word
+	const opcode_s *opcode;                                                  // NULL while the entry isn't decoded
+	void (*OperationFunction)(uint16_t dst, uint16_t src0, uint16_t src1);   // opcode function, or none when it can't have an effect
+	uint16_t immediate;
+	uint16_t dst;
+	uint16_t src0;
+	uint16_t src1;
+}decoded_s;
+
 /************************************
 *       API                         *
 ************************************/
@@ -71,14 +85,16 @@ typedef struct
  Init memory array.
 
 \details
- init memory by the input file
+ init memory by the input file, hex words, a raw binary or an sp
+ executable, and set the pc to its entry, see Loader.h. exits on a bad file.
 
 \param
  [in] memoryFile - file contianing the memory data.
+ [in] memoryFileName - name of the file.
 
 \return none
 *****************************************************************************/
-uint16_t Mapper_InitMemory(FILE *memoryFile);
+uint16_t Mapper_InitMemory(FILE *memoryFile, const char *memoryFileName);
 
 /*!
 ******************************************************************************
@@ -118,6 +134,15 @@ Get value from memory
 *****************************************************************************/
 uint32_t Mapper_GetFromMemory(uint16_t location);
 
+/*!
+******************************************************************************
+\brief
+Get the whole memory
+
+\return the MAX_MEMORY_SIZE words of the memory
+*****************************************************************************/
+const uint32_t *Mapper_GetMemory(void);
+
 /*!
 ******************************************************************************
 \brief
@@ -134,6 +159,78 @@ uint32_t Mapper_GetFromMemory(uint16_t location);
 *****************************************************************************/
 uint32_t Mapper_GetNextInstruction(uint16_t *pc);
 
+/*!
+******************************************************************************
+\brief
+ Get the next instruction, decoded
+
+\details
+ like Mapper_GetNextInstruction(), and sets the immediate register too.
+ every memory word is decoded the first time it runs and kept by pc: the
+ operation function, the operands and the immediate. register and
+ destination checks are done then, so the function is called as it is.
+ a store to a decoded word drops its entry.
+
+\param
+ [out] pc - program counter value
+
+\return the decoded instruction
+*****************************************************************************/
+const decoded_s *Mapper_GetNextDecoded(uint16_t *pc);
+
+/*!
+******************************************************************************
+\brief
+ Run the program till HALT, on the threaded engine
+
+\details
+ memory words are translated, the first time they run, to threaded code:
+ a handler and its operands. each handler goes straight on to the next
+ instruction's, by computed goto where the compiler has it and a switch
+ otherwise, so nothing is returned to the caller per instruction.
+ the program runs as it would on Mapper_GetNextDecoded(), a store drops
+ the translation of the word it writes.
+
+\param
+ [out] pc - program counter of the last instruction run
+
+\return number of instructions run, the HALT included
+*****************************************************************************/
+uint32_t Mapper_Run(uint16_t *pc);
+
+/*!
+******************************************************************************
+\brief
+ Run the program till HALT, translated to native code
+
+\details
+ on Dbt_Run(), see Dbt.h, and on Mapper_Run() where there is no
+ translation. ends as Mapper_Run() does.
+
+\param
+ [out] pc - program counter of the last instruction run
+
+\return number of instructions run, the HALT included
+*****************************************************************************/
+uint32_t Mapper_RunTranslated(uint16_t *pc);
+
+/*!
+******************************************************************************
+\brief
+ Decode an instruction
+
+\details
+ as Mapper_GetNextDecoded() does, an instruction that can't have an
+ effect gets a function other than its opcode's.
+
+\param
+ [out] decoded - the decoded instruction
+ [in] command - instruction command
+
+\return none
+*****************************************************************************/
+void Mapper_Decode(decoded_s *decoded, uint32_t command);
+
 /*!
 ******************************************************************************
 \brief
@@ -173,4 +270,16 @@ void Mapper_SetImmediateRegister(uint16_t imm_value);
 *****************************************************************************/
 void Mapper_GetRegistersSnapshot(uint32_t regs[NUMBER_OF_REGISTERS]);
 
+/*!
+******************************************************************************
+\brief
+ Get a register
+
+\param
+ [in] index - register number
+
+\return the register value at this moment
+*****************************************************************************/
+uint32_t Mapper_GetRegister(uint16_t index);
+
 #endif // __MAPPER_H_
\ No newline at end of file
@@ -0,0 +1,249 @@
+/*!
+******************************************************************************
+\file Profiler.c
+\date 17 October 2026
+\author Rony Kositsky & Ofir Guthman
+\brief
+    profiler of the simulated program
+
+\details
+
+\par Copyright
+(c) Copyright 2021 Ofir & Rony
+\par
+ALL RIGHTS RESERVED
+*****************************************************************************/
+
+/************************************
+*      include                      *
+************************************/
+#include "Profiler.h"
+#include "Mapper.h"
+//
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/************************************
+*      definitions                 *
+************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#define OPCODE(command)     (((command) >> 25) & 31)
+
+/************************************
+*       types                       *
+************************************/
+typedef struct
+{
+    uint64_t count[MAX_MEMORY_SIZE];        // executions
+    uint64_t cycles[MAX_MEMORY_SIZE];       // cycles charged
+    uint64_t loopIterations[MAX_MEMORY_SIZE]; // backward jumps to the pc
+    int32_t loopEnd[MAX_MEMORY_SIZE];       // farthest pc jumping back to it
+    uint32_t command[MAX_MEMORY_SIZE];
+    bool jumpTarget[MAX_MEMORY_SIZE];
+    int32_t previousPc;                     // -1 before the first instruction
+} profile_s;
+
+// one line of a report: a pc, a block or a loop
+typedef struct
+{
+    int32_t first;
+    int32_t last;
+    uint64_t count;
+    uint64_t cycles;
+} profile_entry_s;
+
+/************************************
+*      variables                    *
+************************************/
+static profile_s *gProfile = NULL;
+
+static const char *gOpcodeNames[32] =
+{
+    "ADD", "SUB", "LSF", "RSF", "AND", "OR", "XOR", "LHI",
+    "LD", "ST", "U", "U", "U", "U", "U", "U",
+    "JLT", "JLE", "JEQ", "JNE", "JIN", "U", "U", "U",
+    "HLT", "U", "U", "U", "U", "U", "U", "U"
+};
+
+/************************************
+*      static functions             *
+************************************/
+static bool is_control(int32_t pc);
+static bool is_leader(int32_t pc);
+static uint64_t range_cycles(int32_t first, int32_t last);
+static int compare_entries(const void *a, const void *b);
+static double percent(uint64_t part, uint64_t total);
+
+/************************************
+*       API implementation          *
+************************************/
+bool Profiler_Init(void)
+{
+    gProfile = calloc(1, sizeof(profile_s));
+    if (gProfile == NULL)
+        return false;
+
+    gProfile->previousPc = -1;
+    return true;
+}
+
+void Profiler_Instruction(uint16_t pc, uint32_t command, uint32_t cycles)
+{
+    gProfile->count[pc]++;
+    gProfile->cycles[pc] += cycles;
+    gProfile->command[pc] = command;
+
+    if (gProfile->previousPc >= 0 && pc != gProfile->previousPc + 1)
+    {
+        gProfile->jumpTarget[pc] = true;
+        if (pc <= gProfile->previousPc)
+        {
+            gProfile->loopIterations[pc]++;
+            if (gProfile->loopEnd[pc] < gProfile->previousPc)
+                gProfile->loopEnd[pc] = gProfile->previousPc;
+        }
+    }
+    gProfile->previousPc = pc;
+}
+
+void Profiler_Report(const char *programName, FILE *reportFile, FILE *foldedFile)
+{
+    profile_entry_s *entries = malloc(MAX_MEMORY_SIZE * sizeof(profile_entry_s));
+    uint64_t instructions = 0, cycles = 0, cumulative = 0;
+    int32_t pc, last, leaf, n, i;
+
+    if (entries == NULL)
+    {
+        printf("Error: out of memory. \n");
+        return;
+    }
+
+    for (pc = 0; pc < MAX_MEMORY_SIZE; pc++)
+    {
+        instructions += gProfile->count[pc];
+        cycles += gProfile->cycles[pc];
+    }
+    fprintf(reportFile, "profile of %s: %llu instructions in %llu cycles\n", programName,
+            (unsigned long long)instructions, (unsigned long long)cycles);
+
+    // hot spots
+    for (pc = 0, n = 0; pc < MAX_MEMORY_SIZE; pc++)
+    {
+        if (gProfile->count[pc] == 0)
+            continue;
+        entries[n].first = entries[n].last = pc;
+        entries[n].count = gProfile->count[pc];
+        entries[n].cycles = gProfile->cycles[pc];
+        n++;
+    }
+    qsort(entries, n, sizeof(*entries), compare_entries);
+    fprintf(reportFile, "\nhot spots\n");
+    fprintf(reportFile, "   pc      inst  op           count        cycles       %%    cum%%\n");
+    for (i = 0; i < n; i++)
+    {
+        cumulative += entries[i].cycles;
+        fprintf(reportFile, " %04x  %08x  %-3s %14llu %13llu  %6.2f  %6.2f\n", entries[i].first,
+                gProfile->command[entries[i].first], gOpcodeNames[OPCODE(gProfile->command[entries[i].first])],
+                (unsigned long long)entries[i].count, (unsigned long long)entries[i].cycles,
+                percent(entries[i].cycles, cycles), percent(cumulative, cycles));
+    }
+
+    // basic blocks, the collapsed stacks on the way
+    for (pc = 0, n = 0; pc < MAX_MEMORY_SIZE; pc++)
+    {
+        if (is_leader(pc) == false)
+            continue;
+        for (last = pc; last + 1 < MAX_MEMORY_SIZE && is_control(last) == false &&
+                        gProfile->count[last + 1] != 0 && is_leader(last + 1) == false; last++)
+            ;
+        entries[n].first = pc;
+        entries[n].last = last;
+        entries[n].count = gProfile->count[pc];
+        entries[n].cycles = range_cycles(pc, last);
+        for (leaf = pc; leaf <= last; leaf++)
+        {
+            if (gProfile->cycles[leaf] != 0)
+                fprintf(foldedFile, "%s;block_%04x;%04x_%s %llu\n", programName, pc, leaf,
+                        gOpcodeNames[OPCODE(gProfile->command[leaf])], (unsigned long long)gProfile->cycles[leaf]);
+        }
+        n++;
+    }
+    qsort(entries, n, sizeof(*entries), compare_entries);
+    fprintf(reportFile, "\nbasic blocks\n");
+    fprintf(reportFile, " first  last  size          count        cycles       %%\n");
+    for (i = 0; i < n; i++)
+        fprintf(reportFile, "  %04x  %04x  %4d %14llu %13llu  %6.2f\n", entries[i].first, entries[i].last,
+                entries[i].last - entries[i].first + 1, (unsigned long long)entries[i].count,
+                (unsigned long long)entries[i].cycles, percent(entries[i].cycles, cycles));
+
+    // loops, from the target of a backward jump to the farthest jump back
+    for (pc = 0, n = 0; pc < MAX_MEMORY_SIZE; pc++)
+    {
+        if (gProfile->loopIterations[pc] == 0)
+            continue;
+        entries[n].first = pc;
+        entries[n].last = gProfile->loopEnd[pc];
+        entries[n].count = gProfile->loopIterations[pc];
+        entries[n].cycles = range_cycles(pc, gProfile->loopEnd[pc]);
+        n++;
+    }
+    qsort(entries, n, sizeof(*entries), compare_entries);
+    fprintf(reportFile, "\nhot loops\n");
+    fprintf(reportFile, " first  last     iterations        cycles       %%\n");
+    for (i = 0; i < n; i++)
+        fprintf(reportFile, "  %04x  %04x %14llu %13llu  %6.2f\n", entries[i].first, entries[i].last,
+                (unsigned long long)entries[i].count, (unsigned long long)entries[i].cycles,
+                percent(entries[i].cycles, cycles));
+
+    free(entries);
+}
+
+void Profiler_Free(void)
+{
+    free(gProfile);
+    gProfile = NULL;
+}
+
+/************************************
+* static implementation             *
+************************************/
+// the instruction ends a basic block
+static bool is_control(int32_t pc)
+{
+    uint32_t opcode = OPCODE(gProfile->command[pc]);
+
+    return (opcode >= JLT && opcode <= JIN) || opcode == HLT;
+}
+
+static bool is_leader(int32_t pc)
+{
+    return gProfile->count[pc] != 0 &&
+           (pc == 0 || gProfile->count[pc - 1] == 0 || gProfile->jumpTarget[pc] == true || is_control(pc - 1) == true);
+}
+
+static uint64_t range_cycles(int32_t first, int32_t last)
+{
+    uint64_t cycles = 0;
+
+    for (int32_t pc = first; pc <= last; pc++)
+        cycles += gProfile->cycles[pc];
+    return cycles;
+}
+
+// most cycles first, then by pc
+static int compare_entries(const void *a, const void *b)
+{
+    const profile_entry_s *x = a, *y = b;
+
+    if (x->cycles != y->cycles)
+        return x->cycles < y->cycles ? 1 : -1;
+    return x->first - y->first;
+}
+
+static double percent(uint64_t part, uint64_t total)
+{
+    return total ? 100.0 * part / total : 0.0;
+}
@@ -0,0 +1,86 @@
+/*!
+******************************************************************************
+\file Profiler.h
+\date 17 October 2026
+\author Rony Kositsky & Ofir Guthman
+\brief
+    profiler of the simulated program
+
+\details
+    counts the executions of every pc and finds the basic blocks and loops
+    of the executed instruction stream. the iss has no timing, an
+    instruction is one cycle.
+    a pc is a block leader when it follows a branch or is reached by a
+    jump, a backward jump closes a loop from its target to the jump.
+
+\par Copyright
+(c) Copyright 2021 Ofir & Rony
+\par
+ALL RIGHTS RESERVED
+*****************************************************************************/
+
+#ifndef __PROFILER_H_
+#define __PROFILER_H_
+
+/************************************
+*      include                      *
+************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/************************************
+*       API                         *
+************************************/
+/*!
+******************************************************************************
+\brief
+ Start profiling.
+
+\return true on success, false when out of memory
+*****************************************************************************/
+bool Profiler_Init(void);
+
+/*!
+******************************************************************************
+\brief
+ Account an executed instruction.
+
+\param
+ [in] pc - program counter of the instruction
+ [in] command - instruction command
+ [in] cycles - cycles the instruction took
+
+\return none
+*****************************************************************************/
+void Profiler_Instruction(uint16_t pc, uint32_t command, uint32_t cycles);
+
+/*!
+******************************************************************************
+\brief
+ Write the profile.
+
+\details
+ the report has the hot spots, basic blocks and loops sorted by cycles.
+ the folded file has a program;block;instruction line per pc with its
+ cycles, the collapsed stack input of flame graph tools.
+
+\param
+ [in] programName - name of the program, root frame of the stacks
+ [in] reportFile - report output
+ [in] foldedFile - collapsed stacks output
+
+\return none
+*****************************************************************************/
+void Profiler_Report(const char *programName, FILE *reportFile, FILE *foldedFile);
+
+/*!
+******************************************************************************
+\brief
+ Stop profiling, release the profile.
+
+\return none
+*****************************************************************************/
+void Profiler_Free(void);
+
+#endif // __PROFILER_H_
@@ -0,0 +1,357 @@
+/*!
+******************************************************************************
+\file Trace.c
+\date 17 October 2026
+\author Rony Kositsky & Ofir Guthman
+\brief
+    per-instruction trace of the simulated program
+
+\details
+    the sinks format into a buffer of their own and write it out when it
+    fills up, the text sink without printf.
+
+\par Copyright
+(c) Copyright 2021 Ofir & Rony
+\par
+ALL RIGHTS RESERVED
+*****************************************************************************/
+
+/************************************
+*      include                      *
+************************************/
+#include "Trace.h"
+#include "Mapper.h"
+//
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/************************************
+*      definitions                 *
+************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#define TRACE_BUFFER_SIZE   (1 << 16)
+#define TRACE_RECORD_ROOM   1024            // more than a record takes, in either format
+#define TRACE_BINARY_RECORD 11
+#define TRACE_NO_REGISTER   0xff
+//
+#define OPCODE(command)     (((command) >> 25) & 31)
+
+/************************************
+*       types                       *
+************************************/
+typedef struct
+{
+    const char *name;
+    bool snapshot;                                      // needs the registers before
+    bool (*Open)(void);
+    void (*Instruction)(const trace_record_s *record);  // NULL for no records
+} trace_sink_s;
+
+/************************************
+*      variables                    *
+************************************/
+static FILE *gTraceFile = NULL;
+static FILE *gBinaryFile = NULL;
+static const trace_sink_s *gSink = NULL;
+//
+static char gBuffer[TRACE_BUFFER_SIZE];
+static char *gPut = gBuffer;
+static bool gWriteFailed = false;
+
+/************************************
+*      static functions             *
+************************************/
+static bool text_open(void);
+static void text_instruction(const trace_record_s *record);
+static bool binary_open(void);
+static void binary_instruction(const trace_record_s *record);
+//
+static void write_out(FILE *file);
+static void put_string(const char *string);
+static void put_decimal(uint32_t value, int width);
+static void put_hex(uint32_t value, int width);
+static void put_le(uint32_t value, int bytes);
+
+static const char *RegisterNames[NUMBER_OF_REGISTERS] =
+{
+    "r[0] = ", " r[1] = ", " r[2] = ", " r[3] = ", " \nr[4] = ", " r[5] = ", " r[6] = ", " r[7] = "
+};
+
+static const trace_sink_s Sinks[] =
+{
+    { "text",   true,  text_open,   text_instruction },
+    { "binary", false, binary_open, binary_instruction },
+    { "null",   false, NULL,        NULL },
+};
+
+/************************************
+*       API implementation          *
+************************************/
+bool Trace_Open(const char *sinkName, FILE *traceFile)
+{
+    gTraceFile = traceFile;
+    for (size_t i = 0; i < sizeof(Sinks) / sizeof(Sinks[0]); i++)
+    {
+        if (strcmp(Sinks[i].name, sinkName) == 0)
+        {
+            gSink = &Sinks[i];
+            return gSink->Open == NULL || gSink->Open() == true;
+        }
+    }
+    return false;
+}
+
+bool Trace_Active(void)
+{
+    return gSink->Instruction != NULL;
+}
+
+bool Trace_Snapshot(void)
+{
+    return gSink->snapshot;
+}
+
+void Trace_Instruction(const trace_record_s *record)
+{
+    gSink->Instruction(record);
+}
+
+bool Trace_Close(void)
+{
+    if (gBinaryFile != NULL)
+    {
+        write_out(gBinaryFile);
+        if (fclose(gBinaryFile) != 0)
+            gWriteFailed = true;
+        gBinaryFile = NULL;
+    }
+    else
+        write_out(gTraceFile);
+    return gWriteFailed == false;
+}
+
+/************************************
+* static implementation             *
+************************************/
+static bool text_open(void)
+{
+    return true;
+}
+
+// as printf would, the registers before and the execution
+static void text_instruction(const trace_record_s *record)
+{
+    const decoded_s *decoded = record->decoded;
+    const uint32_t *regs = record->before;
+    uint32_t command = decoded->command;
+
+    put_string("--- instruction ");
+    put_decimal(record->counter, 0);
+    put_string(" (");
+    put_hex(record->counter, 4);
+    put_string(") @ PC ");
+    put_decimal(record->pc, 0);
+    put_string(" (");
+    put_hex(record->pc, 4);
+    put_string(") -----------------------------------------------------------\n");
+
+    put_string("pc = ");
+    put_decimal(record->pc, 4);
+    put_string(", inst = ");
+    put_hex(command, 8);
+    put_string(", opcode = ");
+    put_decimal(OPCODE(command), 0);
+    put_string(" (");
+    put_string(decoded->opcode->operationString);
+    put_string("), dst = ");
+    put_decimal(decoded->dst, 0);
+    put_string(", src0 = ");
+    put_decimal(decoded->src0, 0);
+    put_string(", src1 = ");
+    put_decimal(decoded->src1, 0);
+    put_string(", immediate = ");
+    put_hex(decoded->immediate, 8);
+    put_string("\n");
+
+    for (int i = 0; i < NUMBER_OF_REGISTERS; i++)
+    {
+        put_string(RegisterNames[i]);
+        put_hex(regs[i], 8);
+    }
+    put_string(" \n\n");
+
+    switch (decoded->opcode->code)
+    {
+        case ADD:
+        case SUB:
+        case LSF:
+        case RSF:
+        case AND:
+        case OR:
+        case XOR:
+        case LHI:
+            put_string(">>>> EXEC: R[");
+            put_decimal(decoded->dst, 0);
+            put_string("] = ");
+            put_decimal(regs[decoded->src0], 0);
+            put_string(" ");
+            put_string(decoded->opcode->operationString);
+            put_string(" ");
+            put_decimal(regs[decoded->src1], 0);
+            put_string(" <<<<\n\n");
+            break;
+        case LD:
+            put_string(">>>> EXEC: R[");
+            put_decimal(decoded->dst, 0);
+            put_string("] = MEM[");
+            put_decimal(regs[decoded->src1], 0);
+            put_string("] = ");
+            put_hex(Mapper_GetFromMemory((uint16_t)regs[decoded->src1]), 8);
+            put_string(" <<<<\n\n");
+            break;
+        case ST:
+            put_string(">>>> EXEC: MEM[");
+            put_decimal(regs[decoded->src1], 0);
+            put_string("] = R[");
+            put_decimal(decoded->src0, 0);
+            put_string("] = ");
+            put_hex(regs[decoded->src0], 8);
+            put_string(" <<<<\n\n");
+            break;
+        case HLT:
+            put_string(">>>> EXEC: HALT at PC ");
+            put_hex(record->pc, 4);
+            put_string("<<<<\n");
+            break;
+        case JLE:
+        case JEQ:
+        case JNE:
+        case JLT:
+        case JIN:
+            put_string(">>>> EXEC: ");
+            put_string(decoded->opcode->operationString);
+            put_string(" ");
+            put_decimal(regs[decoded->src0], 0);
+            put_string(", ");
+            put_decimal(regs[decoded->src1], 0);
+            put_string(", ");
+            put_decimal(record->next, 0);
+            put_string(" <<<<\n\n");
+            break;
+    }
+
+    if (gPut + TRACE_RECORD_ROOM > gBuffer + TRACE_BUFFER_SIZE)
+        write_out(gTraceFile);
+}
+
+static bool binary_open(void)
+{
+    if ((gBinaryFile = fopen("trace.bin", "wb")) == NULL)
+        return false;
+
+    put_string("SPTR");
+    put_le(TRACE_BINARY_RECORD, 4);
+    return true;
+}
+
+static void binary_instruction(const trace_record_s *record)
+{
+    const decoded_s *decoded = record->decoded;
+    uint8_t changed = TRACE_NO_REGISTER;
+
+    // the decoder gives a function of no effect to what can't have one
+    if (decoded->OperationFunction == decoded->opcode->OperationFunction)
+    {
+        switch (decoded->opcode->code)
+        {
+            case ADD:
+            case SUB:
+            case LSF:
+            case RSF:
+            case AND:
+            case OR:
+            case XOR:
+            case LHI:
+            case LD:
+                changed = (uint8_t)decoded->dst;
+                break;
+            case JLT:
+            case JLE:
+            case JEQ:
+            case JNE:
+            case JIN:
+                if (record->next != (uint16_t)(record->pc + 1) || Mapper_GetRegister(BRANCH_REGISTER_STORE_VALUE) == record->pc)
+                    changed = BRANCH_REGISTER_STORE_VALUE;
+                break;
+            default:
+                break;
+        }
+    }
+
+    put_le(record->pc, 2);
+    put_le(decoded->command, 4);
+    put_le(changed, 1);
+    put_le(changed == TRACE_NO_REGISTER ? 0 : Mapper_GetRegister(changed), 4);
+
+    if (gPut + TRACE_RECORD_ROOM > gBuffer + TRACE_BUFFER_SIZE)
+        write_out(gBinaryFile);
+}
+
+static void write_out(FILE *file)
+{
+    size_t size = (size_t)(gPut - gBuffer);
+
+    if (size > 0 && fwrite(gBuffer, 1, size, file) != size)
+        gWriteFailed = true;
+    gPut = gBuffer;
+}
+
+static void put_string(const char *string)
+{
+    while (*string != '\0')
+        *gPut++ = *string++;
+}
+
+// zero padded to width
+static void put_decimal(uint32_t value, int width)
+{
+    char digits[10];
+    int n = 0;
+
+    do
+    {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    for (; width > n; width--)
+        *gPut++ = '0';
+    while (n > 0)
+        *gPut++ = digits[--n];
+}
+
+// lower case, zero padded to width
+static void put_hex(uint32_t value, int width)
+{
+    static const char hex[] = "0123456789abcdef";
+    char digits[8];
+    int n = 0;
+
+    do
+    {
+        digits[n++] = hex[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+    for (; width > n; width--)
+        *gPut++ = '0';
+    while (n > 0)
+        *gPut++ = digits[--n];
+}
+
+static void put_le(uint32_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        *gPut++ = (char)((value >> (8 * i)) & 0xff);
+}
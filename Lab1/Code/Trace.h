@@ -0,0 +1,108 @@
+/*!
+******************************************************************************
+\file Trace.h
+\date 17 October 2026
+\author Rony Kositsky & Ofir Guthman
+\brief
+    per-instruction trace of the simulated program
+
+\details
+    the records go to a sink chosen by name:
+    text    the trace.txt format, the registers before and the execution
+            of every instruction
+    binary  trace.bin, a "SPTR" header, the record size (uint32) and a
+            record per instruction: pc (uint16), inst (uint32), the
+            register it changed (uint8, 0xff for none) and the value of
+            that register after it (uint32), all little endian. an
+            instruction that may have changed a register records it,
+            a jump records r7 when it took or r7 holds its pc anyway.
+    null    nothing, the program runs without stopping per instruction
+    a sink asks for the registers before the instruction when it needs
+    them, the others save the snapshot.
+
+\par Copyright
+(c) Copyright 2021 Ofir & Rony
+\par
+ALL RIGHTS RESERVED
+*****************************************************************************/
+
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+/************************************
+*      include                      *
+************************************/
+#include "Mapper.h"
+//
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/************************************
+*       types                       *
+************************************/
+typedef struct
+{
+    uint16_t counter;               // instructions before this one
+    uint16_t pc;
+    const decoded_s *decoded;
+    const uint32_t *before;         // registers before it ran, when the sink takes a snapshot
+    uint16_t next;                  // pc after it ran
+} trace_record_s;
+
+/************************************
+*       API                         *
+************************************/
+/*!
+******************************************************************************
+\brief
+ Choose the sink and open it.
+
+\param
+ [in] sinkName - text, binary or null
+ [in] traceFile - trace.txt, the text sink writes its records there
+
+\return true on success, false for an unknown sink or when it can't open
+*****************************************************************************/
+bool Trace_Open(const char *sinkName, FILE *traceFile);
+
+/*!
+******************************************************************************
+\brief
+ Does the sink take records.
+
+\return false for the null sink
+*****************************************************************************/
+bool Trace_Active(void);
+
+/*!
+******************************************************************************
+\brief
+ Does the sink need the registers before the instruction.
+
+\return true when trace_record_s before has to be set
+*****************************************************************************/
+bool Trace_Snapshot(void);
+
+/*!
+******************************************************************************
+\brief
+ Trace an instruction, after it ran.
+
+\param
+ [in] record - the instruction
+
+\return none
+*****************************************************************************/
+void Trace_Instruction(const trace_record_s *record);
+
+/*!
+******************************************************************************
+\brief
+ Write out what the sink holds and close it.
+
+\return true on success, false when a write failed
+*****************************************************************************/
+bool Trace_Close(void);
+
+#endif // __TRACE_H_
@@ -19,6 +19,9 @@ ALL RIGHTS RESERVED
 *      include                      *
 ************************************/
 #include "Mapper.h"
+#include "Profiler.h"
+#include "Dump.h"
+#include "Trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -31,24 +34,6 @@ ALL RIGHTS RESERVED
 #define _CRT_SECURE_NO_WARNINGS
 
 
-/************************************
-*       types                       *
-************************************/
-typedef union
-{
-	struct
-	{
-		uint16_t immediate		: 16;	// [0:15]  Immediate value
-		uint16_t source_1		: 3;	// [16:18] src1 value
-		uint16_t source_0		: 3;	// [19:21] src0 value
-		uint16_t destination	: 3;	// [22:24] src0 value
-		uint16_t opcode			: 5;	// [25:29] opcode value
-		uint16_t not_in_use		: 2;	// not relevant
-	} bits;
-	
-	uint32_t command;
-} instruction_format_s;
-
 /************************************
 *      variables                    *
 ************************************/
@@ -57,6 +42,8 @@ static FILE* gMemoryInFile = NULL;
 static FILE* gMemoryOutFile = NULL;
 static FILE* gTraceFile = NULL;
 //
+// memory as loaded, for a delta dump
+static uint32_t *gLoadedMemory = NULL;
 //
 static uint16_t gLinesInProgram = 0;
 //
@@ -66,10 +53,8 @@ static uint16_t gLinesInProgram = 0;
 //
 static struct
 {
-	instruction_format_s instruction_code;
 	uint16_t instruction_counter;
 	uint16_t program_counter;
-	opcode_s opcode;
 } gInstructionData;
 
 
@@ -81,57 +66,118 @@ static void initialize(void);
 static void OpenFiles(char *inputFileName);
 static void CloseFiles(void);
 //
-static void PrintRawData(uint32_t regs[NUMBER_OF_REGISTERS]);
-static void PrintExecLine(uint32_t regs[NUMBER_OF_REGISTERS]);
-static void MemoryDump(void);
+static void MemoryDump(bool hash);
+static void ProfileDump(char *inputFileName);
 
 /************************************
 *       API implementation          *
 ************************************/
 int main(int argc, char* argv[])
 {
-	// check if there is exact args.
-	assert(argc == 2);
+	// check args: iss [-p] [-d] [-h] [-t sink] [-q] program, -p profiles the program, -d dumps
+	// only the words changed from the program, -h adds the dump hash to sram_hash.txt,
+	// -t traces the instructions to a text (trace.txt, the default), binary (trace.bin)
+	// or null sink, see Trace.h, -q is -t null.
+	bool profile = false, delta = false, hash = false;
+	const char *sink = "text";
+	assert(argc >= 2);
+	for (int i = 1; i < argc - 1; i++)
+	{
+		if (strcmp(argv[i], "-p") == 0)
+			profile = true;
+		else if (strcmp(argv[i], "-d") == 0)
+			delta = true;
+		else if (strcmp(argv[i], "-h") == 0)
+			hash = true;
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc - 1)
+			sink = argv[++i];
+		else if (strcmp(argv[i], "-q") == 0)
+			sink = "null";
+		else
+			assert(false);
+	}
 
 	// init all variables.
 	initialize();
 
-	char* inputFileName = argv[1];
+	char* inputFileName = argv[argc - 1];
 	OpenFiles(inputFileName);
+	if (Trace_Open(sink, gTraceFile) == false)
+	{
+		printf("Error: failed opening trace sink %s. \n", sink);
+		exit(1);
+	}
+	if (profile == true && Profiler_Init() == false)
+	{
+		printf("Error: out of memory. \n");
+		exit(1);
+	}
 
 	// init memory
-	uint16_t linesInProgram = Mapper_InitMemory(gMemoryInFile);
+	uint16_t linesInProgram = Mapper_InitMemory(gMemoryInFile, inputFileName);
 	fprintf(gTraceFile, "program %s loaded, %d lines\n\n", inputFileName, linesInProgram);
+	if (delta == true)
+	{
+		if ((gLoadedMemory = malloc(MAX_MEMORY_SIZE * sizeof(uint32_t))) == NULL)
+		{
+			printf("Error: out of memory. \n");
+			exit(1);
+		}
+		memcpy(gLoadedMemory, Mapper_GetMemory(), MAX_MEMORY_SIZE * sizeof(uint32_t));
+	}
+
+	// nothing to see per instruction, the program runs translated all at once
+	bool trace = Trace_Active(), snapshot = Trace_Snapshot();
+	if (trace == false && profile == false)
+		gInstructionData.instruction_counter = (uint16_t)Mapper_RunTranslated(&gInstructionData.program_counter);
 
 	while (Mapper_IsProgramRunning())
 	{
-		// get command from memory & parse the command
-		gInstructionData.instruction_code.command = Mapper_GetNextInstruction(&gInstructionData.program_counter);
-        // set immediate register
-        Mapper_SetImmediateRegister(gInstructionData.instruction_code.bits.immediate);
-
-		// Get opcode function
-		gInstructionData.opcode = Mapper_GetOpcode(gInstructionData.instruction_code.bits.opcode);
+		// get the decoded command from memory, this sets the immediate register
+		const decoded_s *decoded = Mapper_GetNextDecoded(&gInstructionData.program_counter);
 
-		// Print trace
+		// the registers before, only for a sink showing them, and the instruction
+		// as it is now, a store may drop its decoded entry
         uint32_t regs[NUMBER_OF_REGISTERS];
-        Mapper_GetRegistersSnapshot(regs);
-        PrintRawData(regs);
+        decoded_s traced;
+        if (snapshot == true)
+            Mapper_GetRegistersSnapshot(regs);
+        if (trace == true)
+            traced = *decoded;
 
 		// execute operation
-		gInstructionData.opcode.OperationFunction(gInstructionData.instruction_code.bits.destination,
-													gInstructionData.instruction_code.bits.source_0,
-													gInstructionData.instruction_code.bits.source_1);
-        
-        PrintExecLine(regs);
+		decoded->OperationFunction(decoded->dst, decoded->src0, decoded->src1);
+
+		// Print trace
+        if (trace == true)
+        {
+            trace_record_s record = { gInstructionData.instruction_counter, gInstructionData.program_counter,
+                                      &traced, regs, Mapper_GetProgramCounter() };
+            Trace_Instruction(&record);
+        }
+
+		// no timing in the iss, every instruction is a cycle
+		if (profile == true)
+			Profiler_Instruction(gInstructionData.program_counter, decoded->command, 1);
 
 		// Increase counters
 		gInstructionData.instruction_counter++;
 	}
 
+	if (Trace_Close() == false)
+	{
+		printf("Error: failed writing the trace. \n");
+		exit(1);
+	}
     fprintf(gTraceFile, "sim finished at pc %u, %u instructions", gInstructionData.program_counter, gInstructionData.instruction_counter);
-    MemoryDump();
+    MemoryDump(hash);
 	CloseFiles();
+	free(gLoadedMemory);
+	if (profile == true)
+	{
+		ProfileDump(inputFileName);
+		Profiler_Free();
+	}
 
     return 0;
 }
@@ -161,62 +207,46 @@ static void CloseFiles(void)
 	fclose(gTraceFile);
 }
 
-static void PrintRawData(uint32_t regs[NUMBER_OF_REGISTERS])
+static void MemoryDump(bool hash)
 {
-	instruction_format_s *ins_code = &gInstructionData.instruction_code;
-
-	fprintf(gTraceFile, "--- instruction %i (%04x) @ PC %ld (%04lx) -----------------------------------------------------------\n",
-		gInstructionData.instruction_counter, gInstructionData.instruction_counter, gInstructionData.program_counter, gInstructionData.program_counter);
-	fprintf(gTraceFile, "pc = %04ld, inst = %08lx, opcode = %ld (%s), dst = %ld, src0 = %ld, src1 = %ld, immediate = %08lx\n", 
-		gInstructionData.program_counter, ins_code->command, ins_code->bits.opcode, gInstructionData.opcode.operationString,
-		ins_code->bits.destination, ins_code->bits.source_0, ins_code->bits.source_1, ins_code->bits.immediate);
+	FILE *hashFile;
 
-	fprintf(gTraceFile, "r[0] = %08lx r[1] = %08lx r[2] = %08lx r[3] = %08lx \nr[4] = %08lx r[5] = %08lx r[6] = %08lx r[7] = %08lx \n\n",
-		regs[0], regs[1], regs[2], regs[3], regs[4], regs[5], regs[6], regs[7]);
+	if (Dump_Write(gMemoryOutFile, Mapper_GetMemory(), gLoadedMemory, MAX_MEMORY_SIZE) == false)
+	{
+		printf("Error: failed writing sram_out.txt. \n");
+		exit(1);
+	}
+	if (hash == true)
+	{
+		if ((hashFile = fopen("sram_hash.txt", "w")) == NULL)
+		{
+			printf("Error: failed opening file. \n");
+			exit(1);
+		}
+		fprintf(hashFile, "sram_out.txt %016llx\n", (unsigned long long)Dump_Hash(Mapper_GetMemory(), MAX_MEMORY_SIZE));
+		fclose(hashFile);
+	}
 }
 
-static void PrintExecLine(uint32_t regs[NUMBER_OF_REGISTERS])
+static void ProfileDump(char *inputFileName)
 {
-	instruction_format_s *ins_code = &gInstructionData.instruction_code;
-	
-	switch (gInstructionData.opcode.code)
+	FILE *reportFile, *foldedFile;
+	char *programName = inputFileName;
+
+	// frames are named after the program file, without its directory
+	for (char *p = inputFileName; *p; p++)
 	{
-		case ADD:
-		case SUB: 
-		case LSF: 
-		case RSF: 
-		case AND: 
-		case OR: 
-		case XOR: 
-		case LHI:
-			fprintf(gTraceFile, ">>>> EXEC: R[%d] = %ld %s %ld <<<<\n\n", 
-					ins_code->bits.destination, regs[ins_code->bits.source_0], gInstructionData.opcode.operationString, regs[ins_code->bits.source_1]);
-			break;
-		case LD:
-			fprintf(gTraceFile, ">>>> EXEC: R[%d] = MEM[%ld] = %08lx <<<<\n\n",
-					ins_code->bits.destination, regs[ins_code->bits.source_1], Mapper_GetFromMemory(regs[ins_code->bits.source_1]));
-			break;
-		case ST:
-			fprintf(gTraceFile, ">>>> EXEC: MEM[%ld] = R[%d] = %08lx <<<<\n\n", 
-					regs[ins_code->bits.source_1], ins_code->bits.source_0, regs[ins_code->bits.source_0]);
-			break;
-		case HLT:
-			fprintf(gTraceFile, ">>>> EXEC: HALT at PC %04lx<<<<\n", gInstructionData.program_counter);
-			break;
-		case JLE: 
-		case JEQ: 
-		case JNE: 
-		case JLT: 
-		case JIN:
-			fprintf(gTraceFile, ">>>> EXEC: %s %ld, %ld, %ld <<<<\n\n", 
-					gInstructionData.opcode.operationString, regs[ins_code->bits.source_0], regs[ins_code->bits.source_1], Mapper_GetProgramCounter());
-			break;
-	}		
-}
+		if (*p == '/' || *p == '\\')
+			programName = p + 1;
+	}
 
-static void MemoryDump(void)
-{
-    for (int i = 0; i < MAX_MEMORY_SIZE; i++)
-        fprintf(gMemoryOutFile, "%08lx\n", Mapper_GetFromMemory(i));
+	if ((reportFile = fopen("profile.txt", "w")) == NULL || (foldedFile = fopen("profile.folded", "w")) == NULL)
+	{
+		printf("Error: failed opening file. \n");
+		exit(1);
+	}
+	Profiler_Report(programName, reportFile, foldedFile);
+	fclose(reportFile);
+	fclose(foldedFile);
 }
 
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include "llsim.h"
 
 /*
@@ -196,7 +197,11 @@ llsim_memory_t *llsim_allocate_memory(llsim_unit_t *unit, char *name, int bits,
 	return mem;
 }
 
-void llsim_mem_inject(llsim_memory_t *memory, int addr, int val, int msb, int lsb)
+/*
+ * the generic bit field accesses, for fields not known at compile time.
+ * see llsim_mem_inject() and llsim_mem_extract().
+ */
+void llsim_mem_inject_bits(llsim_memory_t *memory, int addr, int val, int msb, int lsb)
 {
 	int *p;
 
@@ -204,7 +209,7 @@ void llsim_mem_inject(llsim_memory_t *memory, int addr, int val, int msb, int ls
 	generic_inject_bits((char *) p, val, msb, lsb);
 }
 
-int llsim_mem_extract(llsim_memory_t *memory, int addr, int msb, int lsb)
+int llsim_mem_extract_bits(llsim_memory_t *memory, int addr, int msb, int lsb)
 {
 	int *p;
 
@@ -212,6 +217,26 @@ int llsim_mem_extract(llsim_memory_t *memory, int addr, int msb, int lsb)
 	return generic_extract_bits((char *) p,msb,lsb);
 }
 
+/*
+ * copy n whole entries from addr on out of the memory
+ */
+void llsim_mem_load_range(llsim_memory_t *memory, int addr, int *buf, int n)
+{
+	llsim_assert(addr >= 0 && n >= 0 && addr + n <= memory->height,
+		     "ERROR: memory %s: range %d+%d out of range", memory->name, addr, n);
+	memcpy(buf, memory->data + addr, n * sizeof(int));
+}
+
+/*
+ * store n whole entries from addr on
+ */
+void llsim_mem_store_range(llsim_memory_t *memory, int addr, int *buf, int n)
+{
+	llsim_assert(addr >= 0 && n >= 0 && addr + n <= memory->height,
+		     "ERROR: memory %s: range %d+%d out of range", memory->name, addr, n);
+	memcpy(memory->data + addr, buf, n * sizeof(int));
+}
+
 void llsim_mem_write(llsim_memory_t *memory, int addr)
 {
 	llsim_assert(!memory->write, "ERROR: multiple memory writes to memory %s", memory->name);
@@ -266,13 +291,15 @@ void llsim_run_clock(void)
 			if (mem->read) {
 				llsim_assert(mem->read_addr < mem->height, "mem %s read address %d out of range\n", mem->name, mem->read_addr);
 				*mem->dataout = mem->data[mem->read_addr];
-				llsim_printf("llsim: clock %d: READ MEM %s addr %d --> %08x\n", llsim->clock, mem->name, mem->read_addr, *mem->dataout);
+				if (llsim_trace_on(LLSIM_TRACE_MEM))
+					llsim_printf("llsim: clock %d: READ MEM %s addr %d --> %08x\n", llsim->clock, mem->name, mem->read_addr, *mem->dataout);
 				mem->read = 0;
 			}
 			if (mem->write) {
 				llsim_assert(mem->write_addr < mem->height, "mem %s write address %d out of range\n", mem->name, mem->write_addr);
 				mem->data[mem->write_addr] = *mem->datain;
-				llsim_printf("llsim: clock %d: WRITE %08x --> MEM %s addr %d\n", llsim->clock, *mem->datain, mem->name, mem->write_addr);
+				if (llsim_trace_on(LLSIM_TRACE_MEM))
+					llsim_printf("llsim: clock %d: WRITE %08x --> MEM %s addr %d\n", llsim->clock, *mem->datain, mem->name, mem->write_addr);
 				mem->write = 0;
 			}
 			llsim_assert(!(read_done && write_done), "ERROR: simultaneous access to memory %s", mem->name);
@@ -304,10 +331,10 @@ static void llsim_init_units(char *program_name)
 	sp_init(program_name);
 }
 
-static void llsim_init(char *program_name)
+static void llsim_init(void)
 {
 	llsim = llsim_malloc(sizeof(llsim_t));
-	llsim_init_units(program_name);
+	llsim->trace_level = LLSIM_TRACE_MEM;
 }
 
 static void llsim_init_reset_values(void)
@@ -334,13 +361,74 @@ void llsim_stop(void)
 	stop_sim = 1;
 }
 
+void llsim_set_trace_level(int level)
+{
+	llsim_assert(level >= LLSIM_TRACE_NONE && level <= LLSIM_TRACE_MEM, "ERROR: bad trace level %d", level);
+	llsim->trace_level = level;
+}
+
+int llsim_parse_trace_level(char *name)
+{
+	if (strcmp(name, "none") == 0)
+		return LLSIM_TRACE_NONE;
+	if (strcmp(name, "inst") == 0 || strcmp(name, "instructions") == 0)
+		return LLSIM_TRACE_INST;
+	if (strcmp(name, "cycle") == 0 || strcmp(name, "cycles") == 0)
+		return LLSIM_TRACE_CYCLE;
+	if (strcmp(name, "mem") == 0 || strcmp(name, "memory") == 0)
+		return LLSIM_TRACE_MEM;
+	return -1;
+}
+
+static void llsim_usage(void)
+{
+	printf("usage: llsim [-t none|inst|cycle|mem] [-e record|replay=file] program\n");
+	printf("  -t  trace level (default mem):\n");
+	printf("        none   only the final sram dump\n");
+	printf("        inst   + inst_trace.txt\n");
+	printf("        cycle  + cycle_trace.txt\n");
+	printf("        mem    + every memory access on stdout\n");
+	printf("  -e  record the progress of the DMA at every clock into file, or replay it\n");
+	printf("      from file for the same run without the DMA thread\n");
+	exit(1);
+}
+
 int main(int argc, char **argv)
 {
-	int i;
+	int i, opt, level;
+
+	llsim_init();
+
+	while ((opt = getopt(argc, argv, "t:e:")) != -1) {
+		switch (opt) {
+		case 't':
+			level = llsim_parse_trace_level(optarg);
+			if (level < 0)
+				llsim_usage();
+			llsim_set_trace_level(level);
+			break;
+		case 'e':
+			if (strncmp(optarg, "record=", 7) == 0)
+				llsim->log_mode = LLSIM_LOG_RECORD;
+			else if (strncmp(optarg, "replay=", 7) == 0)
+				llsim->log_mode = LLSIM_LOG_REPLAY;
+			else
+				llsim_usage();
+			llsim->log_file = optarg + 7;
+			if (*llsim->log_file == '\0')
+				llsim_usage();
+			break;
+		default:
+			llsim_usage();
+		}
+	}
+	if (optind != argc - 1)
+		llsim_usage();
 
-	llsim_init(argv[1]);
+	llsim_init_units(argv[optind]);
 
-	llsim_printf("llsim: starting simulation\n");
+	if (llsim_trace_on(LLSIM_TRACE_INST))
+		llsim_printf("llsim: starting simulation\n");
 	llsim->reset = 1;
 
 	// init registers
@@ -352,7 +440,8 @@ int main(int argc, char **argv)
 	}
 	llsim->reset = 0;
 	while (!stop_sim) {
-		printf(">>>>> clock %d <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n", llsim->clock);
+		if (llsim_trace_on(LLSIM_TRACE_CYCLE))
+			printf(">>>>> clock %d <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n", llsim->clock);
 		llsim_run_clock();
 		llsim->clock++;
 		/*
@@ -18,6 +18,21 @@ void sp_init(char *program_name);
 
 #define llsim_printf	printf
 
+/*
+ * trace levels, every level includes the ones below it
+ */
+#define LLSIM_TRACE_NONE	0	// final memory dump only
+#define LLSIM_TRACE_INST	1	// instruction trace
+#define LLSIM_TRACE_CYCLE	2	// cycle trace
+#define LLSIM_TRACE_MEM		3	// every memory access on stdout
+
+// highest level compiled in, -DLLSIM_TRACE_MAX=0 removes all tracing code
+#ifndef LLSIM_TRACE_MAX
+#define LLSIM_TRACE_MAX		LLSIM_TRACE_MEM
+#endif
+
+#define llsim_trace_on(level)	((level) <= LLSIM_TRACE_MAX && llsim->trace_level >= (level))
+
 #define llsim_error(args...) llsim_assert(0, args)
 
 static inline int bitmask0(int bits)
@@ -186,9 +201,22 @@ typedef struct llsim_s {
 	llsim_unit_t *units;
 	int clock;
 	int reset;
+
+	// options
+	int trace_level;
+	int log_mode;		// LLSIM_LOG_*
+	char *log_file;
 } llsim_t;
 
-llsim_t *llsim;
+/*
+ * DMA event log (llsim -e): record how far the DMA thread got at every
+ * clock, or replay a recording without the thread
+ */
+#define LLSIM_LOG_NONE		0
+#define LLSIM_LOG_RECORD	1
+#define LLSIM_LOG_REPLAY	2
+
+extern llsim_t *llsim;
 
 void *llsim_malloc(int len);
 llsim_unit_t *llsim_register_unit(char *name, void (*run) (struct llsim_unit_s *unit));
@@ -201,16 +229,58 @@ void llsim_register_wire(char *unit_name, char *wire_name, int bits, void *wirep
 void llsim_register_output(char *unit_name, char *output_name, int bits, void *oldp, void *newp);
 void llsim_register_input(char *unit_name, char *input_name, int bits, void *oldp, void *newp);
 void llsim_stop(void);
+void llsim_set_trace_level(int level);
+int llsim_parse_trace_level(char *name);
 
 /*
  * memories
  */
 llsim_memory_t *llsim_allocate_memory(llsim_unit_t *unit, char *name, int bits, int height, int dp);
-void llsim_mem_inject(llsim_memory_t *memory, int addr, int val, int msb, int lsb);
-int llsim_mem_extract(llsim_memory_t *memory, int addr, int msb, int lsb);
+void llsim_mem_inject_bits(llsim_memory_t *memory, int addr, int val, int msb, int lsb);
+int llsim_mem_extract_bits(llsim_memory_t *memory, int addr, int msb, int lsb);
+void llsim_mem_load_range(llsim_memory_t *memory, int addr, int *buf, int n);
+void llsim_mem_store_range(llsim_memory_t *memory, int addr, int *buf, int n);
 void llsim_mem_set_datain(llsim_memory_t *memory, int val, int msb, int lsb);
 void llsim_mem_write(llsim_memory_t *memory, int addr);
 void llsim_mem_read(llsim_memory_t *memory, int addr);
 int llsim_mem_extract_dataout(llsim_memory_t *memory, int msb, int lsb);
 void llsim_run_clock(void);
+
+/*
+ * a whole entry. the generic inject is a 64 bit read-modify-write, a
+ * negative word sets all of the next entry and so does this.
+ */
+static inline void llsim_mem_inject_word(llsim_memory_t *memory, int addr, int val)
+{
+	memory->data[addr] = val;
+	if (val < 0)
+		memory->data[addr + 1] = -1;
+}
+
+// a field below bit 31 doesn't reach the next entry
+static inline void llsim_mem_inject_field(llsim_memory_t *memory, int addr, int val, int msb, int lsb)
+{
+	memory->data[addr] = rbs(memory->data[addr], val, msb, lsb);
+}
+
+/*
+ * bit field access to an entry. when msb and lsb are constants, full words
+ * and fields below bit 31 compile to a plain load or read-modify-write of
+ * the entry, anything else goes to the generic llsim_mem_*_bits().
+ */
+#define llsim_mem_field_const(msb, lsb)	(__builtin_constant_p(msb) && __builtin_constant_p(lsb))
+
+#define llsim_mem_extract(memory, addr, msb, lsb)						\
+	(llsim_mem_field_const(msb, lsb) && (msb) <= 31 ? sbs((memory)->data[addr], msb, lsb) :	\
+	 llsim_mem_extract_bits(memory, addr, msb, lsb))
+
+#define llsim_mem_inject(memory, addr, val, msb, lsb)						\
+	do {											\
+		if (llsim_mem_field_const(msb, lsb) && (msb) == 31 && (lsb) == 0)		\
+			llsim_mem_inject_word(memory, addr, val);				\
+		else if (llsim_mem_field_const(msb, lsb) && (msb) < 31)			\
+			llsim_mem_inject_field(memory, addr, val, msb, lsb);			\
+		else										\
+			llsim_mem_inject_bits(memory, addr, val, msb, lsb);			\
+	} while (0)
 #endif
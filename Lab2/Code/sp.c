@@ -6,13 +6,23 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include "llsim.h"
+#include "sp_image.h"
 
 #define sp_printf(a...)						\
 	do {							\
-		llsim_printf("sp: clock %d: ", llsim->clock);	\
-		llsim_printf(a);				\
+		if (llsim_trace_on(LLSIM_TRACE_CYCLE)) {	\
+			llsim_printf("sp: clock %d: ", llsim->clock);	\
+			llsim_printf(a);			\
+		}						\
+	} while (0)
+
+#define inst_trace(a...)					\
+	do {							\
+		if (llsim_trace_on(LLSIM_TRACE_INST))		\
+			fprintf(inst_trace_fp, a);		\
 	} while (0)
 
 int nr_simulated_instructions = 0;
@@ -80,8 +90,26 @@ typedef struct
 	int length;
 	int state;
 	int remaining_memory;
+	int started;		// the copy has set remaining_memory
+	int copied;
+	int steps;		// of every copy so far, see dma_step()
 }DMA_register_t;
 
+/*
+ * DMA event log, a "LSDM" magic and then for every clock that starts with
+ * the DMA further than the clock logged before: the clocks and the steps
+ * since that one, both unsigned LEB128
+ */
+#define DMA_LOG_MAGIC	"LSDM"
+
+typedef struct
+{
+	FILE *fp;			// record
+	unsigned char *buf, *p, *end;	// replay
+	int clock;			// of the last event
+	int steps;
+}dma_log_t;
+
 /*
  * Master structure
  */
@@ -90,13 +118,19 @@ typedef struct sp_s {
 #define SP_SRAM_HEIGHT	64 * 1024
 	llsim_memory_t *sram;
 
-	unsigned int memory_image[SP_SRAM_HEIGHT];
-	int memory_image_size;
+	int entry;			// pc of the first instruction
 
 	sp_registers_t *spro, *sprn;
 	DMA_register_t* dma;
 	int start;
 	pthread_t dma_thread;
+	int dma_joinable;		// dma_thread was started and not joined yet
+
+	// llsim -e: on record the pipeline holds dma_lock for the whole clock
+	// and the DMA thread takes it for every step, so the DMA only moves
+	// between clocks
+	pthread_mutex_t dma_lock;
+	dma_log_t log;
 } sp_t;
 
 static void sp_reset(sp_t *sp)
@@ -122,6 +156,11 @@ void jeq(sp_t* sp);
 void jne(sp_t* sp);
 void none(sp_t* sp);
 void* copy_dma(void* args);
+static int dma_step(sp_t* sp);
+static void dma_log_open(sp_t* sp);
+static void dma_log_clock(sp_t* sp);
+static void dma_finish(sp_t* sp);
+static void dma_join(sp_t* sp);
 
 #define NUMBER_OF_FUNCTIONS_OPERATIONS 20
 
@@ -161,6 +200,7 @@ static char opcode_name[32][4] = {"ADD", "SUB", "LSF", "RSF", "AND", "OR", "XOR"
 
 static void dump_sram(sp_t *sp)
 {
+	static int image[SP_SRAM_HEIGHT];
 	FILE *fp;
 	int i;
 
@@ -169,11 +209,33 @@ static void dump_sram(sp_t *sp)
                 printf("couldn't open file sram_out.txt\n");
                 exit(1);
 	}
+	llsim_mem_load_range(sp->sram, 0, image, SP_SRAM_HEIGHT);
 	for (i = 0; i < SP_SRAM_HEIGHT; i++)
-		fprintf(fp, "%08x\n", llsim_mem_extract(sp->sram, i, 31, 0));
+		fprintf(fp, "%08x\n", image[i]);
 	fclose(fp);
 }
 
+static void sp_cycle_trace(sp_registers_t *spro)
+{
+	int i;
+
+	fprintf(cycle_trace_fp, "cycle %d\n", spro->cycle_counter);
+	for (i = 2; i <= 7; i++)
+		fprintf(cycle_trace_fp, "r%d %08x\n", i, spro->r[i]);
+	fprintf(cycle_trace_fp, "pc %08x\n", spro->pc);
+	fprintf(cycle_trace_fp, "inst %08x\n", spro->inst);
+	fprintf(cycle_trace_fp, "opcode %08x\n", spro->opcode);
+	fprintf(cycle_trace_fp, "dst %08x\n", spro->dst);
+	fprintf(cycle_trace_fp, "src0 %08x\n", spro->src0);
+	fprintf(cycle_trace_fp, "src1 %08x\n", spro->src1);
+	fprintf(cycle_trace_fp, "immediate %08x\n", spro->immediate);
+	fprintf(cycle_trace_fp, "alu0 %08x\n", spro->alu0);
+	fprintf(cycle_trace_fp, "alu1 %08x\n", spro->alu1);
+	fprintf(cycle_trace_fp, "aluout %08x\n", spro->aluout);
+	fprintf(cycle_trace_fp, "cycle_counter %08x\n", spro->cycle_counter);
+	fprintf(cycle_trace_fp, "ctl_state %08x\n\n", spro->ctl_state);
+}
+
 void first_exec_state(int opcode, sp_t* sp)
 {
 	operations[opcode](sp);
@@ -181,19 +243,19 @@ void first_exec_state(int opcode, sp_t* sp)
 
 void second_exec_init_print(sp_registers_t* spro)
 {
-	fprintf(inst_trace_fp, "--- instruction %i (%04x) @ PC %i (%04x)"
+	inst_trace("--- instruction %i (%04x) @ PC %i (%04x)"
 		" -----------------------------------------------------------\n",
 		(spro->cycle_counter) / 6 - 1, (spro->cycle_counter) / 6 - 1, spro->pc, spro->pc);
 
-	fprintf(inst_trace_fp, "pc = %04d, inst = %08x, opcode = %i (%s), dst = %i,"
+	inst_trace("pc = %04d, inst = %08x, opcode = %i (%s), dst = %i,"
 		" src0 = %i, src1 = %i, immediate = %08x\n", spro->pc, spro->inst,
 		spro->opcode, opcode_name[spro->opcode], spro->dst, spro->src0,
 		spro->src1, spro->immediate);
 
-	fprintf(inst_trace_fp, "r[0] = 00000000 r[1] = %08x r[2] = %08x r[3] = %08x \n",
+	inst_trace("r[0] = 00000000 r[1] = %08x r[2] = %08x r[3] = %08x \n",
 		(spro->immediate != 0) ? spro->immediate : 0, spro->r[2], spro->r[3]);
 
-	fprintf(inst_trace_fp, "r[4] = %08x r[5] = %08x r[6] = %08x r[7] = %08x \n\n",
+	inst_trace("r[4] = %08x r[5] = %08x r[6] = %08x r[7] = %08x \n\n",
 		spro->r[4], spro->r[5], spro->r[6], spro->r[7]);
 }
 
@@ -202,13 +264,13 @@ void basic_print(sp_registers_t* spro, sp_registers_t* sprn, sp_t *sp)
 	if (spro->opcode == LD)
 	{
 		int loaded_mem = llsim_mem_extract_dataout(sp->sram, 31, 0);
-		fprintf(inst_trace_fp, ">>>> EXEC: R[%i] = MEM[%i] = %08x <<<<\n\n",
+		inst_trace(">>>> EXEC: R[%i] = MEM[%i] = %08x <<<<\n\n",
 			spro->dst, spro->alu1, loaded_mem);
 		sprn->r[spro->dst] = loaded_mem;
 	}
 	else
 	{
-		fprintf(inst_trace_fp, ">>>> EXEC: R[%i] = %i %s %i <<<<\n\n", spro->dst,
+		inst_trace(">>>> EXEC: R[%i] = %i %s %i <<<<\n\n", spro->dst,
 			spro->alu0, opcode_name[spro->opcode], spro->alu1);
 		sprn->r[spro->dst] = spro->aluout;
 	}
@@ -220,7 +282,7 @@ void branch_print(sp_registers_t* spro, sp_registers_t* sprn, sp_t* sp)
 	if(spro->opcode == JIN)
 	{
 
-		fprintf(inst_trace_fp, ">>>> EXEC: %s %i, %i, %i <<<<\n\n", opcode_name[spro->opcode],
+		inst_trace(">>>> EXEC: %s %i, %i, %i <<<<\n\n", opcode_name[spro->opcode],
 			spro->r[spro->src0], spro->r[spro->src1], spro->immediate);
 
 		sprn->r[7] = spro->pc;
@@ -228,7 +290,7 @@ void branch_print(sp_registers_t* spro, sp_registers_t* sprn, sp_t* sp)
 	}
 	else if (spro->opcode == ST)
 	{
-		fprintf(inst_trace_fp, ">>>> EXEC: MEM[%i] = R[%i] = %08x <<<<\n\n",
+		inst_trace(">>>> EXEC: MEM[%i] = R[%i] = %08x <<<<\n\n",
 			(spro->src1 == 1) ? spro->immediate : spro->r[spro->src1], spro->src0, spro->r[spro->src0]);
 
 		llsim_mem_write(sp->sram, spro->alu1);
@@ -239,7 +301,7 @@ void branch_print(sp_registers_t* spro, sp_registers_t* sprn, sp_t* sp)
 	{
 		if (spro->aluout == 1)
 		{
-			fprintf(inst_trace_fp, ">>>> EXEC: %s %i, %i, %i <<<<\n\n", opcode_name[spro->opcode],
+			inst_trace(">>>> EXEC: %s %i, %i, %i <<<<\n\n", opcode_name[spro->opcode],
 				spro->r[spro->src0], spro->r[spro->src1], spro->immediate);
 
 			sprn->r[7] = spro->pc;
@@ -247,7 +309,7 @@ void branch_print(sp_registers_t* spro, sp_registers_t* sprn, sp_t* sp)
 		}
 		else
 		{
-			fprintf(inst_trace_fp, ">>>> EXEC: %s %i, %i, %i <<<<\n\n",
+			inst_trace(">>>> EXEC: %s %i, %i, %i <<<<\n\n",
 				opcode_name[spro->opcode], spro->r[spro->src0], spro->r[spro->src1], spro->pc + 1);
 			sprn->pc = spro->pc + 1;
 		}
@@ -258,33 +320,19 @@ static void sp_ctl(sp_t *sp)
 {
 	sp_registers_t *spro = sp->spro;
 	sp_registers_t *sprn = sp->sprn;
-	int i;
 	static int dma_flag = 0;
 
 	// sp_ctl
 
-	fprintf(cycle_trace_fp, "cycle %d\n", spro->cycle_counter);
-	for (i = 2; i <= 7; i++)
-		fprintf(cycle_trace_fp, "r%d %08x\n", i, spro->r[i]);
-	fprintf(cycle_trace_fp, "pc %08x\n", spro->pc);
-	fprintf(cycle_trace_fp, "inst %08x\n", spro->inst);
-	fprintf(cycle_trace_fp, "opcode %08x\n", spro->opcode);
-	fprintf(cycle_trace_fp, "dst %08x\n", spro->dst);
-	fprintf(cycle_trace_fp, "src0 %08x\n", spro->src0);
-	fprintf(cycle_trace_fp, "src1 %08x\n", spro->src1);
-	fprintf(cycle_trace_fp, "immediate %08x\n", spro->immediate);
-	fprintf(cycle_trace_fp, "alu0 %08x\n", spro->alu0);
-	fprintf(cycle_trace_fp, "alu1 %08x\n", spro->alu1);
-	fprintf(cycle_trace_fp, "aluout %08x\n", spro->aluout);
-	fprintf(cycle_trace_fp, "cycle_counter %08x\n", spro->cycle_counter);
-	fprintf(cycle_trace_fp, "ctl_state %08x\n\n", spro->ctl_state);
+	if (llsim_trace_on(LLSIM_TRACE_CYCLE))
+		sp_cycle_trace(spro);
 
 	sprn->cycle_counter = spro->cycle_counter + 1;
 
 	switch (spro->ctl_state) 
 	{
 		case CTL_STATE_IDLE:
-			sprn->pc = 0;
+			sprn->pc = sp->entry;
 			if (sp->start)
 				sprn->ctl_state = CTL_STATE_FETCH0;
 			break;
@@ -391,22 +439,31 @@ static void sp_ctl(sp_t *sp)
 				}
 				case CPY:
 				{
-					fprintf(inst_trace_fp, ">>>> EXEC: CPY - Source: %i, Destination: %i, Length: %i <<<<\n\n",
+					inst_trace(">>>> EXEC: CPY - Source: %i, Destination: %i, Length: %i <<<<\n\n",
 						spro->r[spro->src0], spro->r[spro->dst], spro->r[spro->src1]);
-					while (!(sp->dma->state == DMA_WAIT)) {}
+					if (llsim->log_mode == LLSIM_LOG_NONE)
+						while (!(sp->dma->state == DMA_WAIT)) {}
+					else
+						dma_finish(sp);
+					dma_join(sp);
 					sp->dma->source = spro->r[spro->src0];
 					sp->dma->dest = spro->r[spro->dst];
 					sp->dma->length = spro->r[spro->src1];
+					sp->dma->started = 0;
 					sp->dma->state = DMA_COPY;
-					if (pthread_create(&sp->dma_thread, NULL, copy_dma, (void*)sp)) {
-						fprintf(stderr, "error launching DMA thread\n");
+					// on replay the steps come from the log
+					if (llsim->log_mode != LLSIM_LOG_REPLAY) {
+						if (pthread_create(&sp->dma_thread, NULL, copy_dma, (void*)sp))
+							fprintf(stderr, "error launching DMA thread\n");
+						else
+							sp->dma_joinable = 1;
 					}
 					sprn->pc = spro->pc + 1;
 					break;
 				}
 				case ASK:
 				{
-					fprintf(inst_trace_fp, ">>>> EXEC: ASK: Remaining to copy: %i <<<<\n\n",
+					inst_trace(">>>> EXEC: ASK: Remaining to copy: %i <<<<\n\n",
 						sp->dma->remaining_memory);
 					sprn->r[spro->dst] = sp->dma->remaining_memory;
 					sprn->pc = spro->pc + 1;
@@ -416,17 +473,24 @@ static void sp_ctl(sp_t *sp)
 
 			if (spro->opcode == HLT)
 			{
-				fprintf(inst_trace_fp, ">>>> EXEC: HALT at PC %04x<<<<\n", spro->pc);
-				fprintf(inst_trace_fp, "sim finished at pc %i, %i instructions", spro->pc,
+				inst_trace(">>>> EXEC: HALT at PC %04x<<<<\n", spro->pc);
+				inst_trace("sim finished at pc %i, %i instructions", spro->pc,
 					(spro->cycle_counter) / 6);
 
 				sprn->ctl_state = CTL_STATE_IDLE;
 				sp->start = 0;
 				if (dma_flag == 1) 
 				{
-					pthread_join(sp->dma_thread, NULL);
+					if (llsim->log_mode != LLSIM_LOG_NONE)
+						dma_finish(sp);
+					dma_join(sp);
 					sp->dma->state = DMA_IDLE;
 				}
+				if (sp->log.fp)
+				{
+					fclose(sp->log.fp);
+					sp->log.fp = NULL;
+				}
 				dump_sram(sp);
 				llsim_stop();
 				break;
@@ -451,32 +515,40 @@ static void sp_run(llsim_unit_t *unit)
 	sp->sram->read = 0;
 	sp->sram->write = 0;
 
+	if (llsim->log_mode != LLSIM_LOG_NONE)
+		dma_log_clock(sp);
 	sp_ctl(sp);
 }
 
 static void sp_generate_sram_memory_image(sp_t *sp, char *program_name)
 {
-        FILE *fp;
-        int addr, i;
+	sp_exe_section_t *s;
+	sp_image_t image;
+	char error[256];
+	int i, last;
 
-        fp = fopen(program_name, "r");
-        if (fp == NULL) {
-                printf("couldn't open file %s\n", program_name);
-                exit(1);
-        }
-        addr = 0;
-        while (addr < SP_SRAM_HEIGHT) {
-                fscanf(fp, "%08x\n", &sp->memory_image[addr]);
-                addr++;
-                if (feof(fp))
-                        break;
-        }
-	sp->memory_image_size = addr;
+	if (sp_image_load(program_name, &image, SP_SRAM_HEIGHT, error, sizeof(error)) < 0) {
+		printf("%s\n", error);
+		exit(1);
+	}
 
-        fprintf(inst_trace_fp, "program %s loaded, %d lines\n\n", program_name, addr);
+        inst_trace("program %s loaded, %d lines\n\n", program_name, image.end);
+
+	// code and data share the sram, it starts zeroed so a bss section
+	// needs nothing
+	for (i = 0; i < image.nr_sections; i++) {
+		s = &image.section[i];
+		if (s->type != SP_EXE_BSS)
+			llsim_mem_store_range(sp->sram, s->addr, image.words[i], s->size);
+	}
 
-	for (i = 0; i < sp->memory_image_size; i++)
-		llsim_mem_inject(sp->sram, i, sp->memory_image[i], 31, 0);
+	// the last word of a text image can still sign extend into the next
+	// entry, see llsim_mem_inject_word()
+	last = image.end - 1;
+	if (!image.exe && image.words[0][last] < 0)
+		llsim_mem_inject(sp->sram, last, image.words[0][last], 31, 0);
+	sp->entry = image.entry;
+	sp_image_free(&image);
 }
 
 static void sp_register_all_registers(sp_t *sp)
@@ -513,18 +585,22 @@ void sp_init(char *program_name)
 	llsim_unit_registers_t *llsim_ur;
 	sp_t *sp;
 
-	llsim_printf("initializing sp unit\n");
+	if (llsim_trace_on(LLSIM_TRACE_INST)) {
+		llsim_printf("initializing sp unit\n");
 
-	inst_trace_fp = fopen("inst_trace.txt", "w");
-	if (inst_trace_fp == NULL) {
-		printf("couldn't open file inst_trace.txt\n");
-		exit(1);
+		inst_trace_fp = fopen("inst_trace.txt", "w");
+		if (inst_trace_fp == NULL) {
+			printf("couldn't open file inst_trace.txt\n");
+			exit(1);
+		}
 	}
 
-	cycle_trace_fp = fopen("cycle_trace.txt", "w");
-	if (cycle_trace_fp == NULL) {
-		printf("couldn't open file cycle_trace.txt\n");
-		exit(1);
+	if (llsim_trace_on(LLSIM_TRACE_CYCLE)) {
+		cycle_trace_fp = fopen("cycle_trace.txt", "w");
+		if (cycle_trace_fp == NULL) {
+			printf("couldn't open file cycle_trace.txt\n");
+			exit(1);
+		}
 	}
 
 	llsim_sp_unit = llsim_register_unit("sp", sp_run);
@@ -541,6 +617,8 @@ void sp_init(char *program_name)
 
 	sp_register_all_registers(sp);
 	sp-> dma = (DMA_register_t*)calloc(sizeof(DMA_register_t), sizeof(char));
+	if (llsim->log_mode != LLSIM_LOG_NONE)
+		dma_log_open(sp);
 }
 
 #pragma region Functions implementations 
@@ -725,19 +803,197 @@ void none(sp_t* sp)
 
 void* copy_dma(void* args)
 {
-	int i;
 	sp_t* sp = (sp_t*)args;
-	sp->dma->remaining_memory = sp->dma->length;
+	int more;
+
+	do {
+		if (llsim->log_mode == LLSIM_LOG_RECORD)
+			pthread_mutex_lock(&sp->dma_lock);
+		more = dma_step(sp);
+		if (llsim->log_mode == LLSIM_LOG_RECORD)
+			pthread_mutex_unlock(&sp->dma_lock);
+	} while (more);
+    
+	return (void*)0;
+}
+
+/** dma_step
+ * -----
+ * One step of a copy: the first sets the remaining count, every other
+ * moves a word.
+ *
+ * @param sp_t *sp
+ *
+ * @return - 0 when the copy is done.
+ */
+static int dma_step(sp_t* sp)
+{
+	DMA_register_t* dma = sp->dma;
+
+	if (!dma->started) {
+		dma->remaining_memory = dma->length;
+		dma->copied = 0;
+		dma->started = 1;
+	} else {
+		sp->sram->data[dma->dest + dma->copied] = sp->sram->data[dma->source + dma->copied];
+		dma->copied++;
+		dma->remaining_memory -= 1;
+	}
+	dma->steps++;
+	if (dma->copied < dma->length)
+		return 1;
+	if (dma->remaining_memory == 0) {
+		dma->state = DMA_WAIT;
+	}
+	return 0;
+}
+
+static void dma_log_put(FILE* fp, unsigned int v)
+{
+	for (; v >= 0x80; v >>= 7)
+		fputc((v & 0x7f) | 0x80, fp);
+	fputc(v, fp);
+}
 
-	for (i = 0; i < sp->dma->length; i++) {
-		sp->sram->data[sp->dma->dest + i] =	sp->sram->data[sp->dma->source + i];
-		sp->dma->remaining_memory -= 1;
+static unsigned int dma_log_get(dma_log_t* log)
+{
+	unsigned int v = 0;
+	int shift;
+
+	for (shift = 0; log->p < log->end && shift < 35; shift += 7) {
+		v |= (unsigned int)(*log->p & 0x7f) << shift;
+		if (!(*log->p++ & 0x80))
+			return v;
 	}
-	if (sp->dma->remaining_memory == 0) {
-		sp->dma->state = DMA_WAIT;
+	printf("%s: truncated DMA log\n", llsim->log_file);
+	exit(1);
+}
+
+/** dma_log_open
+ * -----
+ * Starts the recording, or loads the one to replay.
+ *
+ * @param sp_t *sp
+ *
+ * @return - void.
+ */
+static void dma_log_open(sp_t* sp)
+{
+	dma_log_t* log = &sp->log;
+	FILE* fp;
+	long size;
+
+	if (llsim->log_mode == LLSIM_LOG_RECORD) {
+		pthread_mutex_init(&sp->dma_lock, NULL);
+		pthread_mutex_lock(&sp->dma_lock);
+		log->fp = fopen(llsim->log_file, "wb");
+		if (log->fp == NULL) {
+			printf("couldn't open file %s\n", llsim->log_file);
+			exit(1);
+		}
+		fwrite(DMA_LOG_MAGIC, 1, 4, log->fp);
+		return;
+	}
+
+	fp = fopen(llsim->log_file, "rb");
+	if (fp == NULL || fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 4 ||
+	    (log->buf = malloc(size)) == NULL || fseek(fp, 0, SEEK_SET) ||
+	    fread(log->buf, 1, size, fp) != size || memcmp(log->buf, DMA_LOG_MAGIC, 4)) {
+		printf("couldn't read DMA log %s\n", llsim->log_file);
+		exit(1);
+	}
+	fclose(fp);
+	log->p = log->buf + 4;
+	log->end = log->buf + size;
+}
+
+/** dma_log_clock
+ * -----
+ * Start of a clock. On record the DMA thread gets the sram between the
+ * clocks, and how far it got is logged. On replay the DMA is brought to
+ * where it was.
+ *
+ * @param sp_t *sp
+ *
+ * @return - void.
+ */
+static void dma_log_clock(sp_t* sp)
+{
+	dma_log_t* log = &sp->log;
+	unsigned char* p;
+	int clock, steps;
+
+	if (llsim->log_mode == LLSIM_LOG_RECORD) {
+		pthread_mutex_unlock(&sp->dma_lock);
+		if (__atomic_load_n(&sp->dma->state, __ATOMIC_ACQUIRE) == DMA_COPY)
+			sched_yield();
+		pthread_mutex_lock(&sp->dma_lock);
+		if (sp->dma->steps != log->steps && log->fp) {
+			dma_log_put(log->fp, llsim->clock - log->clock);
+			dma_log_put(log->fp, sp->dma->steps - log->steps);
+			log->clock = llsim->clock;
+			log->steps = sp->dma->steps;
+		}
+		return;
+	}
+
+	while (log->p < log->end) {
+		p = log->p;
+		clock = log->clock + dma_log_get(log);
+		steps = log->steps + dma_log_get(log);
+		if (clock > llsim->clock) {
+			log->p = p;
+			return;
+		}
+		while (sp->dma->steps < steps && sp->dma->state == DMA_COPY)
+			dma_step(sp);
+		if (sp->dma->steps != steps) {
+			printf("replay diverged at clock %d: DMA at step %d, recorded %d\n", llsim->clock,
+			       sp->dma->steps, steps);
+			exit(1);
+		}
+		log->clock = clock;
+		log->steps = steps;
+	}
+}
+
+/** dma_finish
+ * -----
+ * Waits for the copy to end, the DMA thread gets the sram meanwhile on
+ * record, and the copy ends right away on replay.
+ *
+ * @param sp_t *sp
+ *
+ * @return - void.
+ */
+static void dma_finish(sp_t* sp)
+{
+	if (llsim->log_mode == LLSIM_LOG_REPLAY) {
+		while (sp->dma->state == DMA_COPY && dma_step(sp))
+			;
+		return;
+	}
+	pthread_mutex_unlock(&sp->dma_lock);
+	while (__atomic_load_n(&sp->dma->state, __ATOMIC_ACQUIRE) == DMA_COPY)
+		sched_yield();
+	pthread_mutex_lock(&sp->dma_lock);
+}
+
+/** dma_join
+ * -----
+ * Joins the thread of the last copy, if one is running. On record it
+ * has taken its last step once dma_finish() returns.
+ *
+ * @param sp_t *sp
+ *
+ * @return - void.
+ */
+static void dma_join(sp_t* sp)
+{
+	if (sp->dma_joinable) {
+		pthread_join(sp->dma_thread, NULL);
+		sp->dma_joinable = 0;
 	}
-    
-	return (void*)0;
 }
 
 #pragma endregion
@@ -0,0 +1,66 @@
+#ifndef _SP_IMAGE_H_
+#define _SP_IMAGE_H_
+
+/*
+ * program images
+ *
+ * an image is a text file of hex words, one per line, or a raw little
+ * endian binary of 32 bit words. a file holding a control character other
+ * than a blank or new line, or a byte above 127, is taken as binary. in a
+ * text image blank lines are skipped and a word has 1 to 8 digits, any
+ * other line is an error. the file is mapped and parsed in place.
+ *
+ * a text or raw image is a single section of code and data at address 0
+ * that goes to both memories. a binary starting with SP_EXE_MAGIC is an
+ * sp executable instead.
+ */
+
+/*
+ * sp executable
+ *
+ * a header, a table of nr_sections sections and the words of the code and
+ * data sections, all little endian 32 bit words. code goes to the
+ * instruction memory, data to the data memory (to the one memory of the
+ * simulators that have one), a bss section is zero filled. execution
+ * starts at entry.
+ */
+#define SP_EXE_MAGIC		0x58455053	/* "SPEX" */
+#define SP_EXE_VERSION		1
+#define SP_EXE_MAX_SECTIONS	64
+
+// section types, a section of code and data goes to both memories
+#define SP_EXE_CODE		1
+#define SP_EXE_DATA		2
+#define SP_EXE_BSS		4
+
+typedef struct sp_exe_header_s {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int entry;
+	unsigned int nr_sections;
+} sp_exe_header_t;
+
+typedef struct sp_exe_section_s {
+	unsigned int type;
+	unsigned int addr;		// first word
+	unsigned int size;		// in words
+	unsigned int offset;		// of the words in the file in bytes, 0 for bss
+} sp_exe_section_t;
+
+typedef struct sp_image_s {
+	int exe;			// an sp executable, not a text or raw image
+	int entry;
+	int end;			// one past the last word of any section
+	int nr_sections;
+	sp_exe_section_t section[SP_EXE_MAX_SECTIONS];
+	int *words[SP_EXE_MAX_SECTIONS];	// of each section, NULL for bss
+} sp_image_t;
+
+/*
+ * load file_name, sections must fit in max_words words. returns 0, or -1
+ * with the reason in error: the file can't be read, is empty or isn't an
+ * image.
+ */
+int sp_image_load(char *file_name, sp_image_t *image, int max_words, char *error, int error_len);
+void sp_image_free(sp_image_t *image);
+#endif
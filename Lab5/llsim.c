@@ -1,13 +1,25 @@
+#define _GNU_SOURCE	// SEEK_DATA
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
 #include "llsim.h"
 
 /*
  * chip simulator
  */
-llsim_t *llsim = NULL;
-static int stop_sim = 0;
+__thread llsim_ctx_t *llsim = NULL;
+__thread FILE *llsim_out = NULL;
+
+// llsim_abort() of a unit run by the pool returns here
+static __thread jmp_buf *llsim_unit_jmp = NULL;
 
 void *llsim_malloc(int len)
 {
@@ -19,6 +31,98 @@ void *llsim_malloc(int len)
 	return p;
 }
 
+/*
+ * give up on the current simulation, the process only exits when the
+ * simulation was not started by llsim_ctx_run()
+ */
+void llsim_abort(void)
+{
+	if (llsim_unit_jmp)
+		longjmp(*llsim_unit_jmp, 1);
+	if (llsim && llsim->abort_jmp)
+		longjmp(*llsim->abort_jmp, 1);
+	exit(1);
+}
+
+/*
+ * open an output file of the current simulation
+ */
+FILE *llsim_fopen(char *name, char *mode)
+{
+	char path[4096];
+
+	if (!llsim->out_dir)
+		return fopen(name, mode);
+	snprintf(path, sizeof(path), "%s/%s", llsim->out_dir, name);
+	return fopen(path, mode);
+}
+
+/*
+ * evaluation schedule
+ */
+static void llsim_free_schedule(void)
+{
+	llsim_schedule_t *s = llsim->schedule;
+
+	if (!s)
+		return;
+	free(s->units);
+	free(s->mems);
+	free(s->regs);
+	free(s->stages);
+	free(s);
+	llsim->schedule = NULL;
+}
+
+void llsim_build_schedule(void)
+{
+	llsim_schedule_t *s;
+	llsim_unit_t *unit;
+	llsim_memory_t *mem;
+	llsim_unit_registers_t *ur;
+	int u, m, r;
+
+	llsim_free_schedule();
+	s = (llsim_schedule_t *) llsim_malloc(sizeof(llsim_schedule_t));
+
+	for (unit = llsim->units; unit; unit = unit->next) {
+		s->nr_units++;
+		for (mem = unit->mems; mem; mem = mem->next)
+			s->nr_mems++;
+		for (ur = unit->regs; ur; ur = ur->next)
+			s->nr_regs++;
+	}
+	s->units = (llsim_sched_unit_t *) llsim_malloc((s->nr_units + 1) * sizeof(llsim_sched_unit_t));
+	s->mems = (llsim_memory_t **) llsim_malloc((s->nr_mems + 1) * sizeof(llsim_memory_t *));
+	s->regs = (llsim_sched_regs_t *) llsim_malloc((s->nr_regs + 1) * sizeof(llsim_sched_regs_t));
+	s->stages = (llsim_sched_stage_t *) llsim_malloc((s->nr_units + 1) * sizeof(llsim_sched_stage_t));
+
+	// keep the list order, it defines the order of memory accesses in the traces
+	u = m = r = 0;
+	for (unit = llsim->units; unit; unit = unit->next, u++) {
+		s->units[u].run = unit->run;
+		s->units[u].unit = unit;
+		s->units[u].first_mem = m;
+		for (mem = unit->mems; mem; mem = mem->next)
+			s->mems[m++] = mem;
+		s->units[u].last_mem = m;
+		for (ur = unit->regs; ur; ur = ur->next, r++) {
+			s->regs[r].old = ur->old;
+			s->regs[r].new = ur->new;
+			s->regs[r].size = ur->size;
+		}
+
+		// a parallel unit joins the stage of the parallel unit before it
+		if (s->nr_stages && unit->parallel && s->units[u - 1].unit->parallel) {
+			s->stages[s->nr_stages - 1].last = u + 1;
+		} else {
+			s->stages[s->nr_stages].first = u;
+			s->stages[s->nr_stages++].last = u + 1;
+		}
+	}
+	llsim->schedule = s;
+}
+
 /*
  * unit registration functions
  */
@@ -33,6 +137,7 @@ llsim_unit_t *llsim_register_unit(char *name, void (*run) (struct llsim_unit_s *
 	unit->next = llsim->units;
 	unit->regs = NULL;
 	llsim->units = unit;
+	llsim_free_schedule();
 	return unit;
 }
 
@@ -61,9 +166,19 @@ llsim_unit_registers_t *llsim_allocate_registers(llsim_unit_t *unit, char *name,
 	ur->new = (void *) llsim_malloc(size);
 	ur->next = unit->regs;
 	unit->regs = ur;
+	llsim_free_schedule();
 	return ur;
 }
 
+/*
+ * make new equal to old, used after the register state was changed from
+ * outside of the clock (reset values, checkpoint restore)
+ */
+void llsim_regs_sync(llsim_unit_registers_t *ur)
+{
+	memcpy(ur->new, ur->old, ur->size);
+}
+
 void llsim_register_register(char *unit_name, char *reg_name, int bits, int reset_value, void *oldp, void *newp)
 {
 	llsim_unit_t *unit;
@@ -71,6 +186,7 @@ void llsim_register_register(char *unit_name, char *reg_name, int bits, int rese
 
 	unit = llsim_find_unit(unit_name);
 	llsim_assert(unit != NULL, "ERROR: couldn't find unit %s", unit_name);
+	llsim_assert(bits >= 1 && bits <= 32, "ERROR: register %s has %d bits", reg_name, bits);
 
 	reg = (llsim_register_t *) llsim_malloc(sizeof(llsim_register_t));
 	reg->unit_name = (char *) llsim_malloc(strlen(unit_name)+1);
@@ -94,7 +210,29 @@ void llsim_register_register(char *unit_name, char *reg_name, int bits, int rese
 
 void llsim_register_wire(char *unit_name, char *wire_name, int bits, void *wirep)
 {
-	// FIXME
+	llsim_unit_t *unit;
+	llsim_wire_t *wire, *p;
+
+	unit = llsim_find_unit(unit_name);
+	llsim_assert(unit != NULL, "ERROR: couldn't find unit %s", unit_name);
+	llsim_assert(bits >= 1 && bits <= 32, "ERROR: wire %s has %d bits", wire_name, bits);
+
+	wire = (llsim_wire_t *) llsim_malloc(sizeof(llsim_wire_t));
+	wire->unit_name = (char *) llsim_malloc(strlen(unit_name)+1);
+	strcpy(wire->unit_name, unit_name);
+	wire->wire_name = (char *) llsim_malloc(strlen(wire_name)+1);
+	strcpy(wire->wire_name, wire_name);
+	wire->bits = bits;
+	wire->wirep = wirep;
+	wire->next = NULL;
+	if (!unit->wires) {
+		unit->wires = wire;
+	} else {
+		p = unit->wires;
+		while (p->next)
+			p = p->next;
+		p->next = wire;
+	}
 }
 
 void llsim_register_output(char *unit_name, char *output_name, int bits, void *oldp, void *newp)
@@ -104,6 +242,7 @@ void llsim_register_output(char *unit_name, char *output_name, int bits, void *o
 
 	unit = llsim_find_unit(unit_name);
 	llsim_assert(unit != NULL, "ERROR: couldn't find unit %s", unit_name);
+	llsim_assert(bits >= 1 && bits <= 32, "ERROR: output %s has %d bits", output_name, bits);
 
 	output = (llsim_output_t *) llsim_malloc(sizeof(llsim_output_t));
 	output->unit_name = (char *) llsim_malloc(strlen(unit_name)+1);
@@ -131,6 +270,7 @@ void llsim_register_input(char *unit_name, char *input_name, int bits, void *old
 
 	unit = llsim_find_unit(unit_name);
 	llsim_assert(unit != NULL, "ERROR: couldn't find unit %s", unit_name);
+	llsim_assert(bits >= 1 && bits <= 32, "ERROR: input %s has %d bits", input_name, bits);
 
 	input = (llsim_input_t *) llsim_malloc(sizeof(llsim_input_t));
 	input->unit_name = (char *) llsim_malloc(strlen(unit_name)+1);
@@ -151,6 +291,36 @@ void llsim_register_input(char *unit_name, char *input_name, int bits, void *old
 	}
 }
 
+void llsim_register_state(llsim_unit_t *unit, char *name, void *p, int size)
+{
+	llsim_state_t *state;
+
+	state = (llsim_state_t *) llsim_malloc(sizeof(llsim_state_t));
+	state->name = (char *) llsim_malloc(strlen(name)+1);
+	strcpy(state->name, name);
+	state->p = p;
+	state->size = size;
+	state->next = unit->states;
+	unit->states = state;
+}
+
+llsim_counter_t *llsim_register_counter(llsim_unit_t *unit, char *name)
+{
+	llsim_counter_t *counter, **p;
+	char state_name[LLSIM_CHECKPOINT_NAME_LEN];
+
+	counter = (llsim_counter_t *) llsim_malloc(sizeof(llsim_counter_t));
+	counter->name = (char *) llsim_malloc(strlen(name)+1);
+	strcpy(counter->name, name);
+	for (p = &unit->counters; *p; p = &(*p)->next)
+		;
+	*p = counter;
+
+	snprintf(state_name, sizeof(state_name), "counter:%s", name);
+	llsim_register_state(unit, state_name, &counter->value, sizeof(counter->value));
+	return counter;
+}
+
 int generic_extract_bits(char *p, int msb, int lsb)
 {
 	int byte_pos;
@@ -176,9 +346,25 @@ void generic_inject_bits(char *p, int data, int msb, int lsb)
 /*
  * memories
  */
+llsim_log_chan_t *llsim_register_log(llsim_unit_t *unit, char *name)
+{
+	llsim_log_chan_t *ch, **p;
+
+	ch = (llsim_log_chan_t *) llsim_malloc(sizeof(llsim_log_chan_t));
+	ch->name = (char *) llsim_malloc(strlen(unit->name) + strlen(name) + 2);
+	sprintf(ch->name, "%s/%s", unit->name, name);
+	llsim_assert(strlen(ch->name) < LLSIM_CHECKPOINT_NAME_LEN, "ERROR: log channel name %s too long\n", ch->name);
+	for (p = &unit->logs; *p; p = &(*p)->next_chan)
+		;
+	*p = ch;
+	return ch;
+}
+
 llsim_memory_t *llsim_allocate_memory(llsim_unit_t *unit, char *name, int bits, int height, int dp)
 {
+	llsim_mem_config_t *config;
 	llsim_memory_t *mem;
+	char state_name[LLSIM_CHECKPOINT_NAME_LEN];
 
 	llsim_assert(bits <= 32, "ERROR: bits %d not supported", bits);
 	mem = (llsim_memory_t *) llsim_malloc(sizeof(llsim_memory_t));
@@ -188,174 +374,1737 @@ llsim_memory_t *llsim_allocate_memory(llsim_unit_t *unit, char *name, int bits,
 	mem->bits = bits;
 	mem->height = height;
 	mem->dp = dp;
-	mem->data = (int *) llsim_malloc((1+height) * mem->entry_size * sizeof(int));
-	mem->datain = (int *) llsim_malloc(mem->entry_size);
-	mem->dataout = (int *) llsim_malloc(mem->entry_size);
+	mem->nr_pages = (height + LLSIM_MEM_PAGE_WORDS - 1) >> LLSIM_MEM_PAGE_SHIFT;
+	mem->pages = (int **) llsim_malloc(mem->nr_pages * sizeof(int *));
+	mem->page_flags = (unsigned char *) llsim_malloc(mem->nr_pages);
+	llsim_mem_config(mem, dp ? 2 : 1, 1, 1);
+	for (config = llsim->mem_configs; config; config = config->next)
+		if (!strcmp(config->name, name))
+			llsim_mem_config(mem, config->nr_ports, config->nr_banks, config->latency);
 	mem->next = unit->mems;
 	unit->mems = mem;
+
+	// what is in flight on the ports goes into checkpoints
+	snprintf(state_name, sizeof(state_name), "%s.ports", name);
+	llsim_register_state(unit, state_name, mem->port, sizeof(mem->port));
+
+	snprintf(state_name, sizeof(state_name), "%s_reads", name);
+	mem->reads = llsim_register_counter(unit, state_name);
+	snprintf(state_name, sizeof(state_name), "%s_writes", name);
+	mem->writes = llsim_register_counter(unit, state_name);
+
+	llsim_free_schedule();
 	return mem;
 }
 
-void llsim_mem_inject(llsim_memory_t *memory, int addr, int val, int msb, int lsb)
+int *llsim_mem_alloc_page(llsim_memory_t *mem, int page)
 {
 	int *p;
 
-	p = memory->data + addr * memory->entry_size;
-	generic_inject_bits((char *) p, val, msb, lsb);
+	// aligned, so that a page doesn't straddle two pages of the host
+	p = (int *) aligned_alloc(LLSIM_MEM_PAGE_BYTES, LLSIM_MEM_PAGE_BYTES);
+	llsim_assert(p != NULL, "out of memory");
+	memset(p, 0, LLSIM_MEM_PAGE_BYTES);
+	mem->pages[page] = p;
+	return p;
 }
 
-int llsim_mem_extract(llsim_memory_t *memory, int addr, int msb, int lsb)
+/*
+ * the generic bit field accesses, for fields not known at compile time.
+ * see llsim_mem_inject() and llsim_mem_extract().
+ */
+void llsim_mem_inject_bits(llsim_memory_t *memory, int addr, int val, int msb, int lsb)
 {
 	int *p;
 
-	p = memory->data + addr * memory->entry_size;
-	return generic_extract_bits((char *) p,msb,lsb);
+	p = llsim_mem_entry(memory, addr);
+	*p = rbs(*p, val, msb, lsb);
+
+	/*
+	 * injecting used to be a 64 bit read-modify-write that sign extended
+	 * into the next entry: a negative field reaching bit 31 sets all of
+	 * the next entry. the reference sram dumps depend on it.
+	 */
+	if (msb == 31 && rbs(0, val, msb, lsb) < 0 && addr + 1 < memory->nr_pages * LLSIM_MEM_PAGE_WORDS)
+		*llsim_mem_entry(memory, addr + 1) = -1;
+}
+
+/*
+ * store a whole entry, the same way a memory write does
+ */
+void llsim_mem_store(llsim_memory_t *memory, int addr, int val)
+{
+	*llsim_mem_entry(memory, addr) = val;
+}
+
+int llsim_mem_extract_bits(llsim_memory_t *memory, int addr, int msb, int lsb)
+{
+	return sbs(llsim_mem_value(memory, addr), msb, lsb);
+}
+
+/*
+ * copy n entries from addr on out of the memory, a page at a time
+ */
+void llsim_mem_load_range(llsim_memory_t *memory, int addr, int *buf, int n)
+{
+	int *p, len;
+
+	llsim_assert(addr >= 0 && n >= 0 && addr + n <= memory->nr_pages * LLSIM_MEM_PAGE_WORDS,
+		     "ERROR: memory %s: range %d+%d out of range", memory->name, addr, n);
+	while (n > 0) {
+		len = LLSIM_MEM_PAGE_WORDS - (addr & LLSIM_MEM_PAGE_MASK);
+		if (len > n)
+			len = n;
+		p = memory->pages[addr >> LLSIM_MEM_PAGE_SHIFT];
+		if (p)
+			memcpy(buf, p + (addr & LLSIM_MEM_PAGE_MASK), len * sizeof(int));
+		else
+			memset(buf, 0, len * sizeof(int));
+		addr += len;
+		buf += len;
+		n -= len;
+	}
+}
+
+/*
+ * store n whole entries from addr on, the way llsim_mem_store() does. zeros
+ * going to a page never written leave it unallocated.
+ */
+void llsim_mem_store_range(llsim_memory_t *memory, int addr, int *buf, int n)
+{
+	int page, len, i;
+
+	llsim_assert(addr >= 0 && n >= 0 && addr + n <= memory->nr_pages * LLSIM_MEM_PAGE_WORDS,
+		     "ERROR: memory %s: range %d+%d out of range", memory->name, addr, n);
+	while (n > 0) {
+		len = LLSIM_MEM_PAGE_WORDS - (addr & LLSIM_MEM_PAGE_MASK);
+		if (len > n)
+			len = n;
+		page = addr >> LLSIM_MEM_PAGE_SHIFT;
+		for (i = 0; !memory->pages[page] && i < len && !buf[i]; i++)
+			;
+		if (i < len)
+			memcpy(llsim_mem_entry(memory, addr), buf, len * sizeof(int));
+		addr += len;
+		buf += len;
+		n -= len;
+	}
+}
+
+/*
+ * the words of a page, NULL if the page was never written and reads as 0
+ */
+int *llsim_mem_page(llsim_memory_t *memory, int page)
+{
+	return memory->pages[page];
+}
+
+/*
+ * a page was written since it was allocated or restored, or since the
+ * last llsim_mem_clean()
+ */
+int llsim_mem_page_dirty(llsim_memory_t *memory, int page)
+{
+	return memory->page_flags[page] & LLSIM_MEM_PAGE_DIRTY;
+}
+
+void llsim_mem_clean(llsim_memory_t *memory)
+{
+	int page;
+
+	for (page = 0; page < memory->nr_pages; page++)
+		memory->page_flags[page] &= ~LLSIM_MEM_PAGE_DIRTY;
+}
+
+static void llsim_mem_free_pages(llsim_memory_t *mem)
+{
+	int page;
+
+	for (page = 0; page < mem->nr_pages; page++) {
+		if (!(mem->page_flags[page] & LLSIM_MEM_PAGE_MAPPED))
+			free(mem->pages[page]);
+		mem->pages[page] = NULL;
+		mem->page_flags[page] = 0;
+	}
+	if (mem->map)
+		munmap(mem->map, mem->nr_pages * LLSIM_MEM_PAGE_BYTES);
+	mem->map = NULL;
+}
+
+/*
+ * geometry of a memory: ports, banks and the clocks a read takes
+ */
+void llsim_mem_config(llsim_memory_t *memory, int nr_ports, int nr_banks, int latency)
+{
+	llsim_assert(nr_ports >= 1 && nr_ports <= LLSIM_MEM_MAX_PORTS, "ERROR: memory %s: %d ports not supported",
+		     memory->name, nr_ports);
+	llsim_assert(nr_banks >= 1, "ERROR: memory %s: bad number of banks %d", memory->name, nr_banks);
+	llsim_assert(latency >= 1 && latency <= LLSIM_MEM_MAX_LATENCY, "ERROR: memory %s: latency %d not supported",
+		     memory->name, latency);
+	memory->nr_ports = nr_ports;
+	memory->nr_banks = nr_banks;
+	memory->latency = latency;
+}
+
+void llsim_mem_port_write(llsim_memory_t *memory, int port, int addr)
+{
+	llsim_mem_port_t *p = &memory->port[port];
+
+	llsim_assert(port < memory->nr_ports, "ERROR: memory %s has no port %d", memory->name, port);
+	llsim_assert(!p->write, "ERROR: multiple memory writes to memory %s", memory->name);
+	p->write = 1;
+	p->write_addr = addr;
+}
+
+void llsim_mem_port_read(llsim_memory_t *memory, int port, int addr)
+{
+	llsim_mem_port_t *p = &memory->port[port];
+
+	llsim_assert(port < memory->nr_ports, "ERROR: memory %s has no port %d", memory->name, port);
+	llsim_assert(!p->read, "ERROR: multiple memory reads to memory %s", memory->name);
+	p->read = 1;
+	p->read_addr = addr;
+}
+
+void llsim_mem_port_set_datain(llsim_memory_t *memory, int port, int val, int msb, int lsb)
+{
+	llsim_mem_port_t *p = &memory->port[port];
+
+	llsim_assert(msb <= 31 && lsb <= 31, "ERROR only <=32 bit memories supported");
+	p->datain = rbs(p->datain,val,msb,lsb);
+}
+
+int llsim_mem_port_extract_dataout(llsim_memory_t *memory, int port, int msb, int lsb)
+{
+	llsim_assert(msb <= 31 && lsb <= 31, "ERROR only <=32 bit memories supported");
+	return sbs(memory->port[port].dataout,msb,lsb);
+}
+
+int llsim_mem_port_valid(llsim_memory_t *memory, int port)
+{
+	return memory->port[port].valid;
+}
+
+/*
+ * another port already accesses the bank of addr, or writes addr itself,
+ * in this clock. the caller is expected to hold its access back, which is
+ * counted as a bank conflict.
+ */
+int llsim_mem_bank_busy(llsim_memory_t *memory, int port, int addr)
+{
+	llsim_mem_port_t *p;
+	int i;
+
+	for (i = 0; i < memory->nr_ports; i++) {
+		p = &memory->port[i];
+		if (i == port)
+			continue;
+		if ((p->write && p->write_addr == addr) ||
+		    (memory->nr_banks > 1 &&
+		     ((p->read && p->read_addr % memory->nr_banks == addr % memory->nr_banks) ||
+		      (p->write && p->write_addr % memory->nr_banks == addr % memory->nr_banks)))) {
+			memory->bank_conflicts++;
+			return 1;
+		}
+	}
+	return 0;
 }
 
+/*
+ * the single port interface is port 0
+ */
 void llsim_mem_write(llsim_memory_t *memory, int addr)
 {
-	llsim_assert(!memory->write, "ERROR: multiple memory writes to memory %s", memory->name);
-	memory->write = 1;
-	memory->write_addr = addr;
+	llsim_mem_port_write(memory, 0, addr);
 }
 
 void llsim_mem_read(llsim_memory_t *memory, int addr)
 {
-	llsim_assert(!memory->read, "ERROR: multiple memory reads to memory %s", memory->name);
-	memory->read = 1;
-	memory->read_addr = addr;
+	llsim_mem_port_read(memory, 0, addr);
 }
 
 void llsim_mem_set_datain(llsim_memory_t *memory, int val, int msb, int lsb)
 {
-	int *p;
-
-	llsim_assert(msb <= 31 && lsb <= 31, "ERROR only <=32 bit memories supported");
-	p = (int *) memory->datain;
-	*p = rbs(*p,val,msb,lsb);
+	llsim_mem_port_set_datain(memory, 0, val, msb, lsb);
 }
 
 int llsim_mem_extract_dataout(llsim_memory_t *memory, int msb, int lsb)
 {
-	int *p;
+	return llsim_mem_port_extract_dataout(memory, 0, msb, lsb);
+}
 
-	llsim_assert(msb <= 31 && lsb <= 31, "ERROR only <=32 bit memories supported");
-	p = (int *) memory->dataout;
-	return sbs(*p,msb,lsb);
+static int llsim_mem_port_addr(llsim_mem_port_t *p)
+{
+	return p->read ? p->read_addr : p->write_addr;
 }
 
-void llsim_run_clock(void)
+static void llsim_clock_memory_ports(llsim_memory_t *mem)
 {
-	llsim_unit_t *unit;
-	llsim_unit_registers_t *ur;
-	llsim_memory_t *mem;
-	int read_done, write_done;
-	
-	/*
-	 * run units
-	 */
-	unit = llsim->units;
-	while (unit) {
-		unit->run(unit);
-
-		// memories
-		mem = unit->mems;
-		while (mem) {
-			read_done = mem->read;
-			write_done = mem->write;
-			if (mem->read) {
-				llsim_assert(mem->read_addr < mem->height, "mem %s read address %d out of range\n", mem->name, mem->read_addr);
-				*mem->dataout = mem->data[mem->read_addr];
-				llsim_printf("llsim: clock %d: READ MEM %s addr %d --> %08x\n", llsim->clock, mem->name, mem->read_addr, *mem->dataout);
-				mem->read = 0;
-			}
-			if (mem->write) {
-				llsim_assert(mem->write_addr < mem->height, "mem %s write address %d out of range\n", mem->name, mem->write_addr);
-				mem->data[mem->write_addr] = *mem->datain;
-				llsim_printf("llsim: clock %d: WRITE %08x --> MEM %s addr %d\n", llsim->clock, *mem->datain, mem->name, mem->write_addr);
-				mem->write = 0;
-			}
-			llsim_assert(!(read_done && write_done), "ERROR: simultaneous access to memory %s", mem->name);
-			if (!read_done && !write_done)
-				*mem->dataout = 0xBAADBAAD;
-			mem = mem->next;
+	llsim_mem_port_t *p, *q;
+	int i, j, n = mem->latency - 1;
+
+	for (i = 0; i < mem->nr_ports; i++) {
+		p = &mem->port[i];
+		llsim_assert(!(p->read && p->write), "ERROR: simultaneous access to memory %s port %d", mem->name, i);
+		llsim_assert(!p->read || p->read_addr < mem->height, "mem %s read address %d out of range\n",
+			     mem->name, p->read_addr);
+		llsim_assert(!p->write || p->write_addr < mem->height, "mem %s write address %d out of range\n",
+			     mem->name, p->write_addr);
+		for (j = 0; j < i; j++) {
+			q = &mem->port[j];
+			if (!(p->read || p->write) || !(q->read || q->write))
+				continue;
+			llsim_assert(mem->nr_banks == 1 ||
+				     llsim_mem_port_addr(p) % mem->nr_banks != llsim_mem_port_addr(q) % mem->nr_banks,
+				     "ERROR: bank conflict on memory %s, ports %d and %d", mem->name, j, i);
+			llsim_assert(!p->write || !q->write || p->write_addr != q->write_addr,
+				     "ERROR: simultaneous writes to memory %s addr %d", mem->name, p->write_addr);
 		}
-		unit = unit->next;
 	}
 
-	/*
-	 * copy registers
-	 */
-	unit = llsim->units;
-	while (unit) {
-		ur = unit->regs;
-		while (ur) {
-			memcpy(ur->old, ur->new, ur->size);
-			ur = ur->next;
+	// reads see the memory before the writes of this clock
+	for (i = 0; i < mem->nr_ports; i++) {
+		p = &mem->port[i];
+		p->valid = 0;
+		if (n && p->pending_valid[0]) {
+			p->dataout = p->pending[0];
+			p->valid = 1;
 		}
-		unit = unit->next;
+		if (n) {
+			memmove(p->pending, p->pending + 1, (n - 1) * sizeof(int));
+			memmove(p->pending_valid, p->pending_valid + 1, n - 1);
+			p->pending_valid[n - 1] = 0;
+		}
+		if (!p->read)
+			continue;
+		llsim_counter_inc(mem->reads);
+		if (n) {
+			p->pending[n - 1] = llsim_mem_value(mem, p->read_addr);
+			p->pending_valid[n - 1] = 1;
+		} else {
+			p->dataout = llsim_mem_value(mem, p->read_addr);
+			p->valid = 1;
+		}
+		if (llsim_trace_on(LLSIM_TRACE_MEM))
+			llsim_printf("llsim: clock %d: READ MEM %s port %d addr %d --> %08x\n", llsim->clock, mem->name, i,
+				     p->read_addr, llsim_mem_value(mem, p->read_addr));
+	}
+	for (i = 0; i < mem->nr_ports; i++) {
+		p = &mem->port[i];
+		if (p->write) {
+			*llsim_mem_entry(mem, p->write_addr) = p->datain;
+			llsim_counter_inc(mem->writes);
+			if (llsim_trace_on(LLSIM_TRACE_MEM))
+				llsim_printf("llsim: clock %d: WRITE %08x --> MEM %s port %d addr %d\n", llsim->clock, p->datain,
+					     mem->name, i, p->write_addr);
+		}
+		if (!p->valid && !p->write)
+			p->dataout = 0xBAADBAAD;
+		p->read = 0;
+		p->write = 0;
 	}
 }
 
-static void llsim_init_units(char *program_name)
+static inline void llsim_clock_memory(llsim_memory_t *mem)
 {
-	llsim->units = NULL;
-	llsim->clock = 0;
-	sp_init(program_name);
+	llsim_mem_port_t *p = &mem->port[0];
+	int read_done, write_done;
+
+	if (mem->nr_ports != 1 || mem->latency != 1) {
+		llsim_clock_memory_ports(mem);
+		return;
+	}
+
+	read_done = p->read;
+	write_done = p->write;
+	p->valid = read_done;
+	if (p->read) {
+		llsim_assert(p->read_addr < mem->height, "mem %s read address %d out of range\n", mem->name, p->read_addr);
+		p->dataout = llsim_mem_value(mem, p->read_addr);
+		llsim_counter_inc(mem->reads);
+		if (llsim_trace_on(LLSIM_TRACE_MEM))
+			llsim_printf("llsim: clock %d: READ MEM %s addr %d --> %08x\n", llsim->clock, mem->name, p->read_addr, p->dataout);
+		p->read = 0;
+	}
+	if (p->write) {
+		llsim_assert(p->write_addr < mem->height, "mem %s write address %d out of range\n", mem->name, p->write_addr);
+		*llsim_mem_entry(mem, p->write_addr) = p->datain;
+		llsim_counter_inc(mem->writes);
+		if (llsim_trace_on(LLSIM_TRACE_MEM))
+			llsim_printf("llsim: clock %d: WRITE %08x --> MEM %s addr %d\n", llsim->clock, p->datain, mem->name, p->write_addr);
+		p->write = 0;
+	}
+	llsim_assert(!(read_done && write_done), "ERROR: simultaneous access to memory %s", mem->name);
+	if (!read_done && !write_done)
+		p->dataout = 0xBAADBAAD;
 }
 
-static void llsim_init(char *program_name)
+static inline void llsim_commit_registers(llsim_schedule_t *s)
 {
-	llsim = llsim_malloc(sizeof(llsim_t));
-	llsim_init_units(program_name);
+	llsim_sched_regs_t *r;
+
+	for (r = s->regs; r < s->regs + s->nr_regs; r++)
+		memcpy(r->old, r->new, r->size);
 }
 
-static void llsim_init_reset_values(void)
+/*
+ * value change dump of the registered signals
+ */
+#define LLSIM_VCD_BUF_SIZE	(4 * 1024 * 1024)
+
+static llsim_vcd_signal_t *llsim_vcd_add(llsim_vcd_t *vcd, llsim_unit_t *unit, int wire, int bits, void *p)
+{
+	llsim_vcd_signal_t *s = &vcd->signals[vcd->nr_signals];
+	int i, n = vcd->nr_signals++;
+
+	s->unit = unit;
+	s->wire = wire;
+	s->p = p;
+	s->bits = bits;
+	s->bytes = (bits + 7) / 8;
+
+	// identifiers are the signal number in base 94 over the printable characters
+	for (i = 0; i == 0 || n; i++, n /= 94)
+		s->id[i] = '!' + n % 94;
+	s->id[i] = '\0';
+	return s;
+}
+
+static void llsim_vcd_var(llsim_vcd_t *vcd, char *kind, llsim_vcd_signal_t *s, char *name)
+{
+	fprintf(vcd->fp, "$var %s %d %s %s $end\n", kind, s->bits, s->id, name);
+}
+
+void llsim_vcd_open(char *file_name)
 {
+	llsim_vcd_t *vcd;
 	llsim_unit_t *unit;
 	llsim_register_t *reg;
+	llsim_wire_t *wire;
+	llsim_output_t *output;
+	llsim_input_t *input;
+	int n = 0;
 
-	/*
-	 * run units
-	 */
-	unit = llsim->units;
-	while (unit) {
-		reg = unit->registers;
-		while (reg) {
-			* (int *) reg->newp = reg->reset_value;
-			reg = reg->next;
+	for (unit = llsim->units; unit; unit = unit->next) {
+		for (reg = unit->registers; reg; reg = reg->next)
+			n++;
+		for (wire = unit->wires; wire; wire = wire->next)
+			n++;
+		for (output = unit->outputs; output; output = output->next)
+			n++;
+		for (input = unit->inputs; input; input = input->next)
+			n++;
+	}
+
+	vcd = (llsim_vcd_t *) llsim_malloc(sizeof(llsim_vcd_t));
+	vcd->signals = (llsim_vcd_signal_t *) llsim_malloc((n + 1) * sizeof(llsim_vcd_signal_t));
+	vcd->fp = llsim_fopen(file_name, "w");
+	if (vcd->fp == NULL) {
+		free(vcd->signals);
+		free(vcd);
+		llsim_printf("couldn't open file %s\n", file_name);
+		llsim_abort();
+	}
+	setvbuf(vcd->fp, NULL, _IOFBF, LLSIM_VCD_BUF_SIZE);
+	llsim->vcd = vcd;
+
+	fprintf(vcd->fp, "$version llsim $end\n$timescale 1ns $end\n");
+	for (unit = llsim->units; unit; unit = unit->next) {
+		fprintf(vcd->fp, "$scope module %s $end\n", unit->name);
+		for (reg = unit->registers; reg; reg = reg->next)
+			llsim_vcd_var(vcd, "reg", llsim_vcd_add(vcd, unit, 0, reg->bits, reg->oldp),
+				      reg->reg_name);
+		for (output = unit->outputs; output; output = output->next)
+			llsim_vcd_var(vcd, "reg", llsim_vcd_add(vcd, unit, 0, output->bits, output->oldp),
+				      output->output_name);
+		for (input = unit->inputs; input; input = input->next)
+			llsim_vcd_var(vcd, "reg", llsim_vcd_add(vcd, unit, 0, input->bits, input->oldp),
+				      input->input_name);
+		for (wire = unit->wires; wire; wire = wire->next)
+			llsim_vcd_var(vcd, "wire", llsim_vcd_add(vcd, unit, 1, wire->bits, wire->wirep),
+				      wire->wire_name);
+		fprintf(vcd->fp, "$upscope $end\n");
+	}
+	fprintf(vcd->fp, "$enddefinitions $end\n");
+}
+
+void llsim_vcd_close(void)
+{
+	llsim_vcd_t *vcd = llsim->vcd;
+
+	if (!vcd)
+		return;
+	fprintf(vcd->fp, "#%d\n", llsim->clock);
+	fclose(vcd->fp);
+	free(vcd->signals);
+	free(vcd);
+	llsim->vcd = NULL;
+}
+
+/*
+ * write the signals of unit that changed, registers when wire is 0 and
+ * wires when it is 1. unit NULL starts a new clock with the registers of
+ * every unit.
+ */
+static void llsim_vcd_sample(llsim_unit_t *unit, int wire)
+{
+	llsim_vcd_t *vcd = llsim->vcd;
+	llsim_vcd_signal_t *s;
+	char buf[48], *b;
+	int val, i;
+
+	if (!unit)
+		fprintf(vcd->fp, "#%d\n", llsim->clock);
+	for (s = vcd->signals; s < vcd->signals + vcd->nr_signals; s++) {
+		if (s->wire != wire || (unit && s->unit != unit))
+			continue;
+		val = 0;
+		memcpy(&val, s->p, s->bytes);
+		val &= bitmask0(s->bits);
+		if (vcd->started && val == s->last)
+			continue;
+		s->last = val;
+
+		b = buf;
+		if (s->bits == 1) {
+			*b++ = '0' + val;
+		} else {
+			// leading zeros are implied
+			*b++ = 'b';
+			for (i = s->bits - 1; i > 0 && !sb(val, i); i--)
+				;
+			for (; i >= 0; i--)
+				*b++ = '0' + sb(val, i);
+			*b++ = ' ';
 		}
-		unit = unit->next;
+		for (i = 0; s->id[i]; i++)
+			*b++ = s->id[i];
+		*b++ = '\n';
+		fwrite(buf, 1, b - buf, vcd->fp);
 	}
+	if (wire)
+		vcd->started = 1;
 }
 
-void llsim_stop(void)
+// llsim_run_clock() with the value change dump
+static void llsim_run_clock_vcd(llsim_schedule_t *s)
 {
-	stop_sim = 1;
+	llsim_sched_unit_t *su;
+	int m;
+
+	llsim_vcd_sample(NULL, 0);
+	for (su = s->units; su < s->units + s->nr_units; su++) {
+		su->run(su->unit);
+		llsim_vcd_sample(su->unit, 1);
+		for (m = su->first_mem; m < su->last_mem; m++)
+			llsim_clock_memory(s->mems[m]);
+	}
+	llsim_commit_registers(s);
 }
 
-int main(int argc, char **argv)
+/*
+ * parallel evaluation
+ */
+#define LLSIM_POOL_SPINS	4096	// polls before a waiting thread yields
+
+// run one unit of a stage and clock its memories
+static void llsim_pool_run_unit(llsim_schedule_t *s, llsim_sched_unit_t *su)
 {
-	int i;
+	jmp_buf jmp;
+	int m;
+
+	llsim_out = su->out;
+	llsim_unit_jmp = &jmp;
+	if (setjmp(jmp) == 0) {
+		su->run(su->unit);
+		for (m = su->first_mem; m < su->last_mem; m++)
+			llsim_clock_memory(s->mems[m]);
+	} else {
+		su->failed = 1;
+	}
+	llsim_unit_jmp = NULL;
+	llsim_out = NULL;
+}
 
-	llsim_init(argv[1]);
+static void llsim_pool_work(llsim_pool_t *pool, llsim_sched_stage_t *stage)
+{
+	llsim_schedule_t *s = llsim->schedule;
+	int u;
 
-	llsim_printf("llsim: starting simulation\n");
-	llsim->reset = 1;
+	while ((u = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < stage->last)
+		llsim_pool_run_unit(s, &s->units[u]);
+}
 
-	// init registers
-	llsim_init_reset_values();
+static void *llsim_pool_worker(void *arg)
+{
+	llsim_ctx_t *ctx = (llsim_ctx_t *) arg;
+	llsim_pool_t *pool = ctx->pool;
+	int generation = 0, spins;
 
-	for (i = 0; i < 5; i++) {
-		llsim_run_clock();
-		llsim->clock++;
+	llsim_ctx_set(ctx);
+	for (;;) {
+		for (spins = 0; __atomic_load_n(&pool->generation, __ATOMIC_ACQUIRE) == generation; spins++)
+			if (spins >= LLSIM_POOL_SPINS)
+				sched_yield();
+		generation++;
+		if (!pool->stage)
+			return NULL;
+		llsim_pool_work(pool, pool->stage);
+		__atomic_sub_fetch(&pool->active, 1, __ATOMIC_RELEASE);
 	}
-	llsim->reset = 0;
-	while (!stop_sim) {
-		printf(">>>>> clock %d <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n", llsim->clock);
-		llsim_run_clock();
-		llsim->clock++;
+}
+
+/*
+ * run a stage on the pool, the simulation thread takes units too. no
+ * worker touches the stage after the barrier, so the next stage can
+ * reset next.
+ */
+static void llsim_pool_run_stage(llsim_schedule_t *s, llsim_sched_stage_t *stage)
+{
+	llsim_pool_t *pool = llsim->pool;
+	llsim_sched_unit_t *su;
+	int spins;
+
+	pool->stage = stage;
+	pool->next = stage->first;
+	pool->active = pool->nr_threads;
+	__atomic_add_fetch(&pool->generation, 1, __ATOMIC_RELEASE);
+	llsim_pool_work(pool, stage);
+	for (spins = 0; __atomic_load_n(&pool->active, __ATOMIC_ACQUIRE); spins++)
+		if (spins >= LLSIM_POOL_SPINS)
+			sched_yield();
+
+	// the output and the first abort in the order the units would have run
+	for (su = s->units + stage->first; su < s->units + stage->last; su++) {
+		fflush(su->out);
+		if (su->out_len) {
+			fwrite(su->out_buf, 1, su->out_len, llsim->out);
+			fseeko(su->out, 0, SEEK_SET);
+			fflush(su->out);
+		}
+		if (su->failed)
+			llsim_abort();
 	}
-	return 0;
 }
 
+static void llsim_pool_stop(void)
+{
+	llsim_pool_t *pool = llsim->pool;
+	llsim_schedule_t *s = llsim->schedule;
+	int i;
+
+	if (!pool)
+		return;
+	pool->stage = NULL;
+	__atomic_add_fetch(&pool->generation, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < pool->nr_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+	for (i = 0; i < s->nr_units; i++) {
+		if (!s->units[i].out)
+			continue;
+		fclose(s->units[i].out);
+		free(s->units[i].out_buf);
+		s->units[i].out = NULL;
+	}
+	free(pool->threads);
+	free(pool);
+	llsim->pool = NULL;
+}
+
+/*
+ * start workers for llsim->nr_threads threads in all, as many as the
+ * largest stage can keep busy. no pool when every stage has one unit.
+ */
+static void llsim_pool_start(void)
+{
+	llsim_schedule_t *s;
+	llsim_sched_stage_t *stage;
+	llsim_pool_t *pool;
+	int u, nr = 1;
+
+	if (llsim->nr_threads <= 1 || llsim->vcd)
+		return;
+	if (!llsim->schedule)
+		llsim_build_schedule();
+	s = llsim->schedule;
+	for (stage = s->stages; stage < s->stages + s->nr_stages; stage++)
+		if (stage->last - stage->first > nr)
+			nr = stage->last - stage->first;
+	if (nr > llsim->nr_threads)
+		nr = llsim->nr_threads;
+	if (nr <= 1)
+		return;
+
+	for (stage = s->stages; stage < s->stages + s->nr_stages; stage++) {
+		if (stage->last - stage->first == 1)
+			continue;
+		for (u = stage->first; u < stage->last; u++) {
+			s->units[u].out = open_memstream(&s->units[u].out_buf, &s->units[u].out_len);
+			llsim_assert(s->units[u].out != NULL, "out of memory");
+		}
+	}
+
+	pool = (llsim_pool_t *) llsim_malloc(sizeof(llsim_pool_t));
+	pool->threads = (pthread_t *) llsim_malloc(nr * sizeof(pthread_t));
+	llsim->pool = pool;
+	for (; pool->nr_threads < nr - 1; pool->nr_threads++)
+		if (pthread_create(&pool->threads[pool->nr_threads], NULL, llsim_pool_worker, llsim))
+			break;
+	if (!pool->nr_threads)
+		llsim_pool_stop();
+}
+
+void llsim_run_clock(void)
+{
+	llsim_schedule_t *s;
+	llsim_sched_unit_t *su;
+	llsim_sched_stage_t *st;
+	int m;
+
+	if (!llsim->schedule)
+		llsim_build_schedule();
+	s = llsim->schedule;
+
+	// the value change dump samples after every unit, on a path of its own
+	if (LLSIM_TRACE_CYCLE <= LLSIM_TRACE_MAX && llsim->vcd) {
+		llsim_run_clock_vcd(s);
+		return;
+	}
+
+	/*
+	 * a single unit with two memories (the sp configuration) gets its
+	 * own straight line path
+	 */
+	if (s->nr_units == 1 && s->nr_mems == 2) {
+		su = &s->units[0];
+		su->run(su->unit);
+		llsim_clock_memory(s->mems[0]);
+		llsim_clock_memory(s->mems[1]);
+		llsim_commit_registers(s);
+		return;
+	}
+
+	if (llsim->pool) {
+		for (st = s->stages; st < s->stages + s->nr_stages; st++) {
+			if (st->last - st->first > 1) {
+				llsim_pool_run_stage(s, st);
+				continue;
+			}
+			su = &s->units[st->first];
+			su->run(su->unit);
+			for (m = su->first_mem; m < su->last_mem; m++)
+				llsim_clock_memory(s->mems[m]);
+		}
+		llsim_commit_registers(s);
+		return;
+	}
+
+	/*
+	 * run units, each followed by its memories
+	 */
+	for (su = s->units; su < s->units + s->nr_units; su++) {
+		su->run(su->unit);
+		for (m = su->first_mem; m < su->last_mem; m++)
+			llsim_clock_memory(s->mems[m]);
+	}
+
+	/*
+	 * copy registers
+	 */
+	llsim_commit_registers(s);
+}
+
+/*
+ * event log
+ */
+static void llsim_log_append(llsim_log_chan_t *ch, int clock, int value)
+{
+	if (ch->nr_events == ch->size) {
+		ch->size = ch->size ? 2 * ch->size : 256;
+		ch->clocks = (int *) realloc(ch->clocks, ch->size * sizeof(int));
+		ch->values = (int *) realloc(ch->values, ch->size * sizeof(int));
+		llsim_assert(ch->clocks && ch->values, "out of memory");
+	}
+	ch->clocks[ch->nr_events] = clock;
+	ch->values[ch->nr_events++] = value;
+	ch->value = value;
+}
+
+int llsim_log_event(llsim_log_chan_t *ch, int value)
+{
+	if (llsim->log_mode == LLSIM_LOG_RECORD) {
+		if (!ch->nr_events || value != ch->value)
+			llsim_log_append(ch, llsim->clock, value);
+		return value;
+	}
+	while (ch->next < ch->nr_events && ch->clocks[ch->next] <= llsim->clock)
+		ch->value = ch->values[ch->next++];
+	return ch->value;
+}
+
+void llsim_log_check_event(llsim_log_chan_t *ch, int value)
+{
+	int recorded = llsim_log_event(ch, value);
+
+	llsim_assert(value == recorded, "ERROR: replay diverged: %s is %d, recorded %d\n", ch->name, value, recorded);
+}
+
+static void llsim_log_put(FILE *fp, unsigned int v)
+{
+	for (; v >= 0x80; v >>= 7)
+		fputc((v & 0x7f) | 0x80, fp);
+	fputc(v, fp);
+}
+
+static unsigned int llsim_log_get(unsigned char **p, unsigned char *end)
+{
+	unsigned int v = 0;
+	int shift;
+
+	for (shift = 0; *p < end && shift < 35; shift += 7) {
+		v |= (unsigned int) (**p & 0x7f) << shift;
+		if (!(*(*p)++ & 0x80))
+			return v;
+	}
+	llsim_error("ERROR: %s: truncated event log\n", llsim->log_file);
+	return 0;
+}
+
+static void llsim_log_write(void)
+{
+	llsim_log_header_t header;
+	llsim_log_chan_t *ch;
+	llsim_unit_t *unit;
+	char name[LLSIM_CHECKPOINT_NAME_LEN];
+	FILE *fp;
+	int i;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = LLSIM_LOG_MAGIC;
+	header.version = LLSIM_LOG_VERSION;
+	for (unit = llsim->units; unit; unit = unit->next)
+		for (ch = unit->logs; ch; ch = ch->next_chan)
+			header.nr_chans++;
+
+	fp = fopen(llsim->log_file, "wb");
+	if (fp == NULL) {
+		llsim_printf("couldn't open file %s\n", llsim->log_file);
+		return;
+	}
+	fwrite(&header, sizeof(header), 1, fp);
+	for (unit = llsim->units; unit; unit = unit->next) {
+		for (ch = unit->logs; ch; ch = ch->next_chan) {
+			memset(name, 0, sizeof(name));
+			strcpy(name, ch->name);
+			fwrite(name, 1, sizeof(name), fp);
+			llsim_log_put(fp, ch->nr_events);
+			for (i = 0; i < ch->nr_events; i++) {
+				llsim_log_put(fp, ch->clocks[i] - (i ? ch->clocks[i - 1] : 0));
+				llsim_log_put(fp, ch->values[i] ^ (i ? ch->values[i - 1] : 0));
+			}
+		}
+	}
+	if (ferror(fp))
+		llsim_printf("write error on %s\n", llsim->log_file);
+	fclose(fp);
+}
+
+static llsim_log_chan_t *llsim_log_find(char *name)
+{
+	llsim_log_chan_t *ch;
+	llsim_unit_t *unit;
+
+	for (unit = llsim->units; unit; unit = unit->next)
+		for (ch = unit->logs; ch; ch = ch->next_chan)
+			if (!strncmp(ch->name, name, LLSIM_CHECKPOINT_NAME_LEN))
+				return ch;
+	llsim_error("ERROR: %s: the simulator has no log channel %.*s\n", llsim->log_file,
+		    LLSIM_CHECKPOINT_NAME_LEN, name);
+	return NULL;
+}
+
+/*
+ * load the events of every channel for replay
+ */
+static void llsim_log_read(void)
+{
+	llsim_log_header_t header;
+	llsim_log_chan_t *ch;
+	unsigned char *buf, *p, *end;
+	char name[LLSIM_CHECKPOINT_NAME_LEN];
+	struct stat st;
+	FILE *fp;
+	int i, c, n, clock, value, read_ok;
+
+	fp = fopen(llsim->log_file, "rb");
+	llsim_assert(fp != NULL, "couldn't open file %s\n", llsim->log_file);
+	buf = NULL;
+	read_ok = fstat(fileno(fp), &st) == 0 && st.st_size >= sizeof(header) &&
+		(buf = (unsigned char *) malloc(st.st_size)) != NULL &&
+		fread(buf, 1, st.st_size, fp) == st.st_size;
+	fclose(fp);
+	if (!read_ok)
+		free(buf);
+	llsim_assert(read_ok, "couldn't read file %s\n", llsim->log_file);
+
+	memcpy(&header, buf, sizeof(header));
+	if (header.magic != LLSIM_LOG_MAGIC || header.version != LLSIM_LOG_VERSION) {
+		free(buf);
+		llsim_error("%s is not an event log of this simulator\n", llsim->log_file);
+	}
+	p = buf + sizeof(header);
+	end = buf + st.st_size;
+	for (c = 0; c < header.nr_chans; c++) {
+		llsim_assert(end - p >= sizeof(name), "ERROR: %s: truncated event log\n", llsim->log_file);
+		memcpy(name, p, sizeof(name));
+		p += sizeof(name);
+		ch = llsim_log_find(name);
+		n = llsim_log_get(&p, end);
+		for (i = 0; i < n; i++) {
+			clock = llsim_log_get(&p, end) + (i ? ch->clocks[i - 1] : 0);
+			value = llsim_log_get(&p, end) ^ (i ? ch->values[i - 1] : 0);
+			llsim_log_append(ch, clock, value);
+		}
+		ch->value = 0;
+	}
+	free(buf);
+}
+
+/*
+ * checkpoints
+ */
+static int llsim_checkpoint_sections(llsim_checkpoint_section_t *sec)
+{
+	llsim_unit_t *unit;
+	llsim_unit_registers_t *ur;
+	llsim_memory_t *mem;
+	llsim_state_t *state;
+	int n = 0;
+
+	for (unit = llsim->units; unit; unit = unit->next) {
+		for (ur = unit->regs; ur; ur = ur->next, n++) {
+			if (!sec)
+				continue;
+			sec[n].kind = LLSIM_CHECKPOINT_REGS;
+			strncpy(sec[n].unit, unit->name, LLSIM_CHECKPOINT_NAME_LEN - 1);
+			strncpy(sec[n].name, ur->name, LLSIM_CHECKPOINT_NAME_LEN - 1);
+			sec[n].size = ur->size;
+		}
+		for (mem = unit->mems; mem; mem = mem->next, n++) {
+			if (!sec)
+				continue;
+			sec[n].kind = LLSIM_CHECKPOINT_MEM;
+			strncpy(sec[n].unit, unit->name, LLSIM_CHECKPOINT_NAME_LEN - 1);
+			strncpy(sec[n].name, mem->name, LLSIM_CHECKPOINT_NAME_LEN - 1);
+			sec[n].size = mem->nr_pages * LLSIM_MEM_PAGE_BYTES;
+		}
+		for (state = unit->states; state; state = state->next, n++) {
+			if (!sec)
+				continue;
+			sec[n].kind = LLSIM_CHECKPOINT_STATE;
+			strncpy(sec[n].unit, unit->name, LLSIM_CHECKPOINT_NAME_LEN - 1);
+			strncpy(sec[n].name, state->name, LLSIM_CHECKPOINT_NAME_LEN - 1);
+			sec[n].size = state->size;
+		}
+	}
+	return n;
+}
+
+static i64 llsim_checkpoint_align(i64 offset)
+{
+	return (offset + LLSIM_CHECKPOINT_ALIGN - 1) & ~(i64) (LLSIM_CHECKPOINT_ALIGN - 1);
+}
+
+/*
+ * save the state at the start of the current clock
+ */
+void llsim_checkpoint_save(char *file_name)
+{
+	llsim_checkpoint_header_t header;
+	llsim_checkpoint_section_t *sec;
+	llsim_unit_t *unit;
+	llsim_unit_registers_t *ur;
+	llsim_memory_t *mem;
+	llsim_state_t *state;
+	static char pad[LLSIM_CHECKPOINT_ALIGN];
+	i64 offset;
+	FILE *fp;
+	int i, n, page;
+
+	n = llsim_checkpoint_sections(NULL);
+	sec = (llsim_checkpoint_section_t *) llsim_malloc((n + 1) * sizeof(llsim_checkpoint_section_t));
+	llsim_checkpoint_sections(sec);
+
+	offset = llsim_checkpoint_align(sizeof(header) + n * sizeof(*sec));
+	for (i = 0; i < n; i++) {
+		sec[i].offset = offset;
+		offset = llsim_checkpoint_align(offset + sec[i].size);
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = LLSIM_CHECKPOINT_MAGIC;
+	header.version = LLSIM_CHECKPOINT_VERSION;
+	header.clock = llsim->clock;
+	header.reset = llsim->reset;
+	header.nr_sections = n;
+	header.align = LLSIM_CHECKPOINT_ALIGN;
+
+	fp = fopen(file_name, "wb");
+	llsim_assert(fp != NULL, "couldn't open file %s\n", file_name);
+	fwrite(&header, sizeof(header), 1, fp);
+	fwrite(sec, sizeof(*sec), n, fp);
+
+	// data is written in the same order as llsim_checkpoint_sections()
+	i = 0;
+	for (unit = llsim->units; unit; unit = unit->next) {
+		for (ur = unit->regs; ur; ur = ur->next, i++) {
+			fwrite(pad, 1, sec[i].offset - ftell(fp), fp);
+			fwrite(ur->old, 1, ur->size, fp);
+		}
+		for (mem = unit->mems; mem; mem = mem->next, i++) {
+			fwrite(pad, 1, sec[i].offset - ftell(fp), fp);
+			// pages never written are left as holes
+			for (page = 0; page < mem->nr_pages; page++) {
+				if (mem->pages[page])
+					fwrite(mem->pages[page], 1, LLSIM_MEM_PAGE_BYTES, fp);
+				else
+					fseek(fp, LLSIM_MEM_PAGE_BYTES, SEEK_CUR);
+			}
+		}
+		for (state = unit->states; state; state = state->next, i++) {
+			fwrite(pad, 1, sec[i].offset - ftell(fp), fp);
+			fwrite(state->p, 1, state->size, fp);
+		}
+	}
+	fflush(fp);
+	llsim_assert(!ferror(fp) && ftruncate(fileno(fp), offset) == 0, "write error on %s\n", file_name);
+	fclose(fp);
+	free(sec);
+}
+
+static llsim_checkpoint_section_t *llsim_checkpoint_find(llsim_checkpoint_header_t *header, int kind, char *unit, char *name)
+{
+	llsim_checkpoint_section_t *sec = (llsim_checkpoint_section_t *) (header + 1);
+	int i;
+
+	for (i = 0; i < header->nr_sections; i++, sec++)
+		if (sec->kind == kind && !strncmp(sec->unit, unit, LLSIM_CHECKPOINT_NAME_LEN - 1) &&
+		    !strncmp(sec->name, name, LLSIM_CHECKPOINT_NAME_LEN - 1))
+			return sec;
+	llsim_error("checkpoint has no %s/%s\n", unit, name);
+	return NULL;
+}
+
+/*
+ * restore a checkpoint saved by the same simulator build. the file is
+ * mapped, memory images are mapped copy on write and their pages point
+ * into the mapping, so only pages that are touched get read. holes in
+ * the file stay pages that were never written.
+ */
+void llsim_checkpoint_restore(char *file_name)
+{
+	llsim_checkpoint_header_t *header;
+	llsim_checkpoint_section_t *sec;
+	llsim_unit_t *unit;
+	llsim_unit_registers_t *ur;
+	llsim_memory_t *mem;
+	llsim_state_t *state;
+	struct stat st;
+	char *image;
+	i64 offset, pos;
+	int *data;
+	int fd, page;
+
+	fd = open(file_name, O_RDONLY);
+	llsim_assert(fd >= 0, "couldn't open file %s\n", file_name);
+	llsim_assert(fstat(fd, &st) == 0 && st.st_size >= sizeof(*header), "%s is not a checkpoint\n", file_name);
+	image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	llsim_assert(image != MAP_FAILED, "couldn't map file %s\n", file_name);
+
+	header = (llsim_checkpoint_header_t *) image;
+	llsim_assert(header->magic == LLSIM_CHECKPOINT_MAGIC, "%s is not a checkpoint\n", file_name);
+	llsim_assert(header->version == LLSIM_CHECKPOINT_VERSION, "%s: unsupported checkpoint version %d\n",
+		     file_name, header->version);
+	llsim_assert(header->nr_sections == llsim_checkpoint_sections(NULL),
+		     "%s: checkpoint has %d sections, simulator has %d\n", file_name,
+		     header->nr_sections, llsim_checkpoint_sections(NULL));
+
+	for (unit = llsim->units; unit; unit = unit->next) {
+		for (ur = unit->regs; ur; ur = ur->next) {
+			sec = llsim_checkpoint_find(header, LLSIM_CHECKPOINT_REGS, unit->name, ur->name);
+			llsim_assert(sec->size == ur->size, "%s: register block %s size mismatch\n", file_name, ur->name);
+			memcpy(ur->old, image + sec->offset, ur->size);
+			llsim_regs_sync(ur);
+		}
+		for (mem = unit->mems; mem; mem = mem->next) {
+			sec = llsim_checkpoint_find(header, LLSIM_CHECKPOINT_MEM, unit->name, mem->name);
+			llsim_assert(sec->size == mem->nr_pages * LLSIM_MEM_PAGE_BYTES,
+				     "%s: memory %s size mismatch\n", file_name, mem->name);
+			data = mmap(NULL, sec->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, sec->offset);
+			llsim_assert(data != MAP_FAILED, "couldn't map memory %s from %s\n", mem->name, file_name);
+			llsim_mem_free_pages(mem);
+			mem->map = data;
+			for (page = 0; page < mem->nr_pages; page++) {
+				offset = sec->offset + (i64) page * LLSIM_MEM_PAGE_BYTES;
+				pos = lseek(fd, offset, SEEK_DATA);
+				if ((pos < 0 && errno == ENXIO) || pos >= offset + (i64) LLSIM_MEM_PAGE_BYTES)
+					continue;
+				mem->pages[page] = data + page * LLSIM_MEM_PAGE_WORDS;
+				mem->page_flags[page] = LLSIM_MEM_PAGE_MAPPED;
+			}
+		}
+		for (state = unit->states; state; state = state->next) {
+			sec = llsim_checkpoint_find(header, LLSIM_CHECKPOINT_STATE, unit->name, state->name);
+			llsim_assert(sec->size == state->size, "%s: state %s size mismatch\n", file_name, state->name);
+			memcpy(state->p, image + sec->offset, state->size);
+		}
+	}
+	llsim->clock = header->clock;
+	llsim->reset = header->reset;
+
+	munmap(image, st.st_size);
+	close(fd);
+}
+
+static void llsim_init_units(char *program_name)
+{
+	llsim->units = NULL;
+	llsim->clock = 0;
+	sp_init(program_name);
+}
+
+static void llsim_init_reset_values(void)
+{
+	llsim_unit_t *unit;
+	llsim_register_t *reg;
+
+	/*
+	 * run units
+	 */
+	unit = llsim->units;
+	while (unit) {
+		reg = unit->registers;
+		while (reg) {
+			// only the bytes of the register, bool fields are registers too
+			memcpy(reg->newp, &reg->reset_value, (reg->bits + 7) / 8);
+			reg = reg->next;
+		}
+		unit = unit->next;
+	}
+}
+
+/*
+ * performance counter summary
+ */
+static void llsim_write_counters(void)
+{
+	llsim_unit_t *unit;
+	llsim_counter_t *counter;
+	char *name;
+	FILE *fp;
+
+	name = llsim->counter_format == LLSIM_COUNTERS_JSON ? "counters.json" : "counters.csv";
+	fp = llsim_fopen(name, "w");
+	if (fp == NULL) {
+		llsim_printf("couldn't open file %s\n", name);
+		llsim_abort();
+	}
+
+	if (llsim->counter_format == LLSIM_COUNTERS_CSV) {
+		fprintf(fp, "unit,counter,value\n");
+		fprintf(fp, "llsim,clock,%d\n", llsim->clock);
+		for (unit = llsim->units; unit; unit = unit->next)
+			for (counter = unit->counters; counter; counter = counter->next)
+				fprintf(fp, "%s,%s,%lld\n", unit->name, counter->name, counter->value);
+		fclose(fp);
+		return;
+	}
+
+	fprintf(fp, "{\n\t\"clock\": %d,\n\t\"units\": {", llsim->clock);
+	for (unit = llsim->units; unit; unit = unit->next) {
+		fprintf(fp, "\n\t\t\"%s\": {", unit->name);
+		for (counter = unit->counters; counter; counter = counter->next)
+			fprintf(fp, "\n\t\t\t\"%s\": %lld%s", counter->name, counter->value, counter->next ? "," : "");
+		fprintf(fp, "\n\t\t}%s", unit->next ? "," : "");
+	}
+	fprintf(fp, "\n\t}\n}\n");
+	fclose(fp);
+}
+
+void llsim_stop(void)
+{
+	llsim->stop = 1;
+}
+
+/*
+ * move the clock forward by clocks cycles without running them. the
+ * caller has already brought its state to where those cycles would have
+ * left it, so this only makes sense when it is the only unit.
+ */
+void llsim_skip_clocks(int clocks)
+{
+	llsim_assert(llsim->fast_forward && clocks >= 0, "ERROR: bad clock skip %d", clocks);
+	llsim->clock += clocks;
+}
+
+void llsim_set_trace_level(int level)
+{
+	llsim_assert(level >= LLSIM_TRACE_NONE && level <= LLSIM_TRACE_MEM, "ERROR: bad trace level %d", level);
+	llsim->trace_level = level;
+}
+
+int llsim_parse_trace_level(char *name)
+{
+	if (strcmp(name, "none") == 0)
+		return LLSIM_TRACE_NONE;
+	if (strcmp(name, "inst") == 0 || strcmp(name, "instructions") == 0)
+		return LLSIM_TRACE_INST;
+	if (strcmp(name, "cycle") == 0 || strcmp(name, "cycles") == 0)
+		return LLSIM_TRACE_CYCLE;
+	if (strcmp(name, "mem") == 0 || strcmp(name, "memory") == 0)
+		return LLSIM_TRACE_MEM;
+	return -1;
+}
+
+/*
+ * simulation contexts
+ */
+llsim_ctx_t *llsim_ctx_create(void)
+{
+	llsim_ctx_t *ctx;
+
+	ctx = (llsim_ctx_t *) malloc(sizeof(llsim_ctx_t));
+	if (ctx == NULL) {
+		printf("llsim: out of memory\n");
+		exit(1);
+	}
+	memset(ctx, 0, sizeof(llsim_ctx_t));
+	ctx->trace_level = LLSIM_TRACE_MEM;
+	ctx->cycle_trace_format = LLSIM_TRACE_FORMAT_TEXT;
+	ctx->out = stdout;
+	ctx->save_clock = -1;
+	return ctx;
+}
+
+void llsim_ctx_set(llsim_ctx_t *ctx)
+{
+	llsim = ctx;
+}
+
+// how memories with a geometry of their own did
+static void llsim_mem_report(void)
+{
+	llsim_unit_t *unit;
+	llsim_memory_t *mem;
+
+	for (unit = llsim->units; unit; unit = unit->next) {
+		for (mem = unit->mems; mem; mem = mem->next) {
+			if (mem->nr_ports == 1 && mem->nr_banks == 1 && mem->latency == 1)
+				continue;
+			llsim_printf("llsim: memory %s: %d ports, %d banks, latency %d: %d bank conflicts, %d clocks\n",
+				     mem->name, mem->nr_ports, mem->nr_banks, mem->latency, mem->bank_conflicts, llsim->clock);
+		}
+	}
+}
+
+/*
+ * load program_name and simulate it to the end on the calling thread.
+ * returns 0, or 1 when the simulation was aborted.
+ */
+int llsim_ctx_run(llsim_ctx_t *ctx, char *program_name)
+{
+	jmp_buf abort_jmp;
+	int i;
+
+	llsim_ctx_set(ctx);
+	ctx->abort_jmp = &abort_jmp;
+	if (setjmp(abort_jmp)) {
+		llsim_pool_stop();
+		// the log of a run that failed is the one worth replaying
+		if (ctx->log_mode == LLSIM_LOG_RECORD && ctx->units)
+			llsim_log_write();
+		ctx->abort_jmp = NULL;
+		return 1;
+	}
+
+	llsim_init_units(program_name);
+	if (llsim_trace_on(LLSIM_TRACE_CYCLE) && ctx->cycle_trace_format == LLSIM_TRACE_FORMAT_VCD)
+		llsim_vcd_open("cycle_trace.vcd");
+	llsim_pool_start();
+	if (ctx->log_mode == LLSIM_LOG_REPLAY)
+		llsim_log_read();
+
+	if (llsim_trace_on(LLSIM_TRACE_INST))
+		llsim_printf("llsim: starting simulation\n");
+
+	if (ctx->restore_file) {
+		llsim_checkpoint_restore(ctx->restore_file);
+	} else {
+		ctx->reset = 1;
+
+		// init registers
+		llsim_init_reset_values();
+
+		for (i = 0; i < 5; i++) {
+			llsim_run_clock();
+			ctx->clock++;
+		}
+		ctx->reset = 0;
+	}
+	while (!ctx->stop) {
+		if (ctx->clock == ctx->save_clock)
+			llsim_checkpoint_save(ctx->save_file);
+		if (llsim_trace_on(LLSIM_TRACE_CYCLE))
+			llsim_printf(">>>>> clock %d <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n", ctx->clock);
+		llsim_run_clock();
+		ctx->clock++;
+	}
+	llsim_pool_stop();
+	llsim_vcd_close();
+	if (ctx->log_mode == LLSIM_LOG_RECORD)
+		llsim_log_write();
+	// the clock that called llsim_stop() has clocked its memories by now
+	if (ctx->counter_format != LLSIM_COUNTERS_NONE)
+		llsim_write_counters();
+	llsim_mem_report();
+	ctx->abort_jmp = NULL;
+	return 0;
+}
+
+void llsim_ctx_free(llsim_ctx_t *ctx)
+{
+	llsim_unit_t *unit;
+	llsim_unit_registers_t *ur;
+	llsim_memory_t *mem;
+	llsim_state_t *state;
+	llsim_counter_t *counter;
+	llsim_log_chan_t *ch;
+	llsim_register_t *reg;
+	llsim_wire_t *wire;
+	llsim_output_t *output;
+	llsim_input_t *input;
+	void *next;
+
+	llsim_ctx_set(ctx);
+	llsim_vcd_close();
+	llsim_free_schedule();
+	for (unit = ctx->units; unit; unit = next) {
+		if (unit->free)
+			unit->free(unit);
+		for (ur = unit->regs; ur; ur = next) {
+			next = ur->next;
+			free(ur->name);
+			free(ur->old);
+			free(ur->new);
+			free(ur);
+		}
+		for (mem = unit->mems; mem; mem = next) {
+			next = mem->next;
+			llsim_mem_free_pages(mem);
+			free(mem->pages);
+			free(mem->page_flags);
+			free(mem->name);
+			free(mem);
+		}
+		for (state = unit->states; state; state = next) {
+			next = state->next;
+			free(state->name);
+			free(state);
+		}
+		for (counter = unit->counters; counter; counter = next) {
+			next = counter->next;
+			free(counter->name);
+			free(counter);
+		}
+		for (ch = unit->logs; ch; ch = next) {
+			next = ch->next_chan;
+			free(ch->name);
+			free(ch->clocks);
+			free(ch->values);
+			free(ch);
+		}
+		for (reg = unit->registers; reg; reg = next) {
+			next = reg->next;
+			free(reg->unit_name);
+			free(reg->reg_name);
+			free(reg);
+		}
+		for (wire = unit->wires; wire; wire = next) {
+			next = wire->next;
+			free(wire->unit_name);
+			free(wire->wire_name);
+			free(wire);
+		}
+		for (output = unit->outputs; output; output = next) {
+			next = output->next;
+			free(output->unit_name);
+			free(output->output_name);
+			free(output);
+		}
+		for (input = unit->inputs; input; input = next) {
+			next = input->next;
+			free(input->unit_name);
+			free(input->input_name);
+			free(input);
+		}
+		next = unit->next;
+		free(unit->name);
+		free(unit);
+	}
+	llsim_ctx_set(NULL);
+	free(ctx);
+}
+
+/*
+ * batch driver, runs every .bin program of a directory on a pool of
+ * threads. program dir/name.bin writes its outputs and stdout.txt into
+ * dir/name/.
+ */
+typedef struct llsim_batch_s {
+	llsim_ctx_t *options;
+	char *dir;
+	int nr_programs;
+	char **programs;
+	int *result;
+	int *clocks;
+	int next;
+} llsim_batch_t;
+
+static int llsim_batch_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char **) a, *(char **) b);
+}
+
+static void llsim_batch_run(llsim_batch_t *b, int i)
+{
+	llsim_ctx_t *ctx;
+	char program[4096], out_dir[4096], out[4096 + 16];
+	int len = strlen(b->programs[i]) - 4;
+
+	snprintf(program, sizeof(program), "%s/%s", b->dir, b->programs[i]);
+	snprintf(out_dir, sizeof(out_dir), "%s/%.*s", b->dir, len, b->programs[i]);
+	snprintf(out, sizeof(out), "%s/stdout.txt", out_dir);
+	b->result[i] = 1;
+	if (mkdir(out_dir, 0777) && errno != EEXIST)
+		return;
+
+	ctx = llsim_ctx_create();
+	ctx->trace_level = b->options->trace_level;
+	ctx->cycle_trace_format = b->options->cycle_trace_format;
+	ctx->fast_forward = b->options->fast_forward;
+	ctx->counter_format = b->options->counter_format;
+	ctx->profile = b->options->profile;
+	ctx->dump_delta = b->options->dump_delta;
+	ctx->dump_hash = b->options->dump_hash;
+	ctx->dump_threads = b->options->dump_threads;
+	ctx->nr_cores = b->options->nr_cores;
+	ctx->arbiter = b->options->arbiter;
+	ctx->nr_threads = b->options->nr_threads;
+	ctx->mem_configs = b->options->mem_configs;
+	ctx->out_dir = out_dir;
+	ctx->out = fopen(out, "w");
+	if (ctx->out == NULL) {
+		free(ctx);
+		return;
+	}
+	b->result[i] = llsim_ctx_run(ctx, program);
+	b->clocks[i] = ctx->clock;
+	fclose(ctx->out);
+	llsim_ctx_free(ctx);
+}
+
+static void *llsim_batch_worker(void *arg)
+{
+	llsim_batch_t *b = (llsim_batch_t *) arg;
+	int i;
+
+	while ((i = __sync_fetch_and_add(&b->next, 1)) < b->nr_programs)
+		llsim_batch_run(b, i);
+	return NULL;
+}
+
+static int llsim_batch(llsim_ctx_t *options, char *dir, int jobs)
+{
+	llsim_batch_t b;
+	pthread_t *threads;
+	struct dirent *de;
+	DIR *d;
+	int i, len, failed = 0;
+
+	memset(&b, 0, sizeof(b));
+	b.options = options;
+	b.dir = dir;
+	d = opendir(dir);
+	if (d == NULL) {
+		printf("couldn't open directory %s\n", dir);
+		return 1;
+	}
+	while ((de = readdir(d)) != NULL) {
+		len = strlen(de->d_name);
+		if (len <= 4 || strcmp(de->d_name + len - 4, ".bin") != 0)
+			continue;
+		b.programs = realloc(b.programs, (b.nr_programs + 1) * sizeof(char *));
+		b.programs[b.nr_programs++] = strdup(de->d_name);
+	}
+	closedir(d);
+	if (b.nr_programs == 0)
+		return 0;
+	qsort(b.programs, b.nr_programs, sizeof(char *), llsim_batch_cmp);
+	b.result = calloc(b.nr_programs, sizeof(int));
+	b.clocks = calloc(b.nr_programs, sizeof(int));
+
+	if (jobs <= 0)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs > b.nr_programs)
+		jobs = b.nr_programs;
+	threads = calloc(jobs, sizeof(pthread_t));
+	for (i = 0; i < jobs; i++)
+		pthread_create(&threads[i], NULL, llsim_batch_worker, &b);
+	for (i = 0; i < jobs; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < b.nr_programs; i++) {
+		if (b.result[i]) {
+			printf("%s: failed\n", b.programs[i]);
+			failed++;
+		} else {
+			printf("%s: ok, %d clocks\n", b.programs[i], b.clocks[i]);
+		}
+		free(b.programs[i]);
+	}
+	free(b.programs);
+	free(b.result);
+	free(b.clocks);
+	free(threads);
+	return failed != 0;
+}
+
+// mem:ports[:banks[:latency]]
+static int llsim_parse_mem_config(llsim_ctx_t *ctx, char *arg)
+{
+	llsim_mem_config_t *config;
+	char *colon;
+	int n;
+
+	colon = strchr(arg, ':');
+	if (colon == NULL || colon == arg)
+		return 1;
+	config = (llsim_mem_config_t *) llsim_malloc(sizeof(llsim_mem_config_t));
+	config->name = strndup(arg, colon - arg);
+	config->nr_banks = 1;
+	config->latency = 1;
+	n = sscanf(colon + 1, "%d:%d:%d", &config->nr_ports, &config->nr_banks, &config->latency);
+	if (n < 1 || config->nr_ports < 1 || config->nr_ports > LLSIM_MEM_MAX_PORTS || config->nr_banks < 1 ||
+	    config->latency < 1 || config->latency > LLSIM_MEM_MAX_LATENCY) {
+		free(config->name);
+		free(config);
+		return 1;
+	}
+	config->next = ctx->mem_configs;
+	ctx->mem_configs = config;
+	return 0;
+}
+
+/*
+ * -d delta,hash,threads=N
+ */
+static int llsim_parse_dump(llsim_ctx_t *ctx, char *arg)
+{
+	char *const tokens[] = { "delta", "hash", "threads", NULL };
+	char *value;
+
+	while (*arg) {
+		switch (getsubopt(&arg, tokens, &value)) {
+		case 0:
+			ctx->dump_delta = 1;
+			break;
+		case 1:
+			ctx->dump_hash = 1;
+			break;
+		case 2:
+			if (value == NULL || atoi(value) < 1)
+				return -1;
+			ctx->dump_threads = atoi(value);
+			break;
+		default:
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * -e record=file or -e replay=file
+ */
+static int llsim_parse_log(llsim_ctx_t *ctx, char *arg)
+{
+	char *const tokens[] = { "record", "replay", NULL };
+	char *value;
+
+	switch (getsubopt(&arg, tokens, &value)) {
+	case 0:
+		ctx->log_mode = LLSIM_LOG_RECORD;
+		break;
+	case 1:
+		ctx->log_mode = LLSIM_LOG_REPLAY;
+		break;
+	default:
+		return -1;
+	}
+	ctx->log_file = value;
+	return value == NULL || *value == '\0' || *arg ? -1 : 0;
+}
+
+/*
+ * -n cores[:rr|prio]
+ */
+static int llsim_parse_cores(llsim_ctx_t *ctx, char *arg)
+{
+	char *arbiter;
+
+	ctx->nr_cores = atoi(arg);
+	if (ctx->nr_cores < 1)
+		return -1;
+	arbiter = strchr(arg, ':');
+	if (arbiter == NULL || strcmp(arbiter + 1, "rr") == 0)
+		ctx->arbiter = LLSIM_ARBITER_ROUND_ROBIN;
+	else if (strcmp(arbiter + 1, "prio") == 0)
+		ctx->arbiter = LLSIM_ARBITER_PRIORITY;
+	else
+		return -1;
+	return 0;
+}
+
+static void llsim_usage(void)
+{
+	printf("usage: llsim [-t none|inst|cycle|mem] [-c text|bin|vcd] [-f] [-p json|csv] [-P]\n");
+	printf("             [-M mem:ports[:banks[:latency]]] [-d delta,hash,threads=N]\n");
+	printf("             [-n cores[:rr|prio]] [-w threads] [-e record|replay=file]\n");
+	printf("             [-s clock:file] [-r file] program\n");
+	printf("       llsim [-t none|inst|cycle|mem] [-c text|bin|vcd] [-f] [-p json|csv] [-P]\n");
+	printf("             [-M mem:ports[:banks[:latency]]] [-d delta,hash,threads=N]\n");
+	printf("             [-n cores[:rr|prio]] [-w threads] [-j jobs] -b dir\n");
+	printf("  -t  trace level (default mem):\n");
+	printf("        none   only the final sram dumps\n");
+	printf("        inst   + inst_trace.txt\n");
+	printf("        cycle  + cycle trace and per cycle stdout\n");
+	printf("        mem    + every memory access on stdout\n");
+	printf("  -c  cycle trace format: text (cycle_trace.txt, default), bin (cycle_trace.bin)\n");
+	printf("      or vcd (cycle_trace.vcd, the registered signals for a waveform viewer)\n");
+	printf("  -f  fast forward over cycles that only poll the DMA (with -t none)\n");
+	printf("  -p  write the performance counters to counters.json or counters.csv at the end\n");
+	printf("  -P  profile the simulated program into profile.txt and profile.folded\n");
+	printf("  -M  give memory mem ports (1 or 2), banks and a read latency in clocks,\n");
+	printf("      can be repeated. the sp DMA uses the second port of sramd\n");
+	printf("  -d  sram dumps: delta only writes the words changed from the program as\n");
+	printf("      address and word lines, hash adds their fnv-1a hashes to sram_hash.txt,\n");
+	printf("      threads formats them with N threads\n");
+	printf("  -n  run the program on cores sp0.. with srami each, sharing sramd through a\n");
+	printf("      round robin (default) or priority arbiter. the pipelines and the DMAs are\n");
+	printf("      masters of the bus, a master gets a port of sramd per clock (-M sramd:2\n");
+	printf("      for two). core n starts with n in r2 and the number of cores in r3\n");
+	printf("  -w  evaluate the units of a clock on threads threads, the cores of -n run\n");
+	printf("      at the same time. the results are the same as with one thread\n");
+	printf("  -e  record the arbitration and DMA decisions of every clock into file, or\n");
+	printf("      replay them from file: the recorded decisions are taken instead of made,\n");
+	printf("      and the run stops where it leaves the recording\n");
+	printf("  -s  save a checkpoint to file when the clock reaches clock\n");
+	printf("  -r  resume from a checkpoint instead of starting from reset\n");
+	printf("  -b  simulate every dir/name.bin, outputs go to dir/name/\n");
+	printf("  -j  number of simulations run in parallel with -b (default: all cores)\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	llsim_ctx_t *ctx;
+	char *batch_dir = NULL;
+	int opt, level, jobs = 0;
+
+	ctx = llsim_ctx_create();
+	llsim_ctx_set(ctx);
+
+	while ((opt = getopt(argc, argv, "t:c:fp:PM:d:n:w:e:s:r:b:j:")) != -1) {
+		switch (opt) {
+		case 't':
+			level = llsim_parse_trace_level(optarg);
+			if (level < 0)
+				llsim_usage();
+			llsim_set_trace_level(level);
+			break;
+		case 'c':
+			if (strcmp(optarg, "text") == 0)
+				ctx->cycle_trace_format = LLSIM_TRACE_FORMAT_TEXT;
+			else if (strcmp(optarg, "bin") == 0)
+				ctx->cycle_trace_format = LLSIM_TRACE_FORMAT_BIN;
+			else if (strcmp(optarg, "vcd") == 0)
+				ctx->cycle_trace_format = LLSIM_TRACE_FORMAT_VCD;
+			else
+				llsim_usage();
+			break;
+		case 'f':
+			ctx->fast_forward = 1;
+			break;
+		case 'P':
+			ctx->profile = 1;
+			break;
+		case 'p':
+			if (strcmp(optarg, "json") == 0)
+				ctx->counter_format = LLSIM_COUNTERS_JSON;
+			else if (strcmp(optarg, "csv") == 0)
+				ctx->counter_format = LLSIM_COUNTERS_CSV;
+			else
+				llsim_usage();
+			break;
+		case 'M':
+			if (llsim_parse_mem_config(ctx, optarg))
+				llsim_usage();
+			break;
+		case 'd':
+			if (llsim_parse_dump(ctx, optarg))
+				llsim_usage();
+			break;
+		case 'n':
+			if (llsim_parse_cores(ctx, optarg))
+				llsim_usage();
+			break;
+		case 'w':
+			ctx->nr_threads = atoi(optarg);
+			if (ctx->nr_threads < 1)
+				llsim_usage();
+			break;
+		case 'e':
+			if (llsim_parse_log(ctx, optarg))
+				llsim_usage();
+			break;
+		case 's':
+			ctx->save_file = strchr(optarg, ':');
+			if (ctx->save_file == NULL || ctx->save_file == optarg || ctx->save_file[1] == '\0')
+				llsim_usage();
+			ctx->save_clock = atoi(optarg);
+			ctx->save_file++;
+			break;
+		case 'r':
+			ctx->restore_file = optarg;
+			break;
+		case 'b':
+			batch_dir = optarg;
+			break;
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+		default:
+			llsim_usage();
+		}
+	}
+
+	if (batch_dir) {
+		if (optind != argc || ctx->save_file || ctx->restore_file || ctx->log_mode != LLSIM_LOG_NONE)
+			llsim_usage();
+		return llsim_batch(ctx, batch_dir, jobs);
+	}
+
+	if (optind != argc - 1)
+		llsim_usage();
+	return llsim_ctx_run(ctx, argv[optind]);
+}
@@ -1,5 +1,8 @@
 #ifndef _LLSIM_H_
 #define _LLSIM_H_
+#include <stdio.h>
+#include <setjmp.h>
+#include <pthread.h>
 typedef long long i64;
 
 void sp_init(char *program_name);
@@ -10,13 +13,29 @@ void sp_init(char *program_name);
 #define llsim_assert(cond, args...)					\
 	do {								\
 		if (!(cond)) {						\
-			printf("llsim: clock %d: assertion failed at file %s line %d: ", llsim->clock, __FILE__, __LINE__); \
-			printf(args);					\
-			exit (1);					\
+			llsim_printf("llsim: clock %d: assertion failed at file %s line %d: ", llsim->clock, __FILE__, __LINE__); \
+			llsim_printf(args);				\
+			llsim_abort();					\
 		}							\
 	} while (0);							\
 
-#define llsim_printf	printf
+// a unit run by a worker of llsim -w prints into a buffer of its own
+#define llsim_printf(args...)	fprintf(llsim_out ? llsim_out : llsim->out, args)
+
+/*
+ * trace levels, every level includes the ones below it
+ */
+#define LLSIM_TRACE_NONE	0	// final memory dumps only
+#define LLSIM_TRACE_INST	1	// instruction trace
+#define LLSIM_TRACE_CYCLE	2	// cycle trace and per cycle stdout
+#define LLSIM_TRACE_MEM		3	// every memory access on stdout
+
+// highest level compiled in, -DLLSIM_TRACE_MAX=0 removes all tracing code
+#ifndef LLSIM_TRACE_MAX
+#define LLSIM_TRACE_MAX		LLSIM_TRACE_MEM
+#endif
+
+#define llsim_trace_on(level)	((level) <= LLSIM_TRACE_MAX && llsim->trace_level >= (level))
 
 #define llsim_error(args...) llsim_assert(0, args)
 
@@ -117,25 +136,69 @@ typedef struct llsim_unit_registers_s {
 
 /*
  * memory
+ *
+ * entries live in pages of LLSIM_MEM_PAGE_WORDS words. a page is only
+ * allocated when it is first written, pages never written read as 0.
  */
+#define LLSIM_MEM_PAGE_SHIFT	10
+#define LLSIM_MEM_PAGE_WORDS	(1 << LLSIM_MEM_PAGE_SHIFT)
+#define LLSIM_MEM_PAGE_MASK	(LLSIM_MEM_PAGE_WORDS - 1)
+#define LLSIM_MEM_PAGE_BYTES	(LLSIM_MEM_PAGE_WORDS * sizeof(int))
+
+// page flags
+#define LLSIM_MEM_PAGE_DIRTY	1	// written since allocated, restored or cleaned
+#define LLSIM_MEM_PAGE_MAPPED	2	// lives in the checkpoint mapping, not allocated
+
+/*
+ * every port does one read or one write per clock. a read returns the
+ * memory as it was before the writes of the same clock, and its data
+ * shows up in dataout latency clocks later. with more than one bank,
+ * entry addr is in bank addr % nr_banks and two ports must not access
+ * the same bank in one clock: a port that can wait asks
+ * llsim_mem_bank_busy() before it accesses the memory.
+ */
+#define LLSIM_MEM_MAX_PORTS	2
+#define LLSIM_MEM_MAX_LATENCY	16
+
+typedef struct llsim_mem_port_s {
+	int read;
+	int read_addr;
+	int write;
+	int write_addr;
+	int datain;
+	int dataout;
+	int valid;			// dataout holds a read that completed in the last clock
+
+	// reads in flight, pending[0] completes next
+	int pending[LLSIM_MEM_MAX_LATENCY - 1];
+	char pending_valid[LLSIM_MEM_MAX_LATENCY - 1];
+} llsim_mem_port_t;
+
 typedef struct llsim_memory_s {
 	int entry_size;
 	int bits;
 	int height;
 	int dp;
-	int *data;
+	int nr_pages;
+	int **pages;			// NULL for pages never written
+	unsigned char *page_flags;
 	char *name;
 
-	int read;
-	int read_addr;
-	int write;
-	int write_addr;
-	int *datain;
-	int *dataout;
+	int nr_ports;			// 2 for dual port memories
+	int nr_banks;
+	int latency;			// clocks from a read to its data
+	int bank_conflicts;		// accesses llsim_mem_bank_busy() held back
+	struct llsim_counter_s *reads;	// "<name>_reads", all ports
+	struct llsim_counter_s *writes;
+	llsim_mem_port_t port[LLSIM_MEM_MAX_PORTS];
+	void *map;			// checkpoint mapping of the pages, NULL if none
 
 	struct llsim_memory_s *next;
 } llsim_memory_t;
 
+/*
+ * registered signals, at most 32 bits wide
+ */
 typedef struct llsim_register_s {
 	char *unit_name;
 	char *reg_name;
@@ -146,6 +209,15 @@ typedef struct llsim_register_s {
 	struct llsim_register_s *next;
 } llsim_register_t;
 
+// combinational value, sampled after the unit runs and before its memories are clocked
+typedef struct llsim_wire_s {
+	char *unit_name;
+	char *wire_name;
+	int bits;
+	void *wirep;
+	struct llsim_wire_s *next;
+} llsim_wire_t;
+
 typedef struct llsim_output_s {
 	char *unit_name;
 	char *output_name;
@@ -164,53 +236,431 @@ typedef struct llsim_input_s {
 	struct llsim_input_s *next;
 } llsim_input_t;
 
+/*
+ * unit state kept outside of the register blocks (globals, private fields),
+ * saved and restored with checkpoints
+ */
+typedef struct llsim_state_s {
+	char *name;
+	void *p;
+	int size;
+	struct llsim_state_s *next;
+} llsim_state_t;
+
+/*
+ * performance counter of a unit, cheap enough to bump every clock. the
+ * counters are unit state and go into checkpoints, with -p they are
+ * written out when the clock that called llsim_stop() is done.
+ */
+typedef struct llsim_counter_s {
+	i64 value;
+	char *name;
+	struct llsim_counter_s *next;
+} llsim_counter_t;
+
+static inline void llsim_counter_inc(llsim_counter_t *counter)
+{
+	counter->value++;
+}
+
+static inline void llsim_counter_add(llsim_counter_t *counter, i64 n)
+{
+	counter->value += n;
+}
+
+/*
+ * event log (llsim -e)
+ *
+ * a channel carries one value a unit decides every clock, like which
+ * masters an arbiter granted or whether a DMA waits for the pipeline.
+ * record keeps the clocks where the value changed and writes them to the
+ * log at the end of the simulation, also when it aborts. replay reads
+ * them back: llsim_log_value() returns the recorded decision instead of
+ * the one the unit made, so the unit can skip making it, and
+ * llsim_log_check() stops the simulation at the first clock where a
+ * value the run reaches differs from the recording. channels are only
+ * touched by their unit, so units can log while they run in parallel.
+ */
+#define LLSIM_LOG_NONE		0
+#define LLSIM_LOG_RECORD	1
+#define LLSIM_LOG_REPLAY	2
+
+typedef struct llsim_log_chan_s {
+	char *name;
+	int value;			// as of the last event
+	int nr_events;
+	int size;			// room in clocks and values
+	int *clocks;
+	int *values;
+	int next;			// replay: the event to come
+	struct llsim_log_chan_s *next_chan;
+} llsim_log_chan_t;
+
 /*
  * simulated unit
  */
 typedef struct llsim_unit_s {
 	char *name;
 	void (*run) (struct llsim_unit_s *unit);
+	void (*free) (struct llsim_unit_s *unit);	// releases private, may be NULL
 	llsim_unit_registers_t *regs;
 	void *private;
 	llsim_memory_t *mems;
 	llsim_register_t *registers;
+	llsim_wire_t *wires;
 	llsim_output_t *outputs;
 	llsim_input_t *inputs;
+	llsim_state_t *states;
+	llsim_counter_t *counters;	// in registration order
+	llsim_log_chan_t *logs;		// in registration order
+	int parallel;			// run() may overlap with other parallel units, see llsim_pool_t
 	struct llsim_unit_s *next;
 } llsim_unit_t;
 
 /*
- * chip simulator main structure
+ * evaluation schedule
+ *
+ * the unit, memory and register lists are compiled into flat arrays before
+ * the first clock, llsim_run_clock() only walks these arrays.
  */
-typedef struct llsim_s {
+typedef struct llsim_sched_unit_s {
+	void (*run) (struct llsim_unit_s *unit);
+	llsim_unit_t *unit;
+	int first_mem;		// memories of the unit are mems[first_mem .. last_mem - 1]
+	int last_mem;
+
+	// run by a worker: llsim_printf() output of the clock and whether it aborted
+	FILE *out;
+	char *out_buf;
+	size_t out_len;
+	int failed;
+} llsim_sched_unit_t;
+
+// units[first .. last - 1], more than one only when they are all parallel
+typedef struct llsim_sched_stage_s {
+	int first;
+	int last;
+} llsim_sched_stage_t;
+
+typedef struct llsim_sched_regs_s {
+	void *old, *new;
+	int size;
+} llsim_sched_regs_t;
+
+/*
+ * memory geometry given on the command line, overrides what the unit
+ * allocates
+ */
+typedef struct llsim_mem_config_s {
+	char *name;
+	int nr_ports;
+	int nr_banks;
+	int latency;
+	struct llsim_mem_config_s *next;
+} llsim_mem_config_t;
+
+typedef struct llsim_schedule_s {
+	int nr_units;
+	llsim_sched_unit_t *units;
+	int nr_mems;
+	llsim_memory_t **mems;
+	int nr_regs;
+	llsim_sched_regs_t *regs;
+	int nr_stages;
+	llsim_sched_stage_t *stages;
+} llsim_schedule_t;
+
+/*
+ * parallel evaluation (llsim -w)
+ *
+ * a unit sets parallel when its run() only touches its own registers,
+ * memories and private state, and state that no other parallel unit
+ * touches in the same clock. a stage of consecutive parallel units is
+ * handed to the pool: the workers and the simulation thread take its
+ * units one at a time, run each followed by its memories, and meet at a
+ * barrier before the next stage. the output of every unit is buffered
+ * and written in schedule order after the barrier, and a unit that
+ * aborts stops the simulation there, so the results are the same as when
+ * the units run one after the other.
+ */
+typedef struct llsim_pool_s {
+	int nr_threads;			// workers, the simulation thread is not one of them
+	pthread_t *threads;
+	llsim_sched_stage_t *stage;	// stage to run, NULL tells the workers to exit
+	int generation;			// bumped for every stage
+	int next;			// next unit of the stage to take
+	int active;			// workers not done with the stage yet
+} llsim_pool_t;
+
+/*
+ * simulation context
+ *
+ * everything one simulation owns. a thread works on one context at a
+ * time, the current one is llsim, so several simulations can run in one
+ * process as long as each runs on its own thread.
+ */
+typedef struct llsim_ctx_s {
 	llsim_unit_t *units;
+	llsim_schedule_t *schedule;	// NULL until built, rebuilt after every registration
+	int clock;
+	int reset;
+	int stop;			// set by llsim_stop()
+
+	// options
+	int trace_level;
+	int cycle_trace_format;
+	char *out_dir;			// output files go here, NULL for the current directory
+	FILE *out;			// llsim_printf() output, stdout by default
+	int save_clock;			// save a checkpoint when the clock gets here, -1 for never
+	char *save_file;
+	char *restore_file;		// start from this checkpoint instead of reset
+	int fast_forward;		// units may skip idle cycles, see llsim_skip_clocks()
+	int counter_format;		// LLSIM_COUNTERS_*
+	int profile;			// units profile the simulated program
+	int dump_delta;			// memory dumps only have the words changed from the program
+	int dump_hash;			// units write the hashes of their memory dumps
+	int dump_threads;		// threads formatting a memory dump, 0 for one
+	int nr_cores;			// sp cores sharing sramd, 0 for the single core system
+	int arbiter;			// LLSIM_ARBITER_* of the shared sramd
+	int nr_threads;			// threads evaluating the units of a clock, 0 for one
+	int log_mode;			// LLSIM_LOG_*
+	char *log_file;
+	llsim_mem_config_t *mem_configs;	// -M options, owned by the caller and not freed with the ctx
+
+	struct llsim_vcd_s *vcd;	// cycle trace in LLSIM_TRACE_FORMAT_VCD, NULL if none
+	llsim_pool_t *pool;		// parallel evaluation, NULL when the units run one by one
+
+	jmp_buf *abort_jmp;		// llsim_abort() returns here from llsim_ctx_run()
+} llsim_ctx_t;
+
+/*
+ * cycle trace formats
+ *
+ * text and bin are written by the units themselves. vcd is written by
+ * llsim from the registered signals: registers, outputs and inputs as
+ * they are at the start of every clock, wires as the unit left them. a
+ * value is only written when it changed, one time unit is one clock.
+ */
+#define LLSIM_TRACE_FORMAT_TEXT	0
+#define LLSIM_TRACE_FORMAT_BIN	1
+#define LLSIM_TRACE_FORMAT_VCD	2
+
+typedef struct llsim_vcd_signal_s {
+	llsim_unit_t *unit;
+	int wire;			// sampled after the unit ran rather than before
+	void *p;
+	int bytes;
+	int bits;
+	int last;			// value in the dump
+	char id[4];
+} llsim_vcd_signal_t;
+
+typedef struct llsim_vcd_s {
+	FILE *fp;
+	int nr_signals;
+	llsim_vcd_signal_t *signals;
+	int started;			// initial values written
+} llsim_vcd_t;
+
+/*
+ * arbiters of a memory shared by several cores
+ */
+#define LLSIM_ARBITER_ROUND_ROBIN	0
+#define LLSIM_ARBITER_PRIORITY		1
+
+/*
+ * performance counter summary formats, counters.json or counters.csv
+ */
+#define LLSIM_COUNTERS_NONE	0
+#define LLSIM_COUNTERS_JSON	1
+#define LLSIM_COUNTERS_CSV	2
+
+/*
+ * checkpoint file
+ *
+ * a header, a table of sections and the section data. every section is
+ * aligned to LLSIM_CHECKPOINT_ALIGN so that memory images can be mapped
+ * straight from the file on restore. sections are matched by unit and
+ * name. the ports of a memory are unit state, "<memory>.ports", and so
+ * is every counter, "counter:<name>".
+ */
+#define LLSIM_CHECKPOINT_MAGIC		0x4b43534c	/* "LSCK" */
+#define LLSIM_CHECKPOINT_VERSION	4
+#define LLSIM_CHECKPOINT_ALIGN		4096
+#define LLSIM_CHECKPOINT_NAME_LEN	32
+
+#define LLSIM_CHECKPOINT_REGS		0
+#define LLSIM_CHECKPOINT_MEM		1
+#define LLSIM_CHECKPOINT_STATE		2
+
+/*
+ * event log file
+ *
+ * the header, then per channel its "unit/name" in LLSIM_CHECKPOINT_NAME_LEN
+ * bytes, the number of events and the events. an event is the clocks
+ * since the event before and the value xor the value before, both as
+ * unsigned LEB128, so a channel that changes seldom takes a few bytes.
+ */
+#define LLSIM_LOG_MAGIC		0x474c534c	/* "LSLG" */
+#define LLSIM_LOG_VERSION	1
+
+typedef struct llsim_log_header_s {
+	int magic;
+	int version;
+	int nr_chans;
+} llsim_log_header_t;
+
+typedef struct llsim_checkpoint_header_s {
+	int magic;
+	int version;
 	int clock;
 	int reset;
-} llsim_t;
+	int nr_sections;
+	int align;
+} llsim_checkpoint_header_t;
+
+typedef struct llsim_checkpoint_section_s {
+	int kind;
+	char unit[LLSIM_CHECKPOINT_NAME_LEN];
+	char name[LLSIM_CHECKPOINT_NAME_LEN];
+	int size;
+	i64 offset;
+} llsim_checkpoint_section_t;
 
-llsim_t *llsim;
+extern __thread llsim_ctx_t *llsim;
+extern __thread FILE *llsim_out;
 
 void *llsim_malloc(int len);
+void llsim_abort(void);
+FILE *llsim_fopen(char *name, char *mode);
+llsim_ctx_t *llsim_ctx_create(void);
+void llsim_ctx_set(llsim_ctx_t *ctx);
+int llsim_ctx_run(llsim_ctx_t *ctx, char *program_name);
+void llsim_ctx_free(llsim_ctx_t *ctx);
 llsim_unit_t *llsim_register_unit(char *name, void (*run) (struct llsim_unit_s *unit));
 llsim_unit_t *llsim_find_unit(char *name);
 llsim_unit_registers_t *llsim_allocate_registers(llsim_unit_t *unit, char *name, int size);
+void llsim_regs_sync(llsim_unit_registers_t *ur);
 int generic_extract_bits(char *p, int msb, int lsb);
 void generic_inject_bits(char *p, int data, int msb, int lsb);
 void llsim_register_register(char *unit_name, char *reg_name, int bits, int reset_value, void *oldp, void *newp);
 void llsim_register_wire(char *unit_name, char *wire_name, int bits, void *wirep);
 void llsim_register_output(char *unit_name, char *output_name, int bits, void *oldp, void *newp);
 void llsim_register_input(char *unit_name, char *input_name, int bits, void *oldp, void *newp);
+void llsim_register_state(llsim_unit_t *unit, char *name, void *p, int size);
+llsim_counter_t *llsim_register_counter(llsim_unit_t *unit, char *name);
 void llsim_stop(void);
+void llsim_skip_clocks(int clocks);
+void llsim_build_schedule(void);
+void llsim_set_trace_level(int level);
+int llsim_parse_trace_level(char *name);
+void llsim_checkpoint_save(char *file_name);
+void llsim_checkpoint_restore(char *file_name);
+void llsim_vcd_open(char *file_name);
+void llsim_vcd_close(void);
+llsim_log_chan_t *llsim_register_log(llsim_unit_t *unit, char *name);
+int llsim_log_event(llsim_log_chan_t *ch, int value);
+void llsim_log_check_event(llsim_log_chan_t *ch, int value);
 
 /*
  * memories
  */
 llsim_memory_t *llsim_allocate_memory(llsim_unit_t *unit, char *name, int bits, int height, int dp);
-void llsim_mem_inject(llsim_memory_t *memory, int addr, int val, int msb, int lsb);
-int llsim_mem_extract(llsim_memory_t *memory, int addr, int msb, int lsb);
+int *llsim_mem_alloc_page(llsim_memory_t *memory, int page);
+void llsim_mem_inject_bits(llsim_memory_t *memory, int addr, int val, int msb, int lsb);
+int llsim_mem_extract_bits(llsim_memory_t *memory, int addr, int msb, int lsb);
+void llsim_mem_store(llsim_memory_t *memory, int addr, int val);
+void llsim_mem_load_range(llsim_memory_t *memory, int addr, int *buf, int n);
+void llsim_mem_store_range(llsim_memory_t *memory, int addr, int *buf, int n);
+int *llsim_mem_page(llsim_memory_t *memory, int page);
+int llsim_mem_page_dirty(llsim_memory_t *memory, int page);
+void llsim_mem_clean(llsim_memory_t *memory);
 void llsim_mem_set_datain(llsim_memory_t *memory, int val, int msb, int lsb);
 void llsim_mem_write(llsim_memory_t *memory, int addr);
 void llsim_mem_read(llsim_memory_t *memory, int addr);
 int llsim_mem_extract_dataout(llsim_memory_t *memory, int msb, int lsb);
+void llsim_mem_config(llsim_memory_t *memory, int nr_ports, int nr_banks, int latency);
+void llsim_mem_port_set_datain(llsim_memory_t *memory, int port, int val, int msb, int lsb);
+void llsim_mem_port_write(llsim_memory_t *memory, int port, int addr);
+void llsim_mem_port_read(llsim_memory_t *memory, int port, int addr);
+int llsim_mem_port_extract_dataout(llsim_memory_t *memory, int port, int msb, int lsb);
+int llsim_mem_port_valid(llsim_memory_t *memory, int port);
+int llsim_mem_bank_busy(llsim_memory_t *memory, int port, int addr);
 void llsim_run_clock(void);
+
+static inline int llsim_log_replaying(void)
+{
+	return llsim->log_mode == LLSIM_LOG_REPLAY;
+}
+
+// the decision of this clock, the recorded one on replay
+static inline int llsim_log_value(llsim_log_chan_t *ch, int value)
+{
+	if (llsim->log_mode == LLSIM_LOG_NONE)
+		return value;
+	return llsim_log_event(ch, value);
+}
+
+// a value the run has to reach, recorded or checked
+static inline void llsim_log_check(llsim_log_chan_t *ch, int value)
+{
+	if (llsim->log_mode != LLSIM_LOG_NONE)
+		llsim_log_check_event(ch, value);
+}
+
+// the entry at addr for writing, allocates its page on first use
+static inline int *llsim_mem_entry(llsim_memory_t *mem, int addr)
+{
+	int page = addr >> LLSIM_MEM_PAGE_SHIFT;
+	int *p = mem->pages[page];
+
+	if (!p)
+		p = llsim_mem_alloc_page(mem, page);
+	mem->page_flags[page] |= LLSIM_MEM_PAGE_DIRTY;
+	return p + (addr & LLSIM_MEM_PAGE_MASK);
+}
+
+static inline int llsim_mem_value(llsim_memory_t *mem, int addr)
+{
+	int *p = mem->pages[addr >> LLSIM_MEM_PAGE_SHIFT];
+
+	return p ? p[addr & LLSIM_MEM_PAGE_MASK] : 0;
+}
+
+// a whole entry, sign extended into the next one like llsim_mem_inject_bits()
+static inline void llsim_mem_inject_word(llsim_memory_t *mem, int addr, int val)
+{
+	*llsim_mem_entry(mem, addr) = val;
+	if (val < 0 && addr + 1 < mem->nr_pages * LLSIM_MEM_PAGE_WORDS)
+		*llsim_mem_entry(mem, addr + 1) = -1;
+}
+
+// a field below bit 31 doesn't reach the next entry
+static inline void llsim_mem_inject_field(llsim_memory_t *mem, int addr, int val, int msb, int lsb)
+{
+	int *p = llsim_mem_entry(mem, addr);
+
+	*p = rbs(*p, val, msb, lsb);
+}
+
+/*
+ * bit field access to an entry. when msb and lsb are constants, full words
+ * and fields below bit 31 compile to a plain load or read-modify-write of
+ * the entry, anything else goes to the generic llsim_mem_*_bits().
+ */
+#define llsim_mem_field_const(msb, lsb)	(__builtin_constant_p(msb) && __builtin_constant_p(lsb))
+
+#define llsim_mem_extract(memory, addr, msb, lsb)						\
+	(llsim_mem_field_const(msb, lsb) ? sbs(llsim_mem_value(memory, addr), msb, lsb) :		\
+	 llsim_mem_extract_bits(memory, addr, msb, lsb))
+
+#define llsim_mem_inject(memory, addr, val, msb, lsb)						\
+	do {											\
+		if (llsim_mem_field_const(msb, lsb) && (msb) == 31 && (lsb) == 0)		\
+			llsim_mem_inject_word(memory, addr, val);				\
+		else if (llsim_mem_field_const(msb, lsb) && (msb) < 31)			\
+			llsim_mem_inject_field(memory, addr, val, msb, lsb);			\
+		else										\
+			llsim_mem_inject_bits(memory, addr, val, msb, lsb);			\
+	} while (0)
 #endif
@@ -6,18 +6,24 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <limits.h>
 
 #include "llsim.h"
+#include "sp_trace.h"
+#include "sp_profile.h"
+#include "sp_image.h"
+#include "sp_dump.h"
+#include "sp_bus.h"
 
 #define sp_printf(a...)						\
 	do {							\
-		llsim_printf("sp: clock %d: ", llsim->clock);	\
-		llsim_printf(a);				\
+		if (llsim_trace_on(LLSIM_TRACE_CYCLE)) {	\
+			llsim_printf("%s: clock %d: ", sp->name, llsim->clock);	\
+			llsim_printf(a);			\
+		}						\
 	} while (0)
 
-int nr_simulated_instructions = 0;
-FILE *inst_trace_fp = NULL, *cycle_trace_fp = NULL;
-
 //BHT
 #define BHT_SIZE 10
 #define PREDICT_TAKEN_MAX 3
@@ -30,9 +36,8 @@ FILE *inst_trace_fp = NULL, *cycle_trace_fp = NULL;
 #define DMA_READ 1
 #define DMA_WRITE 2
 
-bool DMA_Finished = false;
-bool memory_busy  = false;
-bool DMA_active   = false;
+//binary cycle trace stdio buffer
+#define SP_CYCLE_TRACE_BUF_SIZE (4 * 1024 * 1024)
 
 typedef struct sp_registers_s {
 	// 6 32 bit registers (r[0], r[1] don't exist)
@@ -101,31 +106,202 @@ typedef struct sp_registers_s {
 
 } sp_registers_t;
 
+/*
+ * performance counters, the memory ones belong to srami and sramd
+ */
+enum {
+	SP_CNT_COMMITTED,
+	SP_CNT_FLUSHES,
+	SP_CNT_LD_ST_STALLS,
+	SP_CNT_DMA_STALLS,
+	SP_CNT_SRAMI_READS,
+	SP_CNT_SRAMI_WRITES,
+	SP_CNT_SRAMD_READS,
+	SP_CNT_SRAMD_WRITES,
+	SP_NR_COUNTERS
+};
+
+/*
+ * fast forward snapshot: the sp registers as words followed by the state
+ * kept outside of them
+ */
+#define SP_FF_MAX_PERIOD	32
+#define SP_FF_RING		(3 * SP_FF_MAX_PERIOD + 1)
+#define SP_FF_REG(field)	((int) (offsetof(sp_registers_t, field) / sizeof(int)))
+#define SP_FF_REGS_WORDS	((int) (sizeof(sp_registers_t) / sizeof(int)))
+#define SP_FF_WORDS		(SP_FF_REGS_WORDS + SP_FF_NR_EXTRA)
+
+enum {
+	SP_FF_INST_CNT,
+	SP_FF_START,
+	SP_FF_DMA_FINISHED,
+	SP_FF_DMA_ACTIVE,
+	SP_FF_SRAMI_READ_ADDR,
+	SP_FF_SRAMI_DATAOUT,
+	SP_FF_SRAMD_READ_ADDR,
+	SP_FF_SRAMD_WRITE_ADDR,
+	SP_FF_COUNTER,		// low 32 bits of the counters, their deltas are small
+	SP_FF_SRAMD_READ = SP_FF_COUNTER + SP_NR_COUNTERS,	// sramd accesses of the cycle, filled in after sp_ctl()
+	SP_FF_SRAMD_WRITE,
+	SP_FF_NR_EXTRA
+};
+
 /*
  * Master structure
  */
+#define SP_MAX_CORES	(SP_BUS_MAX_MASTERS / 2)
+
 typedef struct sp_s {
+	char name[16];			// of the unit, "sp" or "sp<core>"
+
 	// local srams
 #define SP_SRAM_HEIGHT	64 * 1024
 
 	llsim_memory_t *srami, *sramd;
+	int *srami_base, *sramd_base;	// the memories as loaded, for llsim -d delta
 
     //instruction counter
     int inst_cnt;
 
-	unsigned int memory_image[SP_SRAM_HEIGHT];
-	int memory_image_size;
-
 	int start;
 
 	sp_registers_t *spro, *sprn;
+
+	// DMA
+	bool DMA_Finished;
+	bool DMA_active;
+	int dma_port;			// sramd port of the DMA
+	int entry;			// pc of the first instruction
+
+	// llsim -n: sramd is shared through the bus, the pipeline is bus
+	// master core and the DMA master dma_master. NULL sys and bus for the
+	// single core system.
+	int core;
+	int dma_master;
+	struct sp_system_s *sys;
+	sp_bus_t *bus;
+	int halted;
+	llsim_counter_t *bus_stalls;
+
+	// llsim -e: whether the DMA waits for the pipeline, and its progress
+	llsim_log_chan_t *dma_wait_log;
+	llsim_log_chan_t *dma_left_log;
+
+	llsim_counter_t *counter[SP_NR_COUNTERS];
+
+	// llsim -P
+	sp_profile_t *prof;
+	char *program_name;
+
+	// trace outputs
+	FILE *inst_trace_fp;
+	FILE *cycle_trace_fp;
+
+	// fast forward (llsim -f), see sp_ff_skip()
+	llsim_unit_registers_t *ur;
+	int ff;
+	int ff_nr;			// valid snapshots in ff_ring
+	int ff_head;			// slot of the next snapshot
+	int ff_backoff;			// cycles until the next period search
+	char ff_vary[SP_FF_WORDS];	// words allowed to change from period to period
+	int ff_ring[SP_FF_RING][SP_FF_WORDS];
 } sp_t;
 
+typedef struct sp_system_s {
+	int nr_cores;
+	int running;			// cores that haven't halted
+	sp_t *core[SP_MAX_CORES];
+	sp_bus_t *bus;
+} sp_system_t;
+
+/*
+ * sramd accesses of the pipeline and of the DMA, through the bus when
+ * sramd is shared
+ */
+static inline void sp_dmem_read(sp_t *sp, int addr)
+{
+	if (sp->bus)
+		sp_bus_read(sp->bus, sp->core, addr);
+	else
+		llsim_mem_read(sp->sramd, addr);
+}
+
+static inline void sp_dmem_write(sp_t *sp, int addr, int val)
+{
+	if (sp->bus) {
+		sp_bus_write(sp->bus, sp->core, addr, val);
+	} else {
+		llsim_mem_set_datain(sp->sramd, val, 31, 0);
+		llsim_mem_write(sp->sramd, addr);
+	}
+}
+
+static inline int sp_dmem_dataout(sp_t *sp)
+{
+	if (sp->bus)
+		return sp_bus_dataout(sp->bus, sp->core);
+	return llsim_mem_extract_dataout(sp->sramd, 31, 0);
+}
+
+// the DMA has to hold its access to addr back in this clock
+static inline int sp_dma_blocked(sp_t *sp, int addr)
+{
+	if (sp->bus)
+		return sp_bus_blocked(sp->bus, sp->dma_master);
+	return llsim_mem_bank_busy(sp->sramd, sp->dma_port, addr);
+}
+
+static inline void sp_dma_read(sp_t *sp, int addr)
+{
+	if (sp->bus)
+		sp_bus_read(sp->bus, sp->dma_master, addr);
+	else
+		llsim_mem_port_read(sp->sramd, sp->dma_port, addr);
+}
+
+static inline void sp_dma_write(sp_t *sp, int addr, int val)
+{
+	if (sp->bus) {
+		sp_bus_write(sp->bus, sp->dma_master, addr, val);
+	} else {
+		llsim_mem_port_set_datain(sp->sramd, sp->dma_port, val, 31, 0);
+		llsim_mem_port_write(sp->sramd, sp->dma_port, addr);
+	}
+}
+
+static inline int sp_dma_dataout(sp_t *sp)
+{
+	if (sp->bus)
+		return sp_bus_dataout(sp->bus, sp->dma_master);
+	return llsim_mem_port_extract_dataout(sp->sramd, sp->dma_port, 31, 0);
+}
+
+// the files of a core of a multi core system start with its unit name
+static char *sp_file_name(sp_t *sp, char *name, char *buf, int len)
+{
+	if (!sp->sys)
+		return name;
+	snprintf(buf, len, "%s_%s", sp->name, name);
+	return buf;
+}
+
+static FILE *sp_fopen(sp_t *sp, char *name, char *mode)
+{
+	char buf[64];
+
+	return llsim_fopen(sp_file_name(sp, name, buf, sizeof(buf)), mode);
+}
+
 static void sp_reset(sp_t *sp)
 {
 	sp_registers_t *sprn = sp->sprn;
 
 	memset(sprn, 0, sizeof(*sprn));
+	sprn->fetch0_pc = sp->entry;
+	if (sp->sys) {
+		sprn->r[2] = sp->core;
+		sprn->r[3] = sp->sys->nr_cores;
+	}
 }
 
 /*
@@ -150,10 +326,10 @@ static void sp_reset(sp_t *sp)
 #define CPY 25
 #define ASK 26
 
-int execute_exec0(llsim_memory_t *sramd, sp_registers_t *spro, int alu_0, int alu_1);
+int execute_exec0(sp_t *sp, sp_registers_t *spro, int alu_0, int alu_1);
 int exec_1_check_flush(sp_registers_t* spro, int next_pc);
-void handle_dec_1_hazards_and_assign_alu0(llsim_memory_t *sramd, sp_registers_t *sprn, sp_registers_t *spro);
-void handle_exec_0_hazards(llsim_memory_t *sramd,sp_registers_t *spro, int* alu_0, int* alu_1, int opcode);
+void handle_dec_1_hazards_and_assign_alu0(sp_t *sp, sp_registers_t *sprn, sp_registers_t *spro);
+void handle_exec_0_hazards(sp_t *sp,sp_registers_t *spro, int* alu_0, int* alu_1, int opcode);
 void handle_exec_0_DMA(sp_registers_t* sprn, sp_registers_t* spro);
 void exec_1_handle_flush(sp_registers_t* sprn, int next_pc);
 void handle_DMA(sp_t *sp, int memory_busy);
@@ -164,22 +340,164 @@ static char opcode_name[32][4] = {"ADD", "SUB", "LSF", "RSF", "AND", "OR", "XOR"
 				 "JLT", "JLE", "JEQ", "JNE", "JIN", "U", "U", "U",
 				 "HLT", "CPY", "ASK", "U", "U", "U", "U", "U"};
 
-static void dump_sram(sp_t *sp, char *name, llsim_memory_t *sram)
+static void dump_sram(sp_t *sp, char *name, llsim_memory_t *sram, int *base, FILE *hash_fp)
 {
+	int *words;
 	FILE *fp;
-	int i;
 
-	fp = fopen(name, "w");
+	fp = llsim_fopen(name, "w");
 	if (fp == NULL) {
-                printf("couldn't open file %s\n", name);
-                exit(1);
+                llsim_printf("couldn't open file %s\n", name);
+                llsim_abort();
+	}
+
+	// pages never written read back as zeros
+	words = llsim_malloc(SP_SRAM_HEIGHT * sizeof(int));
+	llsim_mem_load_range(sram, 0, words, SP_SRAM_HEIGHT);
+	if (sp_dump_write(fp, words, llsim->dump_delta ? base : NULL, SP_SRAM_HEIGHT, llsim->dump_threads)) {
+		llsim_printf("couldn't write file %s\n", name);
+		llsim_abort();
 	}
-	for (i = 0; i < SP_SRAM_HEIGHT; i++)
-		fprintf(fp, "%08x\n", llsim_mem_extract(sram, i, 31, 0));
+	if (hash_fp)
+		fprintf(hash_fp, "%s %016llx\n", name, sp_dump_hash(words, SP_SRAM_HEIGHT));
+	free(words);
 	fclose(fp);
 }
 
-void handle_branch_prediction(sp_registers_t* spro, sp_registers_t* sprn)
+/*
+ * srami of every core, then the sramd they share
+ */
+static void dump_srams(sp_t *sp)
+{
+	sp_system_t *sys = sp->sys;
+	FILE *hash_fp = NULL;
+	char name[64];
+	sp_t *core;
+	int i;
+
+	if (llsim->dump_hash) {
+		hash_fp = llsim_fopen("sram_hash.txt", "w");
+		if (hash_fp == NULL) {
+			llsim_printf("couldn't open file sram_hash.txt\n");
+			llsim_abort();
+		}
+	}
+	for (i = 0; i < (sys ? sys->nr_cores : 1); i++) {
+		core = sys ? sys->core[i] : sp;
+		dump_sram(core, sp_file_name(core, "srami_out.txt", name, sizeof(name)), core->srami, core->srami_base,
+			  hash_fp);
+	}
+	// the image went into sramd with core 0
+	core = sys ? sys->core[0] : sp;
+	dump_sram(core, "sramd_out.txt", sp->sramd, core->sramd_base, hash_fp);
+	if (hash_fp)
+		fclose(hash_fp);
+}
+
+static void sp_write_profile(sp_t *sp)
+{
+	FILE *report, *folded;
+	char *name;
+
+	report = sp_fopen(sp, "profile.txt", "w");
+	folded = sp_fopen(sp, "profile.folded", "w");
+	if (report == NULL || folded == NULL) {
+		llsim_printf("couldn't open file profile.txt or profile.folded\n");
+		llsim_abort();
+	}
+	name = strrchr(sp->program_name, '/');
+	sp_profile_report(sp->prof, name ? name + 1 : sp->program_name, report, folded);
+	fclose(report);
+	fclose(folded);
+}
+
+static void sp_cycle_trace(sp_t *sp)
+{
+	sp_registers_t *spro = sp->spro;
+	sp_cycle_record_t rec;
+	int i;
+
+	rec.cycle_counter = spro->cycle_counter;
+	for (i = 2; i <= 7; i++)
+		rec.r[i - 2] = spro->r[i];
+
+	rec.fetch0_active = spro->fetch0_active;
+	rec.fetch0_pc = spro->fetch0_pc;
+
+	rec.fetch1_active = spro->fetch1_active;
+	rec.fetch1_pc = spro->fetch1_pc;
+
+	rec.dec0_active = spro->dec0_active;
+	rec.dec0_pc = spro->dec0_pc;
+	rec.dec0_inst = spro->dec0_inst;
+
+	rec.dec1_active = spro->dec1_active;
+	rec.dec1_pc = spro->dec1_pc;
+	rec.dec1_inst = spro->dec1_inst;
+	rec.dec1_opcode = spro->dec1_opcode;
+	rec.dec1_src0 = spro->dec1_src0;
+	rec.dec1_src1 = spro->dec1_src1;
+	rec.dec1_dst = spro->dec1_dst;
+	rec.dec1_immediate = spro->dec1_immediate;
+
+	rec.exec0_active = spro->exec0_active;
+	rec.exec0_pc = spro->exec0_pc;
+	rec.exec0_inst = spro->exec0_inst;
+	rec.exec0_opcode = spro->exec0_opcode;
+	rec.exec0_src0 = spro->exec0_src0;
+	rec.exec0_src1 = spro->exec0_src1;
+	rec.exec0_dst = spro->exec0_dst;
+	rec.exec0_immediate = spro->exec0_immediate;
+	rec.exec0_alu0 = spro->exec0_alu0;
+	rec.exec0_alu1 = spro->exec0_alu1;
+
+	rec.exec1_active = spro->exec1_active;
+	rec.exec1_pc = spro->exec1_pc;
+	rec.exec1_inst = spro->exec1_inst;
+	rec.exec1_opcode = spro->exec1_opcode;
+	rec.exec1_src0 = spro->exec1_src0;
+	rec.exec1_src1 = spro->exec1_src1;
+	rec.exec1_dst = spro->exec1_dst;
+	rec.exec1_immediate = spro->exec1_immediate;
+	rec.exec1_alu0 = spro->exec1_alu0;
+	rec.exec1_alu1 = spro->exec1_alu1;
+	rec.exec1_aluout = spro->exec1_aluout;
+
+	if (llsim->cycle_trace_format == LLSIM_TRACE_FORMAT_BIN)
+		fwrite(&rec, sizeof(rec), 1, sp->cycle_trace_fp);
+	else
+		sp_cycle_trace_print(sp->cycle_trace_fp, &rec);
+}
+
+static void sp_open_cycle_trace(sp_t *sp)
+{
+	sp_cycle_trace_header_t header;
+	char *name;
+
+	// llsim writes the vcd from the registered signals
+	if (llsim->cycle_trace_format == LLSIM_TRACE_FORMAT_VCD)
+		return;
+
+	name = llsim->cycle_trace_format == LLSIM_TRACE_FORMAT_BIN ? "cycle_trace.bin" : "cycle_trace.txt";
+	sp->cycle_trace_fp = sp_fopen(sp, name, "w");
+	if (sp->cycle_trace_fp == NULL) {
+		llsim_printf("couldn't open file %s\n", name);
+		llsim_abort();
+	}
+	if (llsim->cycle_trace_format != LLSIM_TRACE_FORMAT_BIN)
+		return;
+
+	// records go through a large stdio buffer, flushed at exit
+	setvbuf(sp->cycle_trace_fp, NULL, _IOFBF, SP_CYCLE_TRACE_BUF_SIZE);
+	header.magic = SP_CYCLE_TRACE_MAGIC;
+	header.version = SP_CYCLE_TRACE_VERSION;
+	header.record_size = sizeof(sp_cycle_record_t);
+	header.reserved = 0;
+	fwrite(&header, sizeof(header), 1, sp->cycle_trace_fp);
+}
+
+// returns 1 when a load right after a store stalled dec0
+int handle_branch_prediction(sp_registers_t* spro, sp_registers_t* sprn)
 {
     int opcode = (spro->dec0_inst >> 25) & 31;
 
@@ -210,7 +528,7 @@ void handle_branch_prediction(sp_registers_t* spro, sp_registers_t* sprn)
         sprn->dec0_pc = spro->dec0_pc;
         sprn->dec0_inst = spro->dec0_inst;
         sprn->dec0_active = spro->dec0_active;
-
+        return 1;
     }
     else
     {
@@ -224,6 +542,7 @@ void handle_branch_prediction(sp_registers_t* spro, sp_registers_t* sprn)
         sprn->dec1_pc = spro->dec0_pc;
         sprn->dec1_active = 1;
     }
+    return 0;
 }
 
 bool is_branch_operaion(int opcode)
@@ -231,60 +550,19 @@ bool is_branch_operaion(int opcode)
     return opcode == JLT || opcode == JLE || opcode == JEQ || opcode == JNE || opcode == JIN;
 }
 
+static void sp_dma_ctl(sp_t *sp);
+static void sp_halt(sp_t *sp);
+
 static void sp_ctl(sp_t *sp)
 {
 	sp_registers_t *spro = sp->spro;
 	sp_registers_t *sprn = sp->sprn;
-	int i;
 
-	fprintf(cycle_trace_fp, "cycle %d\n", spro->cycle_counter);
-	fprintf(cycle_trace_fp, "cycle_counter %08x\n", spro->cycle_counter);
-	for (i = 2; i <= 7; i++)
-		fprintf(cycle_trace_fp, "r%d %08x\n", i, spro->r[i]);
-
-	fprintf(cycle_trace_fp, "fetch0_active %08x\n", spro->fetch0_active);
-	fprintf(cycle_trace_fp, "fetch0_pc %08x\n", spro->fetch0_pc);
-
-	fprintf(cycle_trace_fp, "fetch1_active %08x\n", spro->fetch1_active);
-	fprintf(cycle_trace_fp, "fetch1_pc %08x\n", spro->fetch1_pc);
-
-	fprintf(cycle_trace_fp, "dec0_active %08x\n", spro->dec0_active);
-	fprintf(cycle_trace_fp, "dec0_pc %08x\n", spro->dec0_pc);
-	fprintf(cycle_trace_fp, "dec0_inst %08x\n", spro->dec0_inst); // 32 bits
-
-	fprintf(cycle_trace_fp, "dec1_active %08x\n", spro->dec1_active);
-	fprintf(cycle_trace_fp, "dec1_pc %08x\n", spro->dec1_pc); // 16 bits
-	fprintf(cycle_trace_fp, "dec1_inst %08x\n", spro->dec1_inst); // 32 bits
-	fprintf(cycle_trace_fp, "dec1_opcode %08x\n", spro->dec1_opcode); // 5 bits
-	fprintf(cycle_trace_fp, "dec1_src0 %08x\n", spro->dec1_src0); // 3 bits
-	fprintf(cycle_trace_fp, "dec1_src1 %08x\n", spro->dec1_src1); // 3 bits
-	fprintf(cycle_trace_fp, "dec1_dst %08x\n", spro->dec1_dst); // 3 bits
-	fprintf(cycle_trace_fp, "dec1_immediate %08x\n", spro->dec1_immediate); // 32 bits
-
-	fprintf(cycle_trace_fp, "exec0_active %08x\n", spro->exec0_active);
-	fprintf(cycle_trace_fp, "exec0_pc %08x\n", spro->exec0_pc); // 16 bits
-	fprintf(cycle_trace_fp, "exec0_inst %08x\n", spro->exec0_inst); // 32 bits
-	fprintf(cycle_trace_fp, "exec0_opcode %08x\n", spro->exec0_opcode); // 5 bits
-	fprintf(cycle_trace_fp, "exec0_src0 %08x\n", spro->exec0_src0); // 3 bits
-	fprintf(cycle_trace_fp, "exec0_src1 %08x\n", spro->exec0_src1); // 3 bits
-	fprintf(cycle_trace_fp, "exec0_dst %08x\n", spro->exec0_dst); // 3 bits
-	fprintf(cycle_trace_fp, "exec0_immediate %08x\n", spro->exec0_immediate); // 32 bits
-	fprintf(cycle_trace_fp, "exec0_alu0 %08x\n", spro->exec0_alu0); // 32 bits
-	fprintf(cycle_trace_fp, "exec0_alu1 %08x\n", spro->exec0_alu1); // 32 bits
-
-	fprintf(cycle_trace_fp, "exec1_active %08x\n", spro->exec1_active);
-	fprintf(cycle_trace_fp, "exec1_pc %08x\n", spro->exec1_pc); // 16 bits
-	fprintf(cycle_trace_fp, "exec1_inst %08x\n", spro->exec1_inst); // 32 bits
-	fprintf(cycle_trace_fp, "exec1_opcode %08x\n", spro->exec1_opcode); // 5 bits
-	fprintf(cycle_trace_fp, "exec1_src0 %08x\n", spro->exec1_src0); // 3 bits
-	fprintf(cycle_trace_fp, "exec1_src1 %08x\n", spro->exec1_src1); // 3 bits
-	fprintf(cycle_trace_fp, "exec1_dst %08x\n", spro->exec1_dst); // 3 bits
-	fprintf(cycle_trace_fp, "exec1_immediate %08x\n", spro->exec1_immediate); // 32 bits
-	fprintf(cycle_trace_fp, "exec1_alu0 %08x\n", spro->exec1_alu0); // 32 bits
-	fprintf(cycle_trace_fp, "exec1_alu1 %08x\n", spro->exec1_alu1); // 32 bits
-	fprintf(cycle_trace_fp, "exec1_aluout %08x\n", spro->exec1_aluout);
-
-	fprintf(cycle_trace_fp, "\n\n\n");
+	if (sp->prof)
+		sp_profile_clock(sp->prof);
+
+	if (llsim_trace_on(LLSIM_TRACE_CYCLE) && sp->cycle_trace_fp)
+		sp_cycle_trace(sp);
 
 	sp_printf("cycle_counter %08x\n", spro->cycle_counter);
 	sp_printf("r2 %08x, r3 %08x\n", spro->r[2], spro->r[3]);
@@ -302,7 +580,7 @@ static void sp_ctl(sp_t *sp)
     // fetch0
     sprn->fetch1_active = 0;
     if (spro->fetch0_active) {
-		if(!DMA_Finished)
+		if(!sp->DMA_Finished)
 		{
 	        llsim_mem_read(sp->srami, spro->fetch0_pc);
 	        sprn->fetch0_pc = (spro->fetch0_pc + 1) & 65535;
@@ -315,7 +593,7 @@ static void sp_ctl(sp_t *sp)
     // fetch1
     if (spro->fetch1_active) 
     {
-		if(!DMA_Finished)
+		if(!sp->DMA_Finished)
         {
             sprn->dec0_pc = spro->fetch1_pc;
             sprn->dec0_inst = llsim_mem_extract_dataout(sp->srami, 31, 0);
@@ -330,9 +608,10 @@ static void sp_ctl(sp_t *sp)
     // dec0
     if (spro->dec0_active) 
     {
-		if(!DMA_Finished)
+		if(!sp->DMA_Finished)
         {
-            handle_branch_prediction(spro, sprn);
+            if (handle_branch_prediction(spro, sprn))
+                llsim_counter_inc(sp->counter[SP_CNT_LD_ST_STALLS]);
 		}
 		else 
         {
@@ -348,9 +627,9 @@ static void sp_ctl(sp_t *sp)
     // dec1
     if (spro->dec1_active) 
     {
-		if(!DMA_Finished)
+		if(!sp->DMA_Finished)
         {
-            handle_dec_1_hazards_and_assign_alu0(sp->sramd, sprn, spro);
+            handle_dec_1_hazards_and_assign_alu0(sp, sprn, spro);
 
             //transfer other registers to next step
             sprn->exec0_pc = spro->dec1_pc;
@@ -374,11 +653,11 @@ static void sp_ctl(sp_t *sp)
         int alu_0 = spro->exec0_alu0;
         int alu_1 = spro->exec0_alu1;
 
-        handle_exec_0_hazards(sp->sramd, spro, &alu_0, &alu_1, spro->exec1_opcode);
+        handle_exec_0_hazards(sp, spro, &alu_0, &alu_1, spro->exec1_opcode);
 
         if (spro->exec0_opcode != CPY)
         {
-            sprn->exec1_aluout = execute_exec0(sp->sramd, spro, alu_0, alu_1);
+            sprn->exec1_aluout = execute_exec0(sp, spro, alu_0, alu_1);
         }
 
         handle_exec_0_DMA(sprn, spro);
@@ -407,34 +686,36 @@ static void sp_ctl(sp_t *sp)
     {
         sp_printf("exec1: pc %d, inst %08x, opcode %d, aluout %d\n", spro->exec1_pc, spro->exec1_inst,
                   spro->exec1_opcode, spro->exec1_aluout);
-        inst_trace_print(sp);
+        if (llsim_trace_on(LLSIM_TRACE_INST))
+            inst_trace_print(sp);
 
         sp->inst_cnt = sp->inst_cnt + 1;
+        llsim_counter_inc(sp->counter[SP_CNT_COMMITTED]);
+        if (sp->prof)
+            sp_profile_commit(sp->prof, spro->exec1_pc, spro->exec1_inst);
 
-        if ((spro->exec1_opcode == HLT)||(DMA_Finished)) 
+        if ((spro->exec1_opcode == HLT)||(sp->DMA_Finished)) 
         {
 			if(spro->DMA_num_of_operations_left > 0)
             {
-				DMA_Finished=true;
+				sp->DMA_Finished=true;
 			}
 			else
             {
-				DMA_Finished = false;
-				fprintf(inst_trace_fp, "sim finished at pc %d, %d instructions", sp->spro->exec1_pc, sp->inst_cnt);
-				llsim_stop();
-				dump_sram(sp, "srami_out.txt", sp->srami);
-				dump_sram(sp, "sramd_out.txt", sp->sramd);
+				sp->DMA_Finished = false;
+				if (llsim_trace_on(LLSIM_TRACE_INST))
+					fprintf(sp->inst_trace_fp, "sim finished at pc %d, %d instructions", sp->spro->exec1_pc, sp->inst_cnt);
+				sp_halt(sp);
             }
         }
         else if (spro->exec1_opcode == ST)
         {
-            llsim_mem_set_datain(sp->sramd, spro->exec1_alu0, 31, 0);
-            llsim_mem_write(sp->sramd, spro->exec1_alu1);
+            sp_dmem_write(sp, spro->exec1_alu1, spro->exec1_alu0);
         }
         else if (spro->exec1_opcode == LD)
         {
             if (spro->exec1_dst != 0 && spro->exec1_dst != 1)
-                sprn->r[spro->exec1_dst] = llsim_mem_extract_dataout(sp->sramd, 31, 0);
+                sprn->r[spro->exec1_dst] = sp_dmem_dataout(sp);
         }
         else if (is_branch_operaion(spro->exec1_opcode)) 
         {
@@ -475,6 +756,7 @@ static void sp_ctl(sp_t *sp)
             if (exec_1_check_flush(spro, next_pc))
             {
                 exec_1_handle_flush(sprn, next_pc);
+                llsim_counter_inc(sp->counter[SP_CNT_FLUSHES]);
             }
 
         }
@@ -485,12 +767,20 @@ static void sp_ctl(sp_t *sp)
 
     }
 
-    if (spro->exec1_opcode == CPY && !DMA_active)
+    sp_dma_ctl(sp);
+}
+
+static void sp_dma_ctl(sp_t *sp)
+{
+	sp_registers_t *spro = sp->spro;
+	sp_registers_t *sprn = sp->sprn;
+
+    if (spro->exec1_opcode == CPY && !sp->DMA_active)
     {
-        DMA_active = true;
+        sp->DMA_active = true;
     }
 
-    if(!DMA_Finished)
+    if(!sp->DMA_Finished)
     {
         int memory_busy = 1;
         if (sprn->dec1_opcode != LD && sprn->exec0_opcode != LD && sprn->exec1_opcode != LD &&
@@ -498,14 +788,334 @@ static void sp_ctl(sp_t *sp)
         {
             memory_busy = 0;
         }
-	    handle_DMA(sp, memory_busy);
+	    // on a port of its own, or behind the bus arbiter, the DMA doesn't
+	    // have to wait for loads and stores
+	    handle_DMA(sp, llsim_log_value(sp->dma_wait_log, sp->dma_port || sp->bus ? 0 : memory_busy));
     }
 	else
     {
         handle_DMA(sp, 0);
     }
-    
+    llsim_log_check(sp->dma_left_log, sprn->DMA_num_of_operations_left);
+}
+
+/*
+ * a clock the bus didn't grant the pipeline: every pipeline register
+ * keeps its value (new still equals old at the start of a clock), fetch
+ * reads srami again for fetch1 to find the same word when the clock is
+ * repeated, the DMA goes on
+ */
+static void sp_stall(sp_t *sp)
+{
+	sp_registers_t *spro = sp->spro;
+	sp_registers_t *sprn = sp->sprn;
+
+	if (sp->prof)
+		sp_profile_clock(sp->prof);
 
+	if (llsim_trace_on(LLSIM_TRACE_CYCLE) && sp->cycle_trace_fp)
+		sp_cycle_trace(sp);
+
+	sp_printf("bus stall\n");
+	sprn->cycle_counter = spro->cycle_counter + 1;
+	if (spro->fetch1_active && !sp->DMA_Finished)
+		llsim_mem_read(sp->srami, spro->fetch1_pc);
+	llsim_counter_inc(sp->bus_stalls);
+	sp_dma_ctl(sp);
+}
+
+/*
+ * tell the bus what the pipeline and the DMA access in the next clock
+ */
+static void sp_bus_requests(sp_t *sp)
+{
+	sp_registers_t *sprn = sp->sprn;
+
+	if (sp->halted)
+		return;
+	if (sprn->exec1_active && sprn->exec1_opcode == ST && !sp->DMA_Finished)
+		sp_bus_request(sp->bus, sp->core, 1, sprn->exec1_alu1);
+	else if (sprn->exec0_active && sprn->exec0_opcode == LD)
+		sp_bus_request(sp->bus, sp->core, 0, 0);
+
+	if (sprn->DMA_state == DMA_READ)
+		sp_bus_request(sp->bus, sp->dma_master, 0, 0);
+	else if (sprn->DMA_state == DMA_WRITE)
+		sp_bus_request(sp->bus, sp->dma_master, 1, sprn->DMA_curr_dest_addr);
+}
+
+/*
+ * the program halted and the DMA is done. the last core to halt stops the
+ * simulation.
+ */
+static void sp_halt(sp_t *sp)
+{
+	sp->halted = 1;
+	if (sp->prof)
+		sp_write_profile(sp);
+	// cores can halt at the same time with llsim -w
+	if (sp->sys && __atomic_sub_fetch(&sp->sys->running, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
+	llsim_stop();
+	dump_srams(sp);
+}
+
+/*
+ * idle cycle fast forward (llsim -f)
+ *
+ * while a DMA copy runs, programs poll it with a loop like ASK/JNE that
+ * does nothing but watch the remaining count go down. every cycle of the
+ * copy sp_ff_record() takes a snapshot of the whole sp state. once three
+ * periods of P cycles in a row differ by the same per word deltas, with
+ * only registers, counters, alu values and DMA pointers changing and
+ * nothing but ADD, SUB, ASK and conditional branches executing, the state
+ * K periods later is the current one plus K times the deltas. sp_ff_skip()
+ * takes the largest K for which no branch changes direction, the DMA
+ * doesn't finish and nothing overflows, copies the words the DMA would
+ * have moved, and skips the clock forward by K * P. registers, counters
+ * and memories come out exactly as without -f. only used with -t none,
+ * the skipped cycles leave no trace.
+ */
+#define SP_FF_NO_LIMIT	(1LL << 40)
+
+static void sp_ff_init(sp_t *sp)
+{
+	int i;
+
+	// skipped cycles commit instructions nobody sees, or log
+	sp->ff = llsim->fast_forward && !llsim_trace_on(LLSIM_TRACE_INST) && !sp->prof && !sp->sys &&
+		llsim->log_mode == LLSIM_LOG_NONE;
+
+	for (i = 0; i < 8; i++)
+		sp->ff_vary[SP_FF_REG(r) + i] = 1;
+	sp->ff_vary[SP_FF_REG(cycle_counter)] = 1;
+	sp->ff_vary[SP_FF_REG(exec0_alu0)] = 1;
+	sp->ff_vary[SP_FF_REG(exec0_alu1)] = 1;
+	sp->ff_vary[SP_FF_REG(exec1_alu0)] = 1;
+	sp->ff_vary[SP_FF_REG(exec1_alu1)] = 1;
+	sp->ff_vary[SP_FF_REG(exec1_aluout)] = 1;
+	sp->ff_vary[SP_FF_REG(DMA_num_of_operations_left)] = 1;
+	sp->ff_vary[SP_FF_REG(DMA_curr_src_addr)] = 1;
+	sp->ff_vary[SP_FF_REG(DMA_curr_dest_addr)] = 1;
+	sp->ff_vary[SP_FF_REGS_WORDS + SP_FF_INST_CNT] = 1;
+	sp->ff_vary[SP_FF_REGS_WORDS + SP_FF_SRAMD_READ_ADDR] = 1;
+	sp->ff_vary[SP_FF_REGS_WORDS + SP_FF_SRAMD_WRITE_ADDR] = 1;
+	for (i = 0; i < SP_NR_COUNTERS; i++)
+		sp->ff_vary[SP_FF_REGS_WORDS + SP_FF_COUNTER + i] = 1;
+}
+
+// the snapshot taken age cycles ago, 0 is the current cycle
+static int *sp_ff_snapshot(sp_t *sp, int age)
+{
+	return sp->ff_ring[(sp->ff_head + 2 * SP_FF_RING - 1 - age) % SP_FF_RING];
+}
+
+static void sp_ff_record(sp_t *sp)
+{
+	llsim_mem_port_t *dma = &sp->sramd->port[sp->dma_port];
+	int *s = sp->ff_ring[sp->ff_head];
+	int *x = s + SP_FF_REGS_WORDS;
+	int i;
+
+	memcpy(s, sp->spro, sizeof(sp_registers_t));
+	x[SP_FF_INST_CNT] = sp->inst_cnt;
+	x[SP_FF_START] = sp->start;
+	x[SP_FF_DMA_FINISHED] = sp->DMA_Finished;
+	x[SP_FF_DMA_ACTIVE] = sp->DMA_active;
+	x[SP_FF_SRAMI_READ_ADDR] = sp->srami->port[0].read_addr;
+	x[SP_FF_SRAMI_DATAOUT] = sp->srami->port[0].dataout;
+	x[SP_FF_SRAMD_READ_ADDR] = dma->read_addr;
+	x[SP_FF_SRAMD_WRITE_ADDR] = dma->write_addr;
+	for (i = 0; i < SP_NR_COUNTERS; i++)
+		x[SP_FF_COUNTER + i] = sp->counter[i]->value;
+	x[SP_FF_SRAMD_READ] = 0;
+	x[SP_FF_SRAMD_WRITE] = 0;
+
+	sp->ff_head = (sp->ff_head + 1) % SP_FF_RING;
+	if (sp->ff_nr < SP_FF_RING)
+		sp->ff_nr++;
+}
+
+static void sp_ff_record_access(sp_t *sp)
+{
+	int *x = sp_ff_snapshot(sp, 0) + SP_FF_REGS_WORDS;
+
+	x[SP_FF_SRAMD_READ] = sp->sramd->port[sp->dma_port].read;
+	x[SP_FF_SRAMD_WRITE] = sp->sramd->port[sp->dma_port].write;
+}
+
+/*
+ * what exec0 and exec1 may hold. exec0 also sees the instructions fetched
+ * past the loop that exec1 flushes, those only must not touch memory or
+ * the DMA on the way.
+ */
+static int sp_ff_opcode_ok(int active, int opcode, int exec0)
+{
+	return !active || opcode == ADD || opcode == SUB || opcode == ASK ||
+		(opcode >= JLT && opcode <= JNE) || (exec0 && opcode == HLT);
+}
+
+/*
+ * the last three periods of period cycles step by the same deltas. the
+ * accesses of the current cycle aren't known yet, so it is only compared
+ * on the state it started with.
+ */
+static int sp_ff_periodic(sp_t *sp, int period)
+{
+	int j, w, *a, *b, *c;
+
+	for (j = 0; j <= period; j++) {
+		a = sp_ff_snapshot(sp, j);
+		b = sp_ff_snapshot(sp, j + period);
+		c = sp_ff_snapshot(sp, j + 2 * period);
+		for (w = 0; w < SP_FF_WORDS; w++) {
+			if (j == 0 && w >= SP_FF_REGS_WORDS + SP_FF_SRAMD_READ)
+				continue;
+			if (sp->ff_vary[w]) {
+				if ((long long) a[w] - b[w] != (long long) b[w] - c[w])
+					return 0;
+			} else if (a[w] != b[w] || b[w] != c[w]) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+// how many steps of dv v can take without leaving [lo, hi]
+static long long sp_ff_limit(long long v, long long dv, long long lo, long long hi)
+{
+	if (v < lo || v > hi)
+		return -1;
+	if (dv > 0)
+		return (hi - v) / dv;
+	if (dv < 0)
+		return (v - lo) / -dv;
+	return SP_FF_NO_LIMIT;
+}
+
+static long long sp_ff_min(long long a, long long b)
+{
+	return a < b ? a : b;
+}
+
+// how many more periods behave like the last one
+static long long sp_ff_periods(sp_t *sp, int period)
+{
+	sp_registers_t *ra, *rb;
+	long long k = SP_FF_NO_LIMIT, diff, ddiff;
+	int j, w, *a, *b;
+
+	for (j = 0; j < period; j++) {
+		a = sp_ff_snapshot(sp, j);
+		b = sp_ff_snapshot(sp, j + period);
+		ra = (sp_registers_t *) a;
+		rb = (sp_registers_t *) b;
+
+		if (!sp_ff_opcode_ok(ra->exec0_active, ra->exec0_opcode, 1) ||
+		    !sp_ff_opcode_ok(ra->exec1_active, ra->exec1_opcode, 0))
+			return 0;
+
+		for (w = 0; w < SP_FF_REGS_WORDS + SP_FF_COUNTER; w++) {
+			if (sp->ff_vary[w])
+				k = sp_ff_min(k, sp_ff_limit(a[w], (long long) a[w] - b[w], INT_MIN, INT_MAX));
+		}
+
+		// the DMA finishes when a write finds one operation left
+		k = sp_ff_min(k, sp_ff_limit(ra->DMA_num_of_operations_left,
+					     (long long) ra->DMA_num_of_operations_left - rb->DMA_num_of_operations_left,
+					     2, INT_MAX));
+		k = sp_ff_min(k, sp_ff_limit(ra->DMA_curr_src_addr, (long long) ra->DMA_curr_src_addr - rb->DMA_curr_src_addr,
+					     0, SP_SRAM_HEIGHT - 1));
+		k = sp_ff_min(k, sp_ff_limit(ra->DMA_curr_dest_addr, (long long) ra->DMA_curr_dest_addr - rb->DMA_curr_dest_addr,
+					     0, SP_SRAM_HEIGHT - 1));
+
+		// a conditional branch in exec1 compared alu0 with alu1, keep the outcome
+		if (ra->exec1_opcode >= JLT && ra->exec1_opcode <= JNE) {
+			diff = (long long) ra->exec1_alu0 - ra->exec1_alu1;
+			ddiff = diff - ((long long) rb->exec1_alu0 - rb->exec1_alu1);
+			if (diff > 0)
+				k = sp_ff_min(k, sp_ff_limit(diff, ddiff, 1, SP_FF_NO_LIMIT));
+			else if (diff < 0)
+				k = sp_ff_min(k, sp_ff_limit(diff, ddiff, -SP_FF_NO_LIMIT, -1));
+			else
+				k = sp_ff_min(k, sp_ff_limit(diff, ddiff, 0, 0));
+		}
+	}
+	return k;
+}
+
+static void sp_ff_skip(sp_t *sp)
+{
+	llsim_mem_port_t *dma = &sp->sramd->port[sp->dma_port];
+	sp_registers_t *spro = sp->spro;
+	int *regs = (int *) spro;
+	int *a, *b, *x, period, w, i, src, dst, words, done;
+	long long k;
+
+	if (sp->ff_backoff > 0) {
+		sp->ff_backoff--;
+		return;
+	}
+	if (!spro->exec1_active || spro->exec1_opcode < JLT || spro->exec1_opcode > JNE)
+		return;
+
+	for (period = 1; period <= SP_FF_MAX_PERIOD && 3 * period < sp->ff_nr; period++) {
+		if (sp_ff_periodic(sp, period))
+			break;
+	}
+	if (period > SP_FF_MAX_PERIOD || 3 * period >= sp->ff_nr) {
+		sp->ff_backoff = SP_FF_MAX_PERIOD;
+		return;
+	}
+
+	a = sp_ff_snapshot(sp, 0);
+	b = sp_ff_snapshot(sp, period);
+	k = sp_ff_periods(sp, period) - 1;
+	if (llsim->save_clock > llsim->clock)
+		k = sp_ff_min(k, (llsim->save_clock - llsim->clock) / period);
+	k = sp_ff_min(k, (INT_MAX - llsim->clock) / period);
+	done = b[SP_FF_REG(DMA_num_of_operations_left)] - a[SP_FF_REG(DMA_num_of_operations_left)];
+	if (k < 1 || done <= 0) {
+		sp->ff_backoff = SP_FF_MAX_PERIOD;
+		return;
+	}
+
+	// the copies the DMA would have made, in its order
+	src = spro->DMA_curr_src_addr;
+	dst = spro->DMA_curr_dest_addr;
+	words = k * done;
+	for (i = 0; i < words; i++)
+		llsim_mem_store(sp->sramd, dst + i, llsim_mem_extract(sp->sramd, src + i, 31, 0));
+
+	for (w = 0; w < SP_FF_REGS_WORDS; w++) {
+		if (sp->ff_vary[w])
+			regs[w] = a[w] + k * (a[w] - b[w]);
+	}
+	x = a + SP_FF_REGS_WORDS;
+	sp->inst_cnt = x[SP_FF_INST_CNT] + k * (x[SP_FF_INST_CNT] - b[SP_FF_REGS_WORDS + SP_FF_INST_CNT]);
+	dma->read_addr = x[SP_FF_SRAMD_READ_ADDR] + k * (x[SP_FF_SRAMD_READ_ADDR] - b[SP_FF_REGS_WORDS + SP_FF_SRAMD_READ_ADDR]);
+	dma->write_addr = x[SP_FF_SRAMD_WRITE_ADDR] + k * (x[SP_FF_SRAMD_WRITE_ADDR] - b[SP_FF_REGS_WORDS + SP_FF_SRAMD_WRITE_ADDR]);
+	for (i = 0; i < SP_NR_COUNTERS; i++)
+		llsim_counter_add(sp->counter[i], k * (int) ((unsigned) x[SP_FF_COUNTER + i] -
+							  b[SP_FF_REGS_WORDS + SP_FF_COUNTER + i]));
+
+	/*
+	 * the DMA is the only sramd user in the loop: datain holds the last
+	 * word written, dataout what the previous cycle read, or after a
+	 * write the word read for it
+	 */
+	x = sp_ff_snapshot(sp, 1) + SP_FF_REGS_WORDS;
+	dma->datain = llsim_mem_extract(sp->sramd, dma->write_addr, 31, 0);
+	dma->valid = x[SP_FF_SRAMD_READ];
+	if (x[SP_FF_SRAMD_READ])
+		dma->dataout = llsim_mem_extract(sp->sramd, dma->read_addr, 31, 0);
+	else if (x[SP_FF_SRAMD_WRITE])
+		dma->dataout = dma->datain;
+
+	llsim_regs_sync(sp->ur);
+	llsim_skip_clocks(k * period);
+	sp->ff_nr = 0;
 }
 
 static void sp_run(llsim_unit_t *unit)
@@ -517,81 +1127,319 @@ static void sp_run(llsim_unit_t *unit)
 		return;
 	}
 
-	sp->srami->read = 0;
-	sp->srami->write = 0;
-	sp->sramd->read = 0;
-	sp->sramd->write = 0;
+	sp->srami->port[0].read = 0;
+	sp->srami->port[0].write = 0;
+	if (sp->bus) {
+		sp_bus_begin(sp->bus, sp->core);
+		sp_bus_begin(sp->bus, sp->dma_master);
+		if (sp->halted)
+			return;
+		if (sp_bus_blocked(sp->bus, sp->core))
+			sp_stall(sp);
+		else
+			sp_ctl(sp);
+		sp_bus_requests(sp);
+		return;
+	}
+	sp->sramd->port[0].read = 0;
+	sp->sramd->port[0].write = 0;
+	sp->sramd->port[sp->dma_port].read = 0;
+	sp->sramd->port[sp->dma_port].write = 0;
+
+	if (sp->ff) {
+		if (sp->DMA_active && !sp->DMA_Finished) {
+			sp_ff_record(sp);
+			sp_ff_skip(sp);
+		} else {
+			sp->ff_nr = 0;
+		}
+	}
 
 	sp_ctl(sp);
+
+	if (sp->ff && sp->ff_nr)
+		sp_ff_record_access(sp);
 }
 
 static void sp_generate_sram_memory_image(sp_t *sp, char *program_name)
 {
-    FILE *fp;
-    int addr, i;
+	sp_exe_section_t *s;
+	sp_image_t image;
+	char error[256];
+	int i, last;
+
+	if (sp_image_load(program_name, &image, SP_SRAM_HEIGHT, error, sizeof(error)) < 0) {
+		llsim_printf("%s\n", error);
+		llsim_abort();
+	}
 
-    fp = fopen(program_name, "r");
-    if (fp == NULL) {
-            printf("couldn't open file %s\n", program_name);
-            exit(1);
-    }
-    addr = 0;
-    while (addr < SP_SRAM_HEIGHT) 
-    {
-            fscanf(fp, "%08x\n", &sp->memory_image[addr]);
-            addr++;
-            if (feof(fp))
-                    break;
-    }
-	sp->memory_image_size = addr;
+	// the sections go in a page at a time, the memories start zeroed so a
+	// bss section needs nothing
+	for (i = 0; i < image.nr_sections; i++) {
+		s = &image.section[i];
+		if (s->type & SP_EXE_CODE)
+			llsim_mem_store_range(sp->srami, s->addr, image.words[i], s->size);
+		if ((s->type & SP_EXE_DATA) && sp->core == 0)
+			llsim_mem_store_range(sp->sramd, s->addr, image.words[i], s->size);
+	}
+
+	// the last word of a text image can still sign extend into the next
+	// entry, see llsim_mem_inject_bits()
+	last = image.end - 1;
+	if (!image.exe && image.words[0][last] < 0) {
+		llsim_mem_inject(sp->srami, last, image.words[0][last], 31, 0);
+		if (sp->core == 0)
+			llsim_mem_inject(sp->sramd, last, image.words[0][last], 31, 0);
+	}
+	sp->entry = image.entry;
+	sp_image_free(&image);
+
+	if (llsim->dump_delta) {
+		sp->srami_base = llsim_malloc(SP_SRAM_HEIGHT * sizeof(int));
+		llsim_mem_load_range(sp->srami, 0, sp->srami_base, SP_SRAM_HEIGHT);
+		if (sp->core == 0) {
+			sp->sramd_base = llsim_malloc(SP_SRAM_HEIGHT * sizeof(int));
+			llsim_mem_load_range(sp->sramd, 0, sp->sramd_base, SP_SRAM_HEIGHT);
+		}
+	}
 
-    fprintf(inst_trace_fp, "program %s loaded, %d lines\n", program_name, addr);
+	if (llsim_trace_on(LLSIM_TRACE_INST))
+		fprintf(sp->inst_trace_fp, "program %s loaded, %d lines\n", program_name, image.end);
+}
 
-	for (i = 0; i < sp->memory_image_size; i++) 
-    {
-		llsim_mem_inject(sp->srami, i, sp->memory_image[i], 31, 0);
-		llsim_mem_inject(sp->sramd, i, sp->memory_image[i], 31, 0);
+static void sp_free(llsim_unit_t *unit)
+{
+	sp_t *sp = (sp_t *) unit->private;
+
+	if (sp->inst_trace_fp)
+		fclose(sp->inst_trace_fp);
+	if (sp->cycle_trace_fp)
+		fclose(sp->cycle_trace_fp);
+	if (sp->prof)
+		sp_profile_free(sp->prof);
+	free(sp->srami_base);
+	free(sp->sramd_base);
+	// core 0 owns the system, it is the first unit freed
+	if (sp->sys && sp->core == 0)
+		free(sp->sys);
+	free(sp);
+	unit->private = NULL;
+}
+
+#define sp_register(sp, field, bits)						\
+	llsim_register_register((sp)->name, #field, bits, 0, &(sp)->spro->field, &(sp)->sprn->field)
+
+static void sp_register_port(sp_t *sp, char *name, llsim_mem_port_t *port, int write)
+{
+	char wire_name[64];
+
+	snprintf(wire_name, sizeof(wire_name), "%s_read", name);
+	llsim_register_wire(sp->name, wire_name, 1, &port->read);
+	snprintf(wire_name, sizeof(wire_name), "%s_read_addr", name);
+	llsim_register_wire(sp->name, wire_name, 16, &port->read_addr);
+	if (!write)
+		return;
+	snprintf(wire_name, sizeof(wire_name), "%s_write", name);
+	llsim_register_wire(sp->name, wire_name, 1, &port->write);
+	snprintf(wire_name, sizeof(wire_name), "%s_write_addr", name);
+	llsim_register_wire(sp->name, wire_name, 16, &port->write_addr);
+	snprintf(wire_name, sizeof(wire_name), "%s_datain", name);
+	llsim_register_wire(sp->name, wire_name, 32, &port->datain);
+}
+
+/*
+ * signal metadata: the pipeline registers with the widths of
+ * sp_registers_t and the memory ports as wires
+ */
+static void sp_register_signals(sp_t *sp)
+{
+	char name[16];
+	int i;
+
+	for (i = 2; i <= 7; i++) {
+		snprintf(name, sizeof(name), "r%d", i);
+		llsim_register_register(sp->name, name, 32, 0, &sp->spro->r[i], &sp->sprn->r[i]);
 	}
+	sp_register(sp, cycle_counter, 32);
+
+	sp_register(sp, fetch0_active, 1);
+	sp_register(sp, fetch0_pc, 16);
+
+	sp_register(sp, fetch1_active, 1);
+	sp_register(sp, fetch1_pc, 16);
+
+	sp_register(sp, dec0_active, 1);
+	sp_register(sp, dec0_pc, 16);
+	sp_register(sp, dec0_inst, 32);
+
+	sp_register(sp, dec1_active, 1);
+	sp_register(sp, dec1_pc, 16);
+	sp_register(sp, dec1_inst, 32);
+	sp_register(sp, dec1_opcode, 5);
+	sp_register(sp, dec1_src0, 3);
+	sp_register(sp, dec1_src1, 3);
+	sp_register(sp, dec1_dst, 3);
+	sp_register(sp, dec1_immediate, 32);
+
+	sp_register(sp, exec0_active, 1);
+	sp_register(sp, exec0_pc, 16);
+	sp_register(sp, exec0_inst, 32);
+	sp_register(sp, exec0_opcode, 5);
+	sp_register(sp, exec0_src0, 3);
+	sp_register(sp, exec0_src1, 3);
+	sp_register(sp, exec0_dst, 3);
+	sp_register(sp, exec0_immediate, 32);
+	sp_register(sp, exec0_alu0, 32);
+	sp_register(sp, exec0_alu1, 32);
+
+	sp_register(sp, exec1_active, 1);
+	sp_register(sp, exec1_pc, 16);
+	sp_register(sp, exec1_inst, 32);
+	sp_register(sp, exec1_opcode, 5);
+	sp_register(sp, exec1_src0, 3);
+	sp_register(sp, exec1_src1, 3);
+	sp_register(sp, exec1_dst, 3);
+	sp_register(sp, exec1_immediate, 32);
+	sp_register(sp, exec1_alu0, 32);
+	sp_register(sp, exec1_alu1, 32);
+	sp_register(sp, exec1_aluout, 32);
+
+	for (i = 0; i < BHT_SIZE; i++) {
+		snprintf(name, sizeof(name), "BHT%d", i);
+		llsim_register_register(sp->name, name, 2, 0, &sp->spro->BHT[i], &sp->sprn->BHT[i]);
+	}
+
+	sp_register(sp, DMA_busy, 1);
+	sp_register(sp, DMA_state, 2);
+	sp_register(sp, DMA_num_of_operations_left, 32);
+	sp_register(sp, DMA_curr_src_addr, 16);
+	sp_register(sp, DMA_curr_dest_addr, 16);
+
+	sp_register_port(sp, "srami", &sp->srami->port[0], 0);
+	if (sp->bus)
+		return;
+	sp_register_port(sp, "sramd", &sp->sramd->port[0], 1);
+	if (sp->dma_port)
+		sp_register_port(sp, "sramd_dma", &sp->sramd->port[sp->dma_port], 1);
 }
 
-void sp_init(char *program_name)
+static sp_t *sp_init_core(char *program_name, sp_system_t *sys, int core)
 {
 	llsim_unit_t *llsim_sp_unit;
 	llsim_unit_registers_t *llsim_ur;
 	sp_t *sp;
 
-	llsim_printf("initializing sp unit\n");
+	sp = llsim_malloc(sizeof(sp_t));
+	sp->sys = sys;
+	sp->core = core;
+	if (sys)
+		snprintf(sp->name, sizeof(sp->name), "sp%d", core);
+	else
+		strcpy(sp->name, "sp");
+	llsim_sp_unit = llsim_register_unit(sp->name, sp_run);
+	llsim_sp_unit->private = sp;
+	llsim_sp_unit->free = sp_free;
+	// a core only shares sramd, and the bus that owns it runs after the cores
+	llsim_sp_unit->parallel = sys != NULL;
+
+	if (llsim_trace_on(LLSIM_TRACE_INST)) {
+		llsim_printf("initializing %s unit\n", sp->name);
 
-	inst_trace_fp = fopen("inst_trace.txt", "w");
-	if (inst_trace_fp == NULL) {
-		printf("couldn't open file inst_trace.txt\n");
-		exit(1);
+		sp->inst_trace_fp = sp_fopen(sp, "inst_trace.txt", "w");
+		if (sp->inst_trace_fp == NULL) {
+			llsim_printf("couldn't open file inst_trace.txt\n");
+			llsim_abort();
+		}
 	}
 
-	cycle_trace_fp = fopen("cycle_trace.txt", "w");
-	if (cycle_trace_fp == NULL) {
-		printf("couldn't open file cycle_trace.txt\n");
-		exit(1);
-	}
+	if (llsim_trace_on(LLSIM_TRACE_CYCLE))
+		sp_open_cycle_trace(sp);
+
+	sp->program_name = program_name;
+	if (llsim->profile)
+		sp->prof = sp_profile_create();
 
-	llsim_sp_unit = llsim_register_unit("sp", sp_run);
 	llsim_ur = llsim_allocate_registers(llsim_sp_unit, "sp_registers", sizeof(sp_registers_t));
-	sp = llsim_malloc(sizeof(sp_t));
-	llsim_sp_unit->private = sp;
 	sp->spro = llsim_ur->old;
 	sp->sprn = llsim_ur->new;
+	sp->ur = llsim_ur;
 
 	sp->srami = llsim_allocate_memory(llsim_sp_unit, "srami", 32, SP_SRAM_HEIGHT, 0);
-	sp->sramd = llsim_allocate_memory(llsim_sp_unit, "sramd", 32, SP_SRAM_HEIGHT, 0);
+	if (sys) {
+		sp->bus = sys->bus;
+		sp->sramd = sys->bus->mem;
+		sp->dma_master = sys->nr_cores + core;
+		sp->bus_stalls = llsim_register_counter(llsim_sp_unit, "bus_stall_cycles");
+	} else {
+		sp->sramd = llsim_allocate_memory(llsim_sp_unit, "sramd", 32, SP_SRAM_HEIGHT, 0);
+	}
+	if (sp->srami->latency != 1 || sp->sramd->latency != 1) {
+		llsim_printf("sp: the pipeline needs srami and sramd with a latency of 1\n");
+		llsim_abort();
+	}
+	// the DMA gets the second port of a dual port sramd of its own
+	sp->dma_port = !sys && sp->sramd->nr_ports > 1 ? 1 : 0;
+	sp_register_signals(sp);
+
+	sp->counter[SP_CNT_COMMITTED] = llsim_register_counter(llsim_sp_unit, "committed_instructions");
+	sp->counter[SP_CNT_FLUSHES] = llsim_register_counter(llsim_sp_unit, "flushes");
+	sp->counter[SP_CNT_LD_ST_STALLS] = llsim_register_counter(llsim_sp_unit, "ld_after_st_stalls");
+	sp->counter[SP_CNT_DMA_STALLS] = llsim_register_counter(llsim_sp_unit, "dma_stall_cycles");
+	sp->counter[SP_CNT_SRAMI_READS] = sp->srami->reads;
+	sp->counter[SP_CNT_SRAMI_WRITES] = sp->srami->writes;
+	sp->counter[SP_CNT_SRAMD_READS] = sp->sramd->reads;
+	sp->counter[SP_CNT_SRAMD_WRITES] = sp->sramd->writes;
+	sp->dma_wait_log = llsim_register_log(llsim_sp_unit, "dma_wait");
+	sp->dma_left_log = llsim_register_log(llsim_sp_unit, "dma_left");
 	sp_generate_sram_memory_image(sp, program_name);
 
 	sp->start = 1;
+	sp_ff_init(sp);
+
+	// state outside of sp_registers_t that a checkpoint has to carry
+	llsim_register_state(llsim_sp_unit, "inst_cnt", &sp->inst_cnt, sizeof(sp->inst_cnt));
+	llsim_register_state(llsim_sp_unit, "start", &sp->start, sizeof(sp->start));
+	llsim_register_state(llsim_sp_unit, "DMA_Finished", &sp->DMA_Finished, sizeof(sp->DMA_Finished));
+	llsim_register_state(llsim_sp_unit, "DMA_active", &sp->DMA_active, sizeof(sp->DMA_active));
+	llsim_register_state(llsim_sp_unit, "halted", &sp->halted, sizeof(sp->halted));
+	if (sys && core == 0)
+		llsim_register_state(llsim_sp_unit, "running", &sys->running, sizeof(sys->running));
 	
 	// c2v_translate_end
+	return sp;
+}
+
+/*
+ * the single core system, or llsim -n cores: sp0 .. spN-1 with their own
+ * srami and the bus that owns sramd, masters 0 .. N-1 are the pipelines
+ * and N .. 2N-1 their DMAs
+ */
+void sp_init(char *program_name)
+{
+	sp_system_t *sys;
+	int i;
+
+	if (llsim->nr_cores <= 1) {
+		sp_init_core(program_name, NULL, 0);
+		return;
+	}
+	if (llsim->nr_cores > SP_MAX_CORES) {
+		llsim_printf("sp: at most %d cores\n", SP_MAX_CORES);
+		llsim_abort();
+	}
+
+	sys = llsim_malloc(sizeof(sp_system_t));
+	sys->nr_cores = llsim->nr_cores;
+	sys->running = sys->nr_cores;
+	// units run in the reverse order of registration, the bus after the cores
+	sys->bus = sp_bus_create("bus", "sramd", SP_SRAM_HEIGHT, 2 * sys->nr_cores,
+				 llsim->arbiter == LLSIM_ARBITER_PRIORITY ? SP_BUS_PRIORITY : SP_BUS_ROUND_ROBIN);
+	for (i = sys->nr_cores - 1; i >= 0; i--)
+		sys->core[i] = sp_init_core(program_name, sys, i);
 }
 
 
-void habdle_src0(llsim_memory_t* sramd, sp_registers_t* sprn, sp_registers_t* spro)
+void habdle_src0(sp_t* sp, sp_registers_t* sprn, sp_registers_t* spro)
 {
     int opcode = spro->exec1_opcode;
 
@@ -609,7 +1457,7 @@ void habdle_src0(llsim_memory_t* sramd, sp_registers_t* sprn, sp_registers_t* sp
         spro->exec1_dst == spro->dec1_src0)
     {
         // read after write MEMORY bypass
-        sprn->exec0_alu0 = llsim_mem_extract_dataout(sramd, 31, 0);
+        sprn->exec0_alu0 = sp_dmem_dataout(sp);
     }
     else if (spro->exec1_active && spro->dec1_src0 == spro->exec1_dst &&
         (opcode == ADD || opcode == SUB || opcode == LSF || opcode == RSF || opcode == AND || opcode == OR ||
@@ -631,7 +1479,7 @@ void habdle_src0(llsim_memory_t* sramd, sp_registers_t* sprn, sp_registers_t* sp
     }
 }
 
-void habdle_src1(llsim_memory_t* sramd, sp_registers_t* sprn, sp_registers_t* spro)
+void habdle_src1(sp_t* sp, sp_registers_t* sprn, sp_registers_t* spro)
 {
     int opcode = spro->exec1_opcode;
 
@@ -649,7 +1497,7 @@ void habdle_src1(llsim_memory_t* sramd, sp_registers_t* sprn, sp_registers_t* sp
         spro->dec1_src1 == spro->exec1_dst)
     {
         // read after write MEMORY bypass
-        sprn->exec0_alu1 = llsim_mem_extract_dataout(sramd, 31, 0);
+        sprn->exec0_alu1 = sp_dmem_dataout(sp);
     }
     else if (spro->exec1_active && spro->exec1_dst == spro->dec1_src1 &&
         (opcode == ADD || opcode == SUB || opcode == LSF || opcode == RSF || opcode == AND || opcode == OR ||
@@ -671,24 +1519,24 @@ void habdle_src1(llsim_memory_t* sramd, sp_registers_t* sprn, sp_registers_t* sp
     }
 }
 
-void handle_dec_1_hazards_and_assign_alu0(llsim_memory_t *sramd, sp_registers_t *sprn, sp_registers_t *spro){
+void handle_dec_1_hazards_and_assign_alu0(sp_t *sp, sp_registers_t *sprn, sp_registers_t *spro){
 
-    habdle_src0(sramd, sprn, spro);
-    habdle_src1(sramd, sprn, spro);
+    habdle_src0(sp, sprn, spro);
+    habdle_src1(sp, sprn, spro);
 
     if (spro->dec1_opcode == LHI) // LHI opcode treatment
         sprn->exec0_alu1 = spro->dec1_immediate;
 }
 
 
-void handle_exec_0_hazards(llsim_memory_t *sramd, sp_registers_t *spro, int* alu_0, int* alu_1, int opcode){
+void handle_exec_0_hazards(sp_t *sp, sp_registers_t *spro, int* alu_0, int* alu_1, int opcode){
     //Handle alu_0
     if (spro->exec0_src0 != 0 && spro->exec0_src0 != 1) 
     {
         if (opcode == LD && spro->exec1_active && spro->exec0_src0 == spro->exec1_dst)
         {
             // read after write MEMORY bypass
-            *alu_0 = llsim_mem_extract_dataout(sramd, 31, 0);
+            *alu_0 = sp_dmem_dataout(sp);
         }
         else if (spro->exec1_active && spro->exec1_dst == spro->exec0_src0 &&
             (opcode == ADD || opcode == SUB || opcode == AND || opcode == OR || opcode == XOR ||
@@ -711,7 +1559,7 @@ void handle_exec_0_hazards(llsim_memory_t *sramd, sp_registers_t *spro, int* alu
         if (opcode == LD && spro->exec1_active && spro->exec1_dst == spro->exec0_src1)
         {
             // read after write MEMORY bypass
-            *alu_1 = llsim_mem_extract_dataout(sramd, 31, 0);
+            *alu_1 = sp_dmem_dataout(sp);
         }
         else if (spro->exec1_active && spro->exec1_dst == spro->exec0_src1 &&
             (opcode == ADD || opcode == SUB || opcode == AND || opcode == OR || opcode == XOR ||
@@ -729,7 +1577,7 @@ void handle_exec_0_hazards(llsim_memory_t *sramd, sp_registers_t *spro, int* alu
     }
 }
 
-int execute_exec0(llsim_memory_t *sramd, sp_registers_t *spro, int alu_0, int alu_1){
+int execute_exec0(sp_t *sp, sp_registers_t *spro, int alu_0, int alu_1){
     int alu_out = 0;
 
     if (spro->exec0_opcode == ADD)
@@ -749,7 +1597,7 @@ int execute_exec0(llsim_memory_t *sramd, sp_registers_t *spro, int alu_0, int al
     else if (spro->exec0_opcode ==LHI)
         alu_out = (alu_0 & 65535)| (alu_1<<16);
     else if (spro->exec0_opcode == LD)
-        llsim_mem_read(sramd, alu_1 & 65535);
+        sp_dmem_read(sp, alu_1 & 65535);
     else if (spro->exec0_opcode == JLT)
         alu_out = (alu_0 < alu_1) ? 1 : 0;
     else if (spro->exec0_opcode == JLE)
@@ -836,22 +1684,35 @@ void handle_DMA(sp_t *sp, int memory_busy){
     switch (spro->DMA_state) 
     {
         case DMA_IDLE:
-            if (DMA_active && !memory_busy) {
+            if (sp->DMA_active && !memory_busy) {
                 sprn->DMA_state = DMA_READ;
                 sprn->DMA_busy = 1;
             }
             else
+            {
+                if (sp->DMA_active)
+                    llsim_counter_inc(sp->counter[SP_CNT_DMA_STALLS]);
                 sprn->DMA_state = DMA_IDLE;
+            }
             break;
 
         case DMA_READ:
-            llsim_mem_read(sp->sramd, spro->DMA_curr_src_addr);
+            if (sp_dma_blocked(sp, spro->DMA_curr_src_addr))
+                break;
+            sp_dma_read(sp, spro->DMA_curr_src_addr);
             sprn->DMA_state = DMA_WRITE;
             break;
 
         case DMA_WRITE:
-            llsim_mem_set_datain(sp->sramd, llsim_mem_extract_dataout(sp->sramd, 31, 0), 31, 0);
-            llsim_mem_write(sp->sramd, spro->DMA_curr_dest_addr);
+            // held back, the word read is gone by the next clock: read it
+            // again. the bus keeps it for its master, so it just waits there.
+            if (sp_dma_blocked(sp, spro->DMA_curr_dest_addr))
+            {
+                if (!sp->bus)
+                    sprn->DMA_state = DMA_READ;
+                break;
+            }
+            sp_dma_write(sp, spro->DMA_curr_dest_addr, sp_dma_dataout(sp));
 
             sprn->DMA_num_of_operations_left = spro->DMA_num_of_operations_left - 1;
             sprn->DMA_curr_dest_addr = spro->DMA_curr_dest_addr + 1;
@@ -861,7 +1722,7 @@ void handle_DMA(sp_t *sp, int memory_busy){
             {
                 sprn->DMA_busy = 0;
                 sprn->DMA_state = DMA_IDLE;
-                DMA_active = 0;
+                sp->DMA_active = 0;
             }
             else 
             {
@@ -877,74 +1738,74 @@ void handle_DMA(sp_t *sp, int memory_busy){
 
 void inst_trace_print(sp_t* sp)
 {
-    fprintf(inst_trace_fp, "\n");
-    fprintf(inst_trace_fp, "--- instruction %d (%04x) @ PC %d (%04i) -----------------------------------------------------------\n",
+    fprintf(sp->inst_trace_fp, "\n");
+    fprintf(sp->inst_trace_fp, "--- instruction %d (%04x) @ PC %d (%04i) -----------------------------------------------------------\n",
             sp->inst_cnt, sp->inst_cnt, sp->spro->exec1_pc, sp->spro->exec1_pc);
-    fprintf(inst_trace_fp, "pc = %04d, inst = %08x, opcode = %d (%s), dst = %d, src0 = %d, src1 = %d, immediate = %08x\n",
+    fprintf(sp->inst_trace_fp, "pc = %04d, inst = %08x, opcode = %d (%s), dst = %d, src0 = %d, src1 = %d, immediate = %08x\n",
             sp->spro->exec1_pc, sp->spro->exec1_inst, sp->spro->exec1_opcode, opcode_name[sp->spro->exec1_opcode],
             sp->spro->exec1_dst, sp->spro->exec1_src0, sp->spro->exec1_src1, sbs(sp->spro->exec1_inst, 15, 0));
-    fprintf(inst_trace_fp, "r[0] = %08x r[1] = %08x r[2] = %08x r[3] = %08x \n",
+    fprintf(sp->inst_trace_fp, "r[0] = %08x r[1] = %08x r[2] = %08x r[3] = %08x \n",
             0, sp->spro->exec1_immediate, sp->spro->r[2], sp->spro->r[3]);
-    fprintf(inst_trace_fp, "r[4] = %08x r[5] = %08x r[6] = %08x r[7] = %08x \n",
+    fprintf(sp->inst_trace_fp, "r[4] = %08x r[5] = %08x r[6] = %08x r[7] = %08x \n",
             sp->spro->r[4], sp->spro->r[5], sp->spro->r[6], sp->spro->r[7]);
-    fprintf(inst_trace_fp, "\n");
+    fprintf(sp->inst_trace_fp, "\n");
 
     switch (sp->spro->exec1_opcode)
     {
         case ADD:
-            fprintf(inst_trace_fp, ">>>> EXEC: R[%d] = %d ADD %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: R[%d] = %d ADD %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
             break;
         case SUB:
-            fprintf(inst_trace_fp, ">>>> EXEC: R[%d] = %d SUB %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: R[%d] = %d SUB %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
             break;
         case AND:
-            fprintf(inst_trace_fp, ">>>> EXEC: R[%d] = %d AND %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: R[%d] = %d AND %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
             break;
         case OR:
-            fprintf(inst_trace_fp, ">>>> EXEC: R[%d] = %d OR %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: R[%d] = %d OR %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
             break;
         case XOR:
-            fprintf(inst_trace_fp, ">>>> EXEC: R[%d] = %d XOR %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: R[%d] = %d XOR %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
             break;
         case LHI:
-            fprintf(inst_trace_fp, ">>>> EXEC: R[%d][31:16] = 0x%04x <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_immediate & 65535);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: R[%d][31:16] = 0x%04x <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_immediate & 65535);
             break;
         case LSF:
-            fprintf(inst_trace_fp, ">>>> EXEC: R[%d] = %d LSF %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: R[%d] = %d LSF %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
             break;
         case RSF:
-            fprintf(inst_trace_fp, ">>>> EXEC: R[%d] = %d RSF %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: R[%d] = %d RSF %d <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu0, sp->spro->exec1_alu1);
             break;
         case LD:
-            fprintf(inst_trace_fp, ">>>> EXEC: R[%d] = MEM[%d] = %08x <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu1,
-                    llsim_mem_extract_dataout(sp->sramd, 31, 0));
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: R[%d] = MEM[%d] = %08x <<<<\n", sp->spro->exec1_dst, sp->spro->exec1_alu1,
+                    sp_dmem_dataout(sp));
             break;
         case ST:
-            fprintf(inst_trace_fp, ">>>> EXEC: MEM[%d] = R[%d] = %08x <<<<\n", sp->spro->exec1_alu1, sp->spro->exec1_src0, sp->spro->exec1_alu0);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: MEM[%d] = R[%d] = %08x <<<<\n", sp->spro->exec1_alu1, sp->spro->exec1_src0, sp->spro->exec1_alu0);
             break;
         case JIN:
-            fprintf(inst_trace_fp, ">>>> EXEC: JIN %d <<<<\n", sp->spro->exec1_alu0 & 65535);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: JIN %d <<<<\n", sp->spro->exec1_alu0 & 65535);
             break;
         case HLT:
-            fprintf(inst_trace_fp, ">>>> EXEC: HALT at PC %04x<<<<\n", sp->spro->exec1_pc);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: HALT at PC %04x<<<<\n", sp->spro->exec1_pc);
             break;
         case JLT:
-            fprintf(inst_trace_fp, ">>>> EXEC: JLT %d, %d, %d <<<<\n", sp->spro->exec1_alu0, sp->spro->exec1_alu1, sp->spro->exec1_aluout ? sp->spro->exec1_immediate & 65535 : sp->spro->exec1_pc + 1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: JLT %d, %d, %d <<<<\n", sp->spro->exec1_alu0, sp->spro->exec1_alu1, sp->spro->exec1_aluout ? sp->spro->exec1_immediate & 65535 : sp->spro->exec1_pc + 1);
             break;
         case JLE:
-            fprintf(inst_trace_fp, ">>>> EXEC: JLE %d, %d, %d <<<<\n", sp->spro->exec1_alu0, sp->spro->exec1_alu1, sp->spro->exec1_aluout ? sp->spro->exec1_immediate & 65535 : sp->spro->exec1_pc + 1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: JLE %d, %d, %d <<<<\n", sp->spro->exec1_alu0, sp->spro->exec1_alu1, sp->spro->exec1_aluout ? sp->spro->exec1_immediate & 65535 : sp->spro->exec1_pc + 1);
             break;
         case JEQ:
-            fprintf(inst_trace_fp, ">>>> EXEC: JEQ %d, %d, %d <<<<\n", sp->spro->exec1_alu0, sp->spro->exec1_alu1, sp->spro->exec1_aluout ? sp->spro->exec1_immediate & 65535 : sp->spro->exec1_pc + 1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: JEQ %d, %d, %d <<<<\n", sp->spro->exec1_alu0, sp->spro->exec1_alu1, sp->spro->exec1_aluout ? sp->spro->exec1_immediate & 65535 : sp->spro->exec1_pc + 1);
             break;
         case JNE:
-            fprintf(inst_trace_fp, ">>>> EXEC: JNE %d, %d, %d <<<<\n", sp->spro->exec1_alu0, sp->spro->exec1_alu1, sp->spro->exec1_aluout ? sp->spro->exec1_immediate & 65535 : sp->spro->exec1_pc + 1);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: JNE %d, %d, %d <<<<\n", sp->spro->exec1_alu0, sp->spro->exec1_alu1, sp->spro->exec1_aluout ? sp->spro->exec1_immediate & 65535 : sp->spro->exec1_pc + 1);
             break;
         case CPY: 
-            fprintf(inst_trace_fp, ">>>> EXEC: CPY from address %04x to adress %04x with length of %d words <<<", sp->spro->DMA_curr_src_addr, sp->spro->DMA_curr_dest_addr, sp->spro->DMA_num_of_operations_left);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: CPY from address %04x to adress %04x with length of %d words <<<", sp->spro->DMA_curr_src_addr, sp->spro->DMA_curr_dest_addr, sp->spro->DMA_num_of_operations_left);
             break;
         case ASK: 
-            fprintf(inst_trace_fp, ">>>> EXEC: ASK result saved to register %d <<<<", sp->spro->exec1_dst);
+            fprintf(sp->inst_trace_fp, ">>>> EXEC: ASK result saved to register %d <<<<", sp->spro->exec1_dst);
             break;
         default:
             break;
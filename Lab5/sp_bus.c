@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "llsim.h"
+#include "sp_bus.h"
+
+/*
+ * a write that would hit the entry of a write already granted for the
+ * same clock
+ */
+static int sp_bus_conflict(sp_bus_master_t *p, int *writes, int nr_writes)
+{
+	int i;
+
+	if (!p->req_write)
+		return 0;
+	for (i = 0; i < nr_writes; i++)
+		if (writes[i] == p->req_addr)
+			return 1;
+	return 0;
+}
+
+static void sp_bus_arbitrate(sp_bus_t *bus)
+{
+	int writes[LLSIM_MEM_MAX_PORTS];
+	int i, m, first, last = -1, granted = 0, nr_writes = 0;
+	unsigned int mask = 0;
+	sp_bus_master_t *p;
+
+	first = bus->arbiter == SP_BUS_ROUND_ROBIN ? bus->next : 0;
+	for (i = 0; i < bus->nr_masters; i++) {
+		m = (first + i) % bus->nr_masters;
+		p = &bus->master[m];
+		p->want = p->req;
+		p->grant = 0;
+		if (!p->req)
+			continue;
+		p->req = 0;
+		llsim_counter_inc(bus->requests);
+		if (granted == bus->mem->nr_ports || sp_bus_conflict(p, writes, nr_writes)) {
+			llsim_counter_inc(bus->denials);
+			continue;
+		}
+		if (p->req_write)
+			writes[nr_writes++] = p->req_addr;
+		p->grant = 1;
+		granted++;
+		last = m;
+		mask |= 1U << m;
+	}
+	if (last >= 0)
+		bus->next = (last + 1) % bus->nr_masters;
+	llsim_log_value(bus->grants, mask);
+}
+
+/*
+ * the grants of the recording, in the order the arbiter would have given
+ * them for next to come out the same
+ */
+static void sp_bus_replay(sp_bus_t *bus)
+{
+	unsigned int mask = llsim_log_value(bus->grants, 0);
+	int i, m, first, last = -1;
+	sp_bus_master_t *p;
+
+	first = bus->arbiter == SP_BUS_ROUND_ROBIN ? bus->next : 0;
+	for (i = 0; i < bus->nr_masters; i++) {
+		m = (first + i) % bus->nr_masters;
+		p = &bus->master[m];
+		p->want = p->req;
+		p->grant = (mask >> m) & 1;
+		llsim_assert(!p->grant || p->req, "ERROR: replay diverged: %s granted master %d, it has no request\n",
+			     bus->grants->name, m);
+		if (!p->req)
+			continue;
+		p->req = 0;
+		llsim_counter_inc(bus->requests);
+		if (!p->grant) {
+			llsim_counter_inc(bus->denials);
+			continue;
+		}
+		last = m;
+	}
+	if (last >= 0)
+		bus->next = (last + 1) % bus->nr_masters;
+}
+
+static void sp_bus_run(llsim_unit_t *unit)
+{
+	sp_bus_t *bus = (sp_bus_t *) unit->private;
+	sp_bus_master_t *p;
+	int m, port = 0;
+
+	if (llsim->reset) {
+		memset(bus->master, 0, sizeof(bus->master));
+		for (m = 0; m < bus->nr_masters; m++)
+			bus->master[m].port = -1;
+		bus->next = 0;
+		return;
+	}
+
+	// the accesses of this clock take the ports in master order
+	for (m = 0; m < bus->nr_masters; m++) {
+		p = &bus->master[m];
+		if (p->read) {
+			llsim_mem_port_read(bus->mem, port, p->addr);
+			p->port = port++;
+		} else if (p->write) {
+			llsim_mem_port_set_datain(bus->mem, port, p->datain, 31, 0);
+			llsim_mem_port_write(bus->mem, port++, p->addr);
+		}
+		p->read = 0;
+		p->write = 0;
+	}
+
+	if (llsim_log_replaying())
+		sp_bus_replay(bus);
+	else
+		sp_bus_arbitrate(bus);
+}
+
+static void sp_bus_free(llsim_unit_t *unit)
+{
+	free(unit->private);
+	unit->private = NULL;
+}
+
+sp_bus_t *sp_bus_create(char *name, char *mem_name, int height, int nr_masters, int arbiter)
+{
+	llsim_unit_t *unit;
+	sp_bus_t *bus;
+
+	llsim_assert(nr_masters >= 1 && nr_masters <= SP_BUS_MAX_MASTERS, "ERROR: bus %s: %d masters not supported",
+		     name, nr_masters);
+	unit = llsim_register_unit(name, sp_bus_run);
+	bus = llsim_malloc(sizeof(sp_bus_t));
+	unit->private = bus;
+	unit->free = sp_bus_free;
+
+	bus->mem = llsim_allocate_memory(unit, mem_name, 32, height, 0);
+	llsim_assert(bus->mem->nr_banks == 1, "ERROR: bus %s: memory %s must have one bank", name, mem_name);
+	bus->arbiter = arbiter;
+	bus->nr_masters = nr_masters;
+
+	bus->requests = llsim_register_counter(unit, "requests");
+	bus->denials = llsim_register_counter(unit, "denials");
+	bus->grants = llsim_register_log(unit, "grants");
+	llsim_register_state(unit, "masters", bus->master, sizeof(bus->master));
+	llsim_register_state(unit, "next", &bus->next, sizeof(bus->next));
+	return bus;
+}
+
+/*
+ * called by master m first thing in its clock
+ */
+void sp_bus_begin(sp_bus_t *bus, int m)
+{
+	sp_bus_master_t *p = &bus->master[m];
+
+	if (p->port < 0)
+		return;
+	p->data = llsim_mem_port_extract_dataout(bus->mem, p->port, 31, 0);
+	p->port = -1;
+}
+
+void sp_bus_read(sp_bus_t *bus, int m, int addr)
+{
+	sp_bus_master_t *p = &bus->master[m];
+
+	llsim_assert(p->grant && !p->read && !p->write, "ERROR: bus master %d reads without a grant", m);
+	p->read = 1;
+	p->addr = addr;
+}
+
+void sp_bus_write(sp_bus_t *bus, int m, int addr, int val)
+{
+	sp_bus_master_t *p = &bus->master[m];
+
+	llsim_assert(p->grant && !p->read && !p->write, "ERROR: bus master %d writes without a grant", m);
+	p->write = 1;
+	p->addr = addr;
+	p->datain = val;
+}
+
+/*
+ * master m accesses the memory in the next clock, at addr for a write
+ */
+void sp_bus_request(sp_bus_t *bus, int m, int write, int addr)
+{
+	sp_bus_master_t *p = &bus->master[m];
+
+	p->req = 1;
+	p->req_write = write;
+	p->req_addr = addr;
+}
@@ -0,0 +1,78 @@
+#ifndef _SP_BUS_H_
+#define _SP_BUS_H_
+
+#include "llsim.h"
+
+/*
+ * shared memory interconnect
+ *
+ * the bus unit owns a memory that several masters share. the arbiter is
+ * a register: at the end of a clock every master has told the bus with
+ * sp_bus_request() whether it accesses the memory in the next clock, and
+ * the bus grants as many requests as the memory has ports, by round robin
+ * or by fixed priority (lower master first). a master that wanted the
+ * memory and didn't get a grant holds its access back. the accesses of a
+ * clock are moved to the memory ports when the bus unit runs, so it has to
+ * run after the masters, and a read is taken by the master with
+ * sp_bus_begin() at the start of its next clock. two writes to the same
+ * entry are never granted in one clock, the memory must have one bank.
+ * the grants go into the event log, on replay the bus takes them from
+ * there instead of arbitrating.
+ */
+#define SP_BUS_MAX_MASTERS	32
+
+#define SP_BUS_ROUND_ROBIN	0
+#define SP_BUS_PRIORITY		1
+
+typedef struct sp_bus_master_s {
+	// access of this clock
+	int read;
+	int write;
+	int addr;
+	int datain;
+
+	// request for the next clock
+	int req;
+	int req_write;
+	int req_addr;
+
+	int want;			// asked for this clock
+	int grant;			// and got it
+	int port;			// read of the last clock, -1 for none
+	int data;			// word it read
+} sp_bus_master_t;
+
+typedef struct sp_bus_s {
+	llsim_memory_t *mem;
+	int arbiter;			// SP_BUS_*
+	int nr_masters;
+	int next;			// round robin: the master first in line
+	sp_bus_master_t master[SP_BUS_MAX_MASTERS];
+
+	llsim_counter_t *requests;
+	llsim_counter_t *denials;	// requests that had to wait
+	llsim_log_chan_t *grants;	// mask of the masters granted, llsim -e
+} sp_bus_t;
+
+/*
+ * register the bus unit with a memory of height words shared by
+ * nr_masters masters
+ */
+sp_bus_t *sp_bus_create(char *name, char *mem_name, int height, int nr_masters, int arbiter);
+
+void sp_bus_begin(sp_bus_t *bus, int m);
+void sp_bus_read(sp_bus_t *bus, int m, int addr);
+void sp_bus_write(sp_bus_t *bus, int m, int addr, int val);
+void sp_bus_request(sp_bus_t *bus, int m, int write, int addr);
+
+static inline int sp_bus_dataout(sp_bus_t *bus, int m)
+{
+	return bus->master[m].data;
+}
+
+// the master wanted the memory in this clock and has to wait
+static inline int sp_bus_blocked(sp_bus_t *bus, int m)
+{
+	return bus->master[m].want && !bus->master[m].grant;
+}
+#endif
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "sp_dump.h"
+
+#define SP_DUMP_LINE		9		// "%08x\n"
+#define SP_DUMP_DELTA_LINE	14		// "%04x %08x\n"
+#define SP_DUMP_MIN_CHUNK	(16 * 1024)	// words worth a thread
+
+// the two digits of every byte value, byte b at sp_dump_hex[2 * b]
+#define SP_DUMP_ROW(h)	h "0" h "1" h "2" h "3" h "4" h "5" h "6" h "7" \
+			h "8" h "9" h "a" h "b" h "c" h "d" h "e" h "f"
+static const char sp_dump_hex[] =
+	SP_DUMP_ROW("0") SP_DUMP_ROW("1") SP_DUMP_ROW("2") SP_DUMP_ROW("3")
+	SP_DUMP_ROW("4") SP_DUMP_ROW("5") SP_DUMP_ROW("6") SP_DUMP_ROW("7")
+	SP_DUMP_ROW("8") SP_DUMP_ROW("9") SP_DUMP_ROW("a") SP_DUMP_ROW("b")
+	SP_DUMP_ROW("c") SP_DUMP_ROW("d") SP_DUMP_ROW("e") SP_DUMP_ROW("f");
+
+typedef struct sp_dump_chunk_s {
+	int *words;
+	int *base;			// NULL for a full dump
+	int addr;			// of the first word
+	int n;
+	char *buf;
+	int len;			// bytes formatted
+} sp_dump_chunk_t;
+
+static inline char *sp_dump_byte(char *p, unsigned int b)
+{
+	memcpy(p, &sp_dump_hex[2 * b], 2);
+	return p + 2;
+}
+
+static inline char *sp_dump_word(char *p, unsigned int w)
+{
+	p = sp_dump_byte(p, w >> 24);
+	p = sp_dump_byte(p, (w >> 16) & 0xff);
+	p = sp_dump_byte(p, (w >> 8) & 0xff);
+	return sp_dump_byte(p, w & 0xff);
+}
+
+static void *sp_dump_format(void *arg)
+{
+	sp_dump_chunk_t *c = arg;
+	char *p = c->buf;
+	int i, addr;
+
+	for (i = 0; i < c->n; i++) {
+		if (c->base && c->words[i] == c->base[i])
+			continue;
+		if (c->base) {
+			addr = c->addr + i;
+			p = sp_dump_byte(p, (addr >> 8) & 0xff);
+			p = sp_dump_byte(p, addr & 0xff);
+			*p++ = ' ';
+		}
+		p = sp_dump_word(p, c->words[i]);
+		*p++ = '\n';
+	}
+	c->len = p - c->buf;
+	return NULL;
+}
+
+// writev() until every byte is out, a file can still take a short write
+static int sp_dump_writev(int fd, struct iovec *iov, int nr)
+{
+	ssize_t len;
+
+	while (nr > 0) {
+		len = writev(fd, iov, nr);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		for (; nr > 0 && (size_t) len >= iov->iov_len; iov++, nr--)
+			len -= iov->iov_len;
+		if (nr > 0) {
+			iov->iov_base = (char *) iov->iov_base + len;
+			iov->iov_len -= len;
+		}
+	}
+	return 0;
+}
+
+int sp_dump_write(FILE *fp, int *words, int *base, int n, int nr_threads)
+{
+	sp_dump_chunk_t chunk[SP_DUMP_MAX_THREADS];
+	pthread_t thread[SP_DUMP_MAX_THREADS];
+	struct iovec iov[SP_DUMP_MAX_THREADS];
+	int line = base ? SP_DUMP_DELTA_LINE : SP_DUMP_LINE;
+	int i, nr, per, ret;
+	char *buf;
+
+	if (nr_threads > n / SP_DUMP_MIN_CHUNK)
+		nr_threads = n / SP_DUMP_MIN_CHUNK;
+	if (nr_threads > SP_DUMP_MAX_THREADS)
+		nr_threads = SP_DUMP_MAX_THREADS;
+	if (nr_threads < 1)
+		nr_threads = 1;
+
+	// every chunk formats into its own part of the buffer, a delta dump
+	// leaves gaps that the iovecs skip
+	buf = malloc((size_t) n * line + 1);
+	if (buf == NULL)
+		return -1;
+	per = (n + nr_threads - 1) / nr_threads;
+	for (nr = 0; nr < nr_threads && nr * per < n; nr++) {
+		chunk[nr].addr = nr * per;
+		chunk[nr].n = n - chunk[nr].addr < per ? n - chunk[nr].addr : per;
+		chunk[nr].words = words + chunk[nr].addr;
+		chunk[nr].base = base ? base + chunk[nr].addr : NULL;
+		chunk[nr].buf = buf + (size_t) chunk[nr].addr * line;
+	}
+
+	// the caller formats the first chunk, a thread that can't start leaves
+	// its chunk to it too
+	for (i = 1; i < nr; i++)
+		if (pthread_create(&thread[i], NULL, sp_dump_format, &chunk[i]))
+			thread[i] = pthread_self();
+	sp_dump_format(&chunk[0]);
+	for (i = 1; i < nr; i++) {
+		if (pthread_equal(thread[i], pthread_self()))
+			sp_dump_format(&chunk[i]);
+		else
+			pthread_join(thread[i], NULL);
+	}
+
+	for (i = 0; i < nr; i++) {
+		iov[i].iov_base = chunk[i].buf;
+		iov[i].iov_len = chunk[i].len;
+	}
+	ret = fflush(fp) ? -1 : sp_dump_writev(fileno(fp), iov, nr);
+	free(buf);
+	return ret;
+}
+
+unsigned long long sp_dump_hash(int *words, int n)
+{
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	unsigned int w;
+	int i, j;
+
+	for (i = 0; i < n; i++)
+		for (j = 0, w = words[i]; j < 4; j++, w >>= 8) {
+			hash ^= w & 0xff;
+			hash *= 0x100000001b3ULL;
+		}
+	return hash;
+}
@@ -0,0 +1,28 @@
+#ifndef _SP_DUMP_H_
+#define _SP_DUMP_H_
+
+#include <stdio.h>
+
+/*
+ * memory dumps
+ *
+ * a full dump is a line of 8 hex digits per word. a delta dump only has
+ * the words that differ from a base image, as a line of the 4 digit
+ * address and the word. the lines are formatted with a table of digit
+ * pairs straight into one buffer, large dumps split over up to nr_threads
+ * threads, and go out in a single write.
+ */
+#define SP_DUMP_MAX_THREADS	16
+
+/*
+ * dump n words to fp, the lines that differ from base when it isn't NULL.
+ * returns 0, or -1 when out of memory or the write fails.
+ */
+int sp_dump_write(FILE *fp, int *words, int *base, int n, int nr_threads);
+
+/*
+ * 64 bit fnv-1a of the little endian bytes of n words, equal dumps have
+ * equal hashes
+ */
+unsigned long long sp_dump_hash(int *words, int n);
+#endif
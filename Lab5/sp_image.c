@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sp_image.h"
+
+#define SP_IMAGE_HEX		1
+#define SP_IMAGE_BLANK		2
+#define SP_IMAGE_NEW_LINE	3
+
+// the bytes of a well formed text image, 0 for any other byte
+static const unsigned char sp_image_class[256] = {
+	['0'] = SP_IMAGE_HEX, ['1'] = SP_IMAGE_HEX, ['2'] = SP_IMAGE_HEX, ['3'] = SP_IMAGE_HEX,
+	['4'] = SP_IMAGE_HEX, ['5'] = SP_IMAGE_HEX, ['6'] = SP_IMAGE_HEX, ['7'] = SP_IMAGE_HEX,
+	['8'] = SP_IMAGE_HEX, ['9'] = SP_IMAGE_HEX,
+	['a'] = SP_IMAGE_HEX, ['b'] = SP_IMAGE_HEX, ['c'] = SP_IMAGE_HEX,
+	['d'] = SP_IMAGE_HEX, ['e'] = SP_IMAGE_HEX, ['f'] = SP_IMAGE_HEX,
+	['A'] = SP_IMAGE_HEX, ['B'] = SP_IMAGE_HEX, ['C'] = SP_IMAGE_HEX,
+	['D'] = SP_IMAGE_HEX, ['E'] = SP_IMAGE_HEX, ['F'] = SP_IMAGE_HEX,
+	[' '] = SP_IMAGE_BLANK, ['\t'] = SP_IMAGE_BLANK, ['\r'] = SP_IMAGE_BLANK,
+	['\n'] = SP_IMAGE_NEW_LINE,
+};
+
+static const unsigned char sp_image_hex[256] = {
+	['1'] = 1, ['2'] = 2, ['3'] = 3, ['4'] = 4, ['5'] = 5, ['6'] = 6, ['7'] = 7, ['8'] = 8, ['9'] = 9,
+	['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15,
+	['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15,
+};
+
+static unsigned int sp_image_word(unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static int sp_image_is_text(unsigned char *p, long size)
+{
+	long i;
+
+	// a bad text image is still text, a binary has control or 8 bit bytes
+	for (i = 0; i < size; i++)
+		if (!sp_image_class[p[i]] && (p[i] < ' ' || p[i] > '~'))
+			return 0;
+	return 1;
+}
+
+static int sp_image_parse_text(char *file_name, unsigned char *p, long size, int *image, int max_words,
+			       char *error, int error_len)
+{
+	unsigned char *end = p + size;
+	int words = 0, line = 1, digits;
+	unsigned int word;
+
+	while (p < end && words < max_words) {
+		while (p < end && sp_image_class[*p] == SP_IMAGE_BLANK)
+			p++;
+		if (p == end)
+			break;
+		if (*p == '\n') {
+			p++;
+			line++;
+			continue;
+		}
+		for (word = digits = 0; p < end && sp_image_class[*p] == SP_IMAGE_HEX; p++, digits++)
+			word = (word << 4) | sp_image_hex[*p];
+		while (p < end && sp_image_class[*p] == SP_IMAGE_BLANK)
+			p++;
+		if (digits == 0 || digits > 8 || (p < end && *p != '\n')) {
+			snprintf(error, error_len, "%s: line %d is not a hex word", file_name, line);
+			return -1;
+		}
+		image[words++] = word;
+	}
+	return words;
+}
+
+static int sp_image_parse_binary(char *file_name, unsigned char *p, long size, int *image, int max_words,
+				 char *error, int error_len)
+{
+	int words;
+
+	if (size % 4) {
+		snprintf(error, error_len, "%s: neither hex words nor 32 bit binary words", file_name);
+		return -1;
+	}
+	for (words = 0; words < max_words && words < size / 4; words++, p += 4)
+		image[words] = sp_image_word(p);
+	return words;
+}
+
+static int sp_image_parse_exe(char *file_name, unsigned char *p, long size, sp_image_t *image, int max_words,
+			      char *error, int error_len)
+{
+	sp_exe_section_t *s;
+	unsigned int version;
+	int i, j;
+
+	if (size < sizeof(sp_exe_header_t)) {
+		snprintf(error, error_len, "%s: truncated header", file_name);
+		return -1;
+	}
+	version = sp_image_word(p + 4);
+	if (version != SP_EXE_VERSION) {
+		snprintf(error, error_len, "%s: version %u not supported", file_name, version);
+		return -1;
+	}
+	image->exe = 1;
+	image->entry = sp_image_word(p + 8);
+	image->nr_sections = sp_image_word(p + 12);
+	if (image->nr_sections < 0 || image->nr_sections > SP_EXE_MAX_SECTIONS ||
+	    sizeof(sp_exe_header_t) + image->nr_sections * sizeof(sp_exe_section_t) > size) {
+		snprintf(error, error_len, "%s: bad section table", file_name);
+		image->nr_sections = 0;
+		return -1;
+	}
+	if (image->entry < 0 || image->entry >= max_words) {
+		snprintf(error, error_len, "%s: entry %d out of memory", file_name, image->entry);
+		return -1;
+	}
+
+	for (i = 0; i < image->nr_sections; i++) {
+		s = &image->section[i];
+		s->type = sp_image_word(p + sizeof(sp_exe_header_t) + i * sizeof(sp_exe_section_t));
+		s->addr = sp_image_word(p + sizeof(sp_exe_header_t) + i * sizeof(sp_exe_section_t) + 4);
+		s->size = sp_image_word(p + sizeof(sp_exe_header_t) + i * sizeof(sp_exe_section_t) + 8);
+		s->offset = sp_image_word(p + sizeof(sp_exe_header_t) + i * sizeof(sp_exe_section_t) + 12);
+		if (!s->type || (s->type & ~(SP_EXE_CODE | SP_EXE_DATA | SP_EXE_BSS)) ||
+		    ((s->type & SP_EXE_BSS) && s->type != SP_EXE_BSS)) {
+			snprintf(error, error_len, "%s: section %d has a bad type %u", file_name, i, s->type);
+			return -1;
+		}
+		if (s->addr >= max_words || s->size > max_words - s->addr) {
+			snprintf(error, error_len, "%s: section %d out of memory", file_name, i);
+			return -1;
+		}
+		if (s->addr + s->size > image->end)
+			image->end = s->addr + s->size;
+		if (s->type == SP_EXE_BSS)
+			continue;
+		if (s->offset > size || s->size > (size - s->offset) / 4) {
+			snprintf(error, error_len, "%s: section %d truncated", file_name, i);
+			return -1;
+		}
+		image->words[i] = (int *) malloc((s->size ? s->size : 1) * sizeof(int));
+		if (image->words[i] == NULL) {
+			snprintf(error, error_len, "%s: out of memory", file_name);
+			return -1;
+		}
+		for (j = 0; j < s->size; j++)
+			image->words[i][j] = sp_image_word(p + s->offset + j * 4);
+	}
+	return 0;
+}
+
+// a text or raw image, one section of code and data
+static int sp_image_parse_flat(char *file_name, unsigned char *p, long size, sp_image_t *image, int max_words,
+			       char *error, int error_len)
+{
+	int *words, n;
+
+	words = (int *) malloc(max_words * sizeof(int));
+	if (words == NULL) {
+		snprintf(error, error_len, "%s: out of memory", file_name);
+		return -1;
+	}
+	if (sp_image_is_text(p, size))
+		n = sp_image_parse_text(file_name, p, size, words, max_words, error, error_len);
+	else
+		n = sp_image_parse_binary(file_name, p, size, words, max_words, error, error_len);
+	if (n <= 0) {
+		free(words);
+		return n;
+	}
+	image->nr_sections = 1;
+	image->section[0].type = SP_EXE_CODE | SP_EXE_DATA;
+	image->section[0].addr = 0;
+	image->section[0].size = n;
+	image->words[0] = words;
+	image->end = n;
+	return 0;
+}
+
+int sp_image_load(char *file_name, sp_image_t *image, int max_words, char *error, int error_len)
+{
+	unsigned char *p = NULL;
+	struct stat st;
+	int fd, ret;
+
+	memset(image, 0, sizeof(*image));
+	fd = open(file_name, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		snprintf(error, error_len, "couldn't open file %s", file_name);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	if (st.st_size) {
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			snprintf(error, error_len, "couldn't map file %s", file_name);
+			close(fd);
+			return -1;
+		}
+	}
+	close(fd);
+
+	if (st.st_size >= 4 && sp_image_word(p) == SP_EXE_MAGIC)
+		ret = sp_image_parse_exe(file_name, p, st.st_size, image, max_words, error, error_len);
+	else
+		ret = sp_image_parse_flat(file_name, p, st.st_size, image, max_words, error, error_len);
+	if (p)
+		munmap(p, st.st_size);
+	if (!ret && !image->end) {
+		snprintf(error, error_len, "%s: empty program", file_name);
+		ret = -1;
+	}
+	if (ret)
+		sp_image_free(image);
+	return ret;
+}
+
+void sp_image_free(sp_image_t *image)
+{
+	int i;
+
+	for (i = 0; i < image->nr_sections; i++) {
+		free(image->words[i]);
+		image->words[i] = NULL;
+	}
+	image->nr_sections = 0;
+}
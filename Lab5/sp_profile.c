@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sp_profile.h"
+
+static char *sp_profile_opcode_name[32] = {"ADD", "SUB", "LSF", "RSF", "AND", "OR", "XOR", "LHI",
+					   "LD", "ST", "U", "U", "U", "U", "U", "U",
+					   "JLT", "JLE", "JEQ", "JNE", "JIN", "U", "U", "U",
+					   "HLT", "CPY", "ASK", "U", "U", "U", "U", "U"};
+
+// one line of a report: a pc, a block or a loop
+typedef struct sp_profile_entry_s {
+	int first, last;
+	long long count;
+	long long cycles;
+} sp_profile_entry_t;
+
+sp_profile_t *sp_profile_create(void)
+{
+	sp_profile_t *prof;
+
+	prof = calloc(1, sizeof(sp_profile_t));
+	if (prof == NULL) {
+		printf("sp: out of memory\n");
+		exit(1);
+	}
+	prof->prev_pc = -1;
+	return prof;
+}
+
+void sp_profile_free(sp_profile_t *prof)
+{
+	free(prof);
+}
+
+static int sp_profile_opcode(sp_profile_t *prof, int pc)
+{
+	return (prof->inst[pc] >> 25) & 31;
+}
+
+// the instruction ends a basic block
+static int sp_profile_is_control(sp_profile_t *prof, int pc)
+{
+	int opcode = sp_profile_opcode(prof, pc);
+
+	return (opcode >= 16 && opcode <= 20) || opcode == 24;
+}
+
+static int sp_profile_is_leader(sp_profile_t *prof, int pc)
+{
+	return prof->count[pc] &&
+		(pc == 0 || !prof->count[pc - 1] || prof->leader[pc] || sp_profile_is_control(prof, pc - 1));
+}
+
+static long long sp_profile_range_cycles(sp_profile_t *prof, int first, int last)
+{
+	long long cycles = 0;
+	int pc;
+
+	for (pc = first; pc <= last; pc++)
+		cycles += prof->cycles[pc];
+	return cycles;
+}
+
+// most cycles first, then by pc
+static int sp_profile_cmp(const void *a, const void *b)
+{
+	const sp_profile_entry_t *x = a, *y = b;
+
+	if (x->cycles != y->cycles)
+		return x->cycles < y->cycles ? 1 : -1;
+	return x->first - y->first;
+}
+
+static double sp_profile_pct(long long part, long long total)
+{
+	return total ? 100.0 * part / total : 0.0;
+}
+
+void sp_profile_report(sp_profile_t *prof, char *program_name, FILE *report, FILE *folded)
+{
+	sp_profile_entry_t *e;
+	long long insts = 0, cycles = 0, cum = 0;
+	int pc, n, i, last, leaf;
+
+	e = malloc(SP_PROFILE_PCS * sizeof(sp_profile_entry_t));
+	if (e == NULL) {
+		printf("sp: out of memory\n");
+		exit(1);
+	}
+	for (pc = 0; pc < SP_PROFILE_PCS; pc++) {
+		insts += prof->count[pc];
+		cycles += prof->cycles[pc];
+	}
+	fprintf(report, "profile of %s: %lld instructions committed in %lld cycles, CPI %.2f\n",
+		program_name, insts, cycles, insts ? (double) cycles / insts : 0.0);
+
+	// hot spots
+	for (pc = n = 0; pc < SP_PROFILE_PCS; pc++) {
+		if (!prof->count[pc])
+			continue;
+		e[n].first = e[n].last = pc;
+		e[n].count = prof->count[pc];
+		e[n].cycles = prof->cycles[pc];
+		n++;
+	}
+	qsort(e, n, sizeof(*e), sp_profile_cmp);
+	fprintf(report, "\nhot spots\n");
+	fprintf(report, "   pc      inst  op           count        cycles       %%    cum%%   CPI\n");
+	for (i = 0; i < n; i++) {
+		cum += e[i].cycles;
+		fprintf(report, " %04x  %08x  %-3s %14lld %13lld  %6.2f  %6.2f  %4.2f\n", e[i].first, prof->inst[e[i].first],
+			sp_profile_opcode_name[sp_profile_opcode(prof, e[i].first)], e[i].count, e[i].cycles,
+			sp_profile_pct(e[i].cycles, cycles), sp_profile_pct(cum, cycles), (double) e[i].cycles / e[i].count);
+	}
+
+	// basic blocks, leaf frames for the flame graph on the way
+	for (pc = n = 0; pc < SP_PROFILE_PCS; pc++) {
+		if (!sp_profile_is_leader(prof, pc))
+			continue;
+		for (last = pc; last + 1 < SP_PROFILE_PCS && !sp_profile_is_control(prof, last) &&
+			     prof->count[last + 1] && !sp_profile_is_leader(prof, last + 1); last++)
+			;
+		e[n].first = pc;
+		e[n].last = last;
+		e[n].count = prof->count[pc];
+		e[n].cycles = sp_profile_range_cycles(prof, pc, last);
+		for (leaf = pc; leaf <= last; leaf++) {
+			if (prof->cycles[leaf])
+				fprintf(folded, "%s;block_%04x;%04x_%s %lld\n", program_name, pc, leaf,
+					sp_profile_opcode_name[sp_profile_opcode(prof, leaf)], prof->cycles[leaf]);
+		}
+		n++;
+	}
+	qsort(e, n, sizeof(*e), sp_profile_cmp);
+	fprintf(report, "\nbasic blocks\n");
+	fprintf(report, " first  last  size          count        cycles       %%   CPI\n");
+	for (i = 0; i < n; i++)
+		fprintf(report, "  %04x  %04x  %4d %14lld %13lld  %6.2f  %4.2f\n", e[i].first, e[i].last,
+			e[i].last - e[i].first + 1, e[i].count, e[i].cycles, sp_profile_pct(e[i].cycles, cycles),
+			e[i].count ? (double) e[i].cycles / (e[i].count * (e[i].last - e[i].first + 1)) : 0.0);
+
+	// loops, from the target of a backward jump to the farthest jump back
+	for (pc = n = 0; pc < SP_PROFILE_PCS; pc++) {
+		if (!prof->loop_iter[pc])
+			continue;
+		e[n].first = pc;
+		e[n].last = prof->loop_end[pc];
+		e[n].count = prof->loop_iter[pc];
+		e[n].cycles = sp_profile_range_cycles(prof, pc, prof->loop_end[pc]);
+		n++;
+	}
+	qsort(e, n, sizeof(*e), sp_profile_cmp);
+	fprintf(report, "\nhot loops\n");
+	fprintf(report, " first  last     iterations        cycles       %%\n");
+	for (i = 0; i < n; i++)
+		fprintf(report, "  %04x  %04x %14lld %13lld  %6.2f\n", e[i].first, e[i].last, e[i].count, e[i].cycles,
+			sp_profile_pct(e[i].cycles, cycles));
+
+	free(e);
+}
@@ -0,0 +1,61 @@
+#ifndef _SP_PROFILE_H_
+#define _SP_PROFILE_H_
+
+#include <stdio.h>
+
+/*
+ * simulated program profiler
+ *
+ * every clock goes to the instruction that commits next: an instruction
+ * is charged the clocks since the previous commit, so stalls, bubbles and
+ * refills after a flush land on the instruction that waited for them and
+ * the cycles of all pcs add up to the clocks simulated. basic blocks and
+ * loops are found from the committed pc stream, a pc is a block leader
+ * when it follows a branch or is reached by a jump, a backward jump
+ * closes a loop from its target to the jump.
+ */
+#define SP_PROFILE_PCS	(64 * 1024)
+
+typedef struct sp_profile_s {
+	long long count[SP_PROFILE_PCS];	// commits
+	long long cycles[SP_PROFILE_PCS];	// clocks charged
+	long long loop_iter[SP_PROFILE_PCS];	// backward jumps to the pc
+	int loop_end[SP_PROFILE_PCS];		// farthest pc jumping back to it
+	int inst[SP_PROFILE_PCS];
+	unsigned char leader[SP_PROFILE_PCS];	// reached by a jump
+	int prev_pc;				// -1 before the first commit
+	long long pending;			// clocks since the previous commit
+} sp_profile_t;
+
+sp_profile_t *sp_profile_create(void);
+void sp_profile_free(sp_profile_t *prof);
+
+static inline void sp_profile_clock(sp_profile_t *prof)
+{
+	prof->pending++;
+}
+
+static inline void sp_profile_commit(sp_profile_t *prof, int pc, int inst)
+{
+	pc &= SP_PROFILE_PCS - 1;
+	prof->count[pc]++;
+	prof->cycles[pc] += prof->pending;
+	prof->pending = 0;
+	prof->inst[pc] = inst;
+	if (prof->prev_pc >= 0 && pc != prof->prev_pc + 1) {
+		prof->leader[pc] = 1;
+		if (pc <= prof->prev_pc) {
+			prof->loop_iter[pc]++;
+			if (prof->loop_end[pc] < prof->prev_pc)
+				prof->loop_end[pc] = prof->prev_pc;
+		}
+	}
+	prof->prev_pc = pc;
+}
+
+/*
+ * the hot spot, basic block and loop report, and the blocks as collapsed
+ * stacks (program;block;instruction cycles) for flame graph tools
+ */
+void sp_profile_report(sp_profile_t *prof, char *program_name, FILE *report, FILE *folded);
+#endif
@@ -0,0 +1,57 @@
+#include <stdio.h>
+
+#include "sp_trace.h"
+
+void sp_cycle_trace_print(FILE *fp, sp_cycle_record_t *rec)
+{
+	int i;
+
+	fprintf(fp, "cycle %d\n", rec->cycle_counter);
+	fprintf(fp, "cycle_counter %08x\n", rec->cycle_counter);
+	for (i = 2; i <= 7; i++)
+		fprintf(fp, "r%d %08x\n", i, rec->r[i - 2]);
+
+	fprintf(fp, "fetch0_active %08x\n", rec->fetch0_active);
+	fprintf(fp, "fetch0_pc %08x\n", rec->fetch0_pc);
+
+	fprintf(fp, "fetch1_active %08x\n", rec->fetch1_active);
+	fprintf(fp, "fetch1_pc %08x\n", rec->fetch1_pc);
+
+	fprintf(fp, "dec0_active %08x\n", rec->dec0_active);
+	fprintf(fp, "dec0_pc %08x\n", rec->dec0_pc);
+	fprintf(fp, "dec0_inst %08x\n", rec->dec0_inst); // 32 bits
+
+	fprintf(fp, "dec1_active %08x\n", rec->dec1_active);
+	fprintf(fp, "dec1_pc %08x\n", rec->dec1_pc); // 16 bits
+	fprintf(fp, "dec1_inst %08x\n", rec->dec1_inst); // 32 bits
+	fprintf(fp, "dec1_opcode %08x\n", rec->dec1_opcode); // 5 bits
+	fprintf(fp, "dec1_src0 %08x\n", rec->dec1_src0); // 3 bits
+	fprintf(fp, "dec1_src1 %08x\n", rec->dec1_src1); // 3 bits
+	fprintf(fp, "dec1_dst %08x\n", rec->dec1_dst); // 3 bits
+	fprintf(fp, "dec1_immediate %08x\n", rec->dec1_immediate); // 32 bits
+
+	fprintf(fp, "exec0_active %08x\n", rec->exec0_active);
+	fprintf(fp, "exec0_pc %08x\n", rec->exec0_pc); // 16 bits
+	fprintf(fp, "exec0_inst %08x\n", rec->exec0_inst); // 32 bits
+	fprintf(fp, "exec0_opcode %08x\n", rec->exec0_opcode); // 5 bits
+	fprintf(fp, "exec0_src0 %08x\n", rec->exec0_src0); // 3 bits
+	fprintf(fp, "exec0_src1 %08x\n", rec->exec0_src1); // 3 bits
+	fprintf(fp, "exec0_dst %08x\n", rec->exec0_dst); // 3 bits
+	fprintf(fp, "exec0_immediate %08x\n", rec->exec0_immediate); // 32 bits
+	fprintf(fp, "exec0_alu0 %08x\n", rec->exec0_alu0); // 32 bits
+	fprintf(fp, "exec0_alu1 %08x\n", rec->exec0_alu1); // 32 bits
+
+	fprintf(fp, "exec1_active %08x\n", rec->exec1_active);
+	fprintf(fp, "exec1_pc %08x\n", rec->exec1_pc); // 16 bits
+	fprintf(fp, "exec1_inst %08x\n", rec->exec1_inst); // 32 bits
+	fprintf(fp, "exec1_opcode %08x\n", rec->exec1_opcode); // 5 bits
+	fprintf(fp, "exec1_src0 %08x\n", rec->exec1_src0); // 3 bits
+	fprintf(fp, "exec1_src1 %08x\n", rec->exec1_src1); // 3 bits
+	fprintf(fp, "exec1_dst %08x\n", rec->exec1_dst); // 3 bits
+	fprintf(fp, "exec1_immediate %08x\n", rec->exec1_immediate); // 32 bits
+	fprintf(fp, "exec1_alu0 %08x\n", rec->exec1_alu0); // 32 bits
+	fprintf(fp, "exec1_alu1 %08x\n", rec->exec1_alu1); // 32 bits
+	fprintf(fp, "exec1_aluout %08x\n", rec->exec1_aluout);
+
+	fprintf(fp, "\n\n\n");
+}
@@ -0,0 +1,77 @@
+#ifndef _SP_TRACE_H_
+#define _SP_TRACE_H_
+
+#include <stdio.h>
+
+/*
+ * binary cycle trace
+ *
+ * a cycle_trace.bin file is a header followed by one fixed size record per
+ * simulated cycle. records are written in host byte order, the decoder
+ * finds a foreign byte order by the header magic and swaps the records.
+ */
+#define SP_CYCLE_TRACE_MAGIC	0x54435053	/* "SPCT" */
+#define SP_CYCLE_TRACE_VERSION	1
+
+typedef struct sp_cycle_trace_header_s {
+	int magic;
+	int version;
+	int record_size;
+	int reserved;
+} sp_cycle_trace_header_t;
+
+/*
+ * one record per cycle, same order as the text trace
+ */
+typedef struct sp_cycle_record_s {
+	int cycle_counter;
+	int r[6]; // r2 .. r7
+
+	int fetch0_active;
+	int fetch0_pc;
+
+	int fetch1_active;
+	int fetch1_pc;
+
+	int dec0_active;
+	int dec0_pc;
+	int dec0_inst;
+
+	int dec1_active;
+	int dec1_pc;
+	int dec1_inst;
+	int dec1_opcode;
+	int dec1_src0;
+	int dec1_src1;
+	int dec1_dst;
+	int dec1_immediate;
+
+	int exec0_active;
+	int exec0_pc;
+	int exec0_inst;
+	int exec0_opcode;
+	int exec0_src0;
+	int exec0_src1;
+	int exec0_dst;
+	int exec0_immediate;
+	int exec0_alu0;
+	int exec0_alu1;
+
+	int exec1_active;
+	int exec1_pc;
+	int exec1_inst;
+	int exec1_opcode;
+	int exec1_src0;
+	int exec1_src1;
+	int exec1_dst;
+	int exec1_immediate;
+	int exec1_alu0;
+	int exec1_alu1;
+	int exec1_aluout;
+} sp_cycle_record_t;
+
+/*
+ * print a record in the cycle_trace.txt format
+ */
+void sp_cycle_trace_print(FILE *fp, sp_cycle_record_t *rec);
+#endif
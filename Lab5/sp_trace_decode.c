@@ -0,0 +1,85 @@
+/*
+ * sp_trace_decode: render a binary cycle trace as cycle_trace.txt
+ *
+ * usage: sp_trace_decode cycle_trace.bin [cycle_trace.txt]
+ */
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "sp_trace.h"
+
+#define RECORDS_PER_READ	4096
+
+// a trace written on a host of the other byte order
+static void swap_words(int *words, size_t n)
+{
+	unsigned int w;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		w = (unsigned int)words[i];
+		words[i] = (int)((w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	FILE *in, *out;
+	sp_cycle_trace_header_t header;
+	sp_cycle_record_t *recs;
+	char *out_name = "cycle_trace.txt";
+	size_t n, i;
+	int swapped = 0;
+
+	if (argc < 2 || argc > 3) {
+		printf("usage: sp_trace_decode cycle_trace.bin [cycle_trace.txt]\n");
+		return 1;
+	}
+	if (argc == 3)
+		out_name = argv[2];
+
+	in = fopen(argv[1], "rb");
+	if (in == NULL) {
+		printf("couldn't open file %s\n", argv[1]);
+		exit(1);
+	}
+	if (fread(&header, sizeof(header), 1, in) != 1) {
+		printf("%s is not a binary cycle trace\n", argv[1]);
+		exit(1);
+	}
+	if (header.magic != SP_CYCLE_TRACE_MAGIC) {
+		swap_words((int *)&header, sizeof(header) / sizeof(int));
+		if (header.magic != SP_CYCLE_TRACE_MAGIC) {
+			printf("%s is not a binary cycle trace\n", argv[1]);
+			exit(1);
+		}
+		swapped = 1;
+	}
+	if (header.version != SP_CYCLE_TRACE_VERSION || header.record_size != sizeof(sp_cycle_record_t)) {
+		printf("%s: unsupported trace version %d (record size %d)\n", argv[1], header.version, header.record_size);
+		exit(1);
+	}
+
+	out = fopen(out_name, "w");
+	if (out == NULL) {
+		printf("couldn't open file %s\n", out_name);
+		exit(1);
+	}
+
+	recs = malloc(RECORDS_PER_READ * sizeof(sp_cycle_record_t));
+	if (recs == NULL) {
+		printf("out of memory\n");
+		exit(1);
+	}
+	while ((n = fread(recs, sizeof(sp_cycle_record_t), RECORDS_PER_READ, in)) > 0) {
+		if (swapped)
+			swap_words((int *)recs, n * sizeof(sp_cycle_record_t) / sizeof(int));
+		for (i = 0; i < n; i++)
+			sp_cycle_trace_print(out, &recs[i]);
+	}
+
+	free(recs);
+	fclose(out);
+	fclose(in);
+	return 0;
+}
@@ -0,0 +1,430 @@
+/*
+ * simulator throughput benchmark
+ *
+ * runs the lab 1 iss, the lab 2 multicycle llsim and the lab 5 pipelined
+ * llsim over their example programs and the long synthetic programs of
+ * long.c, with the trace on and off, and reports the simulated
+ * instructions and cycles per host second, the peak rss and the startup
+ * time (the wall time of halt.bin). every simulation runs in its own
+ * directory under the work directory, the best wall time of the runs is
+ * kept.
+ *
+ * the instruction count of a program is taken from the outputs of its
+ * trace on run: the instructions of trace.txt for the iss, the sim
+ * finished line of inst_trace.txt for lab 2 (whose every instruction is 6
+ * clocks) and counters.csv for lab 5. the trace off run of the iss uses
+ * its null sink (-q).
+ *
+ * the results are written as csv. given a baseline (the results of an
+ * earlier run) every row of at least min instructions is compared with
+ * its baseline row and the benchmark fails when the instructions per
+ * second dropped more than the tolerance.
+ *
+ * usage: bench_driver [-n runs] [-t tolerance] [-m min] [-b baseline.csv] [-o results.csv] [-w work] root
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define BENCH_MAX_ARGS		8
+#define BENCH_MAX_RESULTS	128
+
+typedef struct bench_sim_s bench_sim_t;
+
+struct bench_sim_s {
+	char *name;
+	char *binary;				// relative to the root
+	char *programs;				// relative to the root
+	char *corpus[8];			// programs of the programs directory
+	char *trace_off[BENCH_MAX_ARGS];	// NULL when the trace can't be turned off
+	char *trace_on[BENCH_MAX_ARGS];
+	int (*count)(char *dir, long long *insts, long long *cycles);
+};
+
+typedef struct bench_result_s {
+	char sim[32];
+	char program[64];
+	char trace[8];
+	long long insts;
+	long long cycles;
+	double wall;				// best of the runs, seconds
+	long rss;				// peak of the runs, KB
+} bench_result_t;
+
+static int bench_count_iss(char *dir, long long *insts, long long *cycles);
+static int bench_count_lab2(char *dir, long long *insts, long long *cycles);
+static int bench_count_lab5(char *dir, long long *insts, long long *cycles);
+
+static bench_sim_t bench_sims[] = {
+	{"iss", "bench/iss", "Lab1/Code/Assembly", {"asm", "fibo", "mult", NULL},
+	 {"-q", NULL}, {NULL}, bench_count_iss},
+	{"lab2", "Lab2/Code/llsim", "Lab2/Code/Assembly", {"example", "fibo", "mult", "dma", NULL},
+	 {"-t", "none", NULL}, {"-t", "inst", NULL}, bench_count_lab2},
+	{"lab5", "Lab5/llsim", "Lab5/Assembly_run", {"example", "fibo", "mult", "dma", NULL},
+	 {"-t", "none", "-p", "csv", NULL}, {"-t", "inst", "-p", "csv", NULL}, bench_count_lab5},
+};
+
+#define BENCH_NR_SIMS	(sizeof(bench_sims) / sizeof(bench_sims[0]))
+
+// the synthetic programs, generated into the work directory
+static char *bench_long_programs[] = {"long_alu", "long_mem", "halt", NULL};
+
+static bench_result_t bench_results[BENCH_MAX_RESULTS];
+static int bench_nr_results;
+
+static void bench_usage(void)
+{
+	printf("usage: bench_driver [-n runs] [-t tolerance] [-m min] [-b baseline.csv] [-o results.csv] [-w work] root\n");
+	printf("  -n  runs of every simulation, the best wall time is kept (default 3)\n");
+	printf("  -t  fail when the instructions per second dropped more than tolerance %%\n");
+	printf("      against the baseline (default 10)\n");
+	printf("  -m  compare only programs of at least min instructions (default 100000)\n");
+	printf("  -b  baseline results, no comparison when missing\n");
+	printf("  -o  results (default results.csv)\n");
+	printf("  -w  work directory (default work), must hold the long programs\n");
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_mkdir(char *dir)
+{
+	if (mkdir(dir, 0755) != 0 && access(dir, F_OK) != 0) {
+		printf("bench: couldn't create %s\n", dir);
+		exit(1);
+	}
+}
+
+// runs argv in dir with the output thrown away, returns the wall time
+static double bench_run(char *dir, char **argv, long *rss)
+{
+	struct rusage ru;
+	double start;
+	pid_t pid;
+	int status, fd;
+
+	start = bench_now();
+	pid = fork();
+	if (pid < 0) {
+		printf("bench: fork failed\n");
+		exit(1);
+	}
+	if (pid == 0) {
+		if (chdir(dir) != 0)
+			_exit(127);
+		fd = open("/dev/null", O_WRONLY);
+		if (fd >= 0) {
+			dup2(fd, 1);
+			close(fd);
+		}
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	if (wait4(pid, &status, 0, &ru) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		printf("bench: %s %s failed in %s\n", argv[0], argv[1], dir);
+		exit(1);
+	}
+	*rss = ru.ru_maxrss;
+	return bench_now() - start;
+}
+
+static int bench_count_iss(char *dir, long long *insts, long long *cycles)
+{
+	char path[PATH_MAX], line[256];
+	FILE *fp;
+
+	// the iss counts in 16 bits, count the trace entries instead
+	snprintf(path, sizeof(path), "%s/trace.txt", dir);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return -1;
+	*insts = 0;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (strncmp(line, "--- instruction ", 16) == 0)
+			(*insts)++;
+	}
+	fclose(fp);
+	*cycles = *insts;
+	return 0;
+}
+
+static int bench_count_lab2(char *dir, long long *insts, long long *cycles)
+{
+	char path[PATH_MAX], line[256];
+	int found = 0, pc, n;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/inst_trace.txt", dir);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "sim finished at pc %d, %d instructions", &pc, &n) == 2) {
+			*insts = n;
+			*cycles = 6LL * n;
+			found = 1;
+		}
+	}
+	fclose(fp);
+	return found ? 0 : -1;
+}
+
+static int bench_count_lab5(char *dir, long long *insts, long long *cycles)
+{
+	char path[PATH_MAX], line[256];
+	int found = 0;
+	long long v;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/counters.csv", dir);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "llsim,clock,%lld", &v) == 1) {
+			*cycles = v;
+			found |= 1;
+		}
+		if (sscanf(line, "sp,committed_instructions,%lld", &v) == 1) {
+			*insts = v;
+			found |= 2;
+		}
+	}
+	fclose(fp);
+	return found == 3 ? 0 : -1;
+}
+
+static bench_result_t *bench_add_result(char *sim, char *program, char *trace)
+{
+	bench_result_t *r;
+
+	if (bench_nr_results == BENCH_MAX_RESULTS) {
+		printf("bench: too many results\n");
+		exit(1);
+	}
+	r = &bench_results[bench_nr_results++];
+	memset(r, 0, sizeof(*r));
+	snprintf(r->sim, sizeof(r->sim), "%s", sim);
+	snprintf(r->program, sizeof(r->program), "%s", program);
+	snprintf(r->trace, sizeof(r->trace), "%s", trace);
+	return r;
+}
+
+// one trace mode of a program, runs times
+static bench_result_t *bench_program(bench_sim_t *sim, char *binary, char *bin, char *program, char *trace,
+				     char **args, char *work, int runs)
+{
+	char dir[PATH_MAX], *argv[BENCH_MAX_ARGS + 2];
+	bench_result_t *r;
+	double wall;
+	long rss;
+	int i, n = 0;
+
+	snprintf(dir, sizeof(dir), "%s/%s_%s_%s", work, sim->name, program, trace);
+	bench_mkdir(dir);
+	argv[n++] = binary;
+	for (i = 0; args[i] != NULL; i++)
+		argv[n++] = args[i];
+	argv[n++] = bin;
+	argv[n] = NULL;
+
+	r = bench_add_result(sim->name, program, trace);
+	for (i = 0; i < runs; i++) {
+		wall = bench_run(dir, argv, &rss);
+		if (i == 0 || wall < r->wall)
+			r->wall = wall;
+		if (rss > r->rss)
+			r->rss = rss;
+	}
+	if (strcmp(trace, "on") == 0 && sim->count(dir, &r->insts, &r->cycles) != 0) {
+		printf("bench: no instruction count for %s %s\n", sim->name, program);
+		exit(1);
+	}
+	return r;
+}
+
+static void bench_sim(bench_sim_t *sim, char *root, char *work, int runs)
+{
+	char binary[PATH_MAX], bin[PATH_MAX], *program;
+	bench_result_t *on, *off;
+	int i, nr_corpus;
+
+	snprintf(binary, sizeof(binary), "%s/%s", root, sim->binary);
+	if (access(binary, X_OK) != 0) {
+		printf("bench: no %s simulator at %s\n", sim->name, binary);
+		exit(1);
+	}
+	for (nr_corpus = 0; sim->corpus[nr_corpus] != NULL; nr_corpus++)
+		;
+	for (i = 0; i < nr_corpus || bench_long_programs[i - nr_corpus] != NULL; i++) {
+		if (i < nr_corpus) {
+			program = sim->corpus[i];
+			snprintf(bin, sizeof(bin), "%s/%s/%s.bin", root, sim->programs, program);
+		} else {
+			program = bench_long_programs[i - nr_corpus];
+			snprintf(bin, sizeof(bin), "%s/%s.bin", work, program);
+		}
+		on = bench_program(sim, binary, bin, program, "on", sim->trace_on, work, runs);
+		if (sim->trace_off[0] == NULL)
+			continue;
+		off = bench_program(sim, binary, bin, program, "off", sim->trace_off, work, runs);
+		off->insts = on->insts;
+		off->cycles = on->cycles;
+	}
+}
+
+static double bench_rate(long long n, double wall)
+{
+	return wall > 0 ? n / wall : 0.0;
+}
+
+static void bench_write(char *name)
+{
+	bench_result_t *r;
+	FILE *fp;
+	int i;
+
+	fp = fopen(name, "w");
+	if (fp == NULL) {
+		printf("bench: couldn't open %s\n", name);
+		exit(1);
+	}
+	fprintf(fp, "sim,program,trace,instructions,cycles,wall_s,inst_per_s,cycles_per_s,max_rss_kb\n");
+	for (i = 0; i < bench_nr_results; i++) {
+		r = &bench_results[i];
+		fprintf(fp, "%s,%s,%s,%lld,%lld,%.6f,%.0f,%.0f,%ld\n", r->sim, r->program, r->trace, r->insts, r->cycles,
+			r->wall, bench_rate(r->insts, r->wall), bench_rate(r->cycles, r->wall), r->rss);
+	}
+	fclose(fp);
+}
+
+static void bench_print(void)
+{
+	bench_result_t *r;
+	int i;
+
+	printf("%-5s %-9s %-5s %12s %12s %10s %14s %14s %9s\n", "sim", "program", "trace", "insts", "cycles", "wall s",
+	       "inst/s", "cycles/s", "rss KB");
+	for (i = 0; i < bench_nr_results; i++) {
+		r = &bench_results[i];
+		printf("%-5s %-9s %-5s %12lld %12lld %10.6f %14.0f %14.0f %9ld\n", r->sim, r->program, r->trace, r->insts,
+		       r->cycles, r->wall, bench_rate(r->insts, r->wall), bench_rate(r->cycles, r->wall), r->rss);
+	}
+	for (i = 0; i < bench_nr_results; i++) {
+		r = &bench_results[i];
+		if (strcmp(r->program, "halt") == 0)
+			printf("startup %s trace %s: %.3f ms\n", r->sim, r->trace, r->wall * 1000);
+	}
+}
+
+// returns the number of rows that dropped more than tolerance
+static int bench_compare(char *name, double tolerance, long long min_insts)
+{
+	char line[512], sim[32], program[64], trace[8];
+	double base_rate, rate, change;
+	long long insts;
+	bench_result_t *r;
+	int i, failed = 0;
+	FILE *fp;
+
+	fp = fopen(name, "r");
+	if (fp == NULL) {
+		printf("no baseline %s, nothing compared\n", name);
+		return 0;
+	}
+	printf("\ncompared with %s, tolerance %.1f%%\n", name, tolerance);
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%31[^,],%63[^,],%7[^,],%lld,%*d,%*f,%lf", sim, program, trace, &insts, &base_rate) != 5)
+			continue;
+		if (insts < min_insts || base_rate <= 0)
+			continue;
+		for (i = 0; i < bench_nr_results; i++) {
+			r = &bench_results[i];
+			if (!strcmp(r->sim, sim) && !strcmp(r->program, program) && !strcmp(r->trace, trace))
+				break;
+		}
+		if (i == bench_nr_results) {
+			printf("  %-5s %-9s %-3s missing\n", sim, program, trace);
+			continue;
+		}
+		rate = bench_rate(r->insts, r->wall);
+		change = 100.0 * (rate - base_rate) / base_rate;
+		printf("  %-5s %-9s %-3s %14.0f -> %14.0f inst/s %+7.1f%%%s\n", sim, program, trace, base_rate, rate, change,
+		       change < -tolerance ? "  REGRESSION" : "");
+		if (change < -tolerance)
+			failed++;
+	}
+	fclose(fp);
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	char *baseline = NULL, *results = "results.csv", *work = "work";
+	char root[PATH_MAX], work_path[PATH_MAX];
+	long long min_insts = 100000;
+	double tolerance = 10;
+	int opt, runs = 3, i, failed;
+
+	while ((opt = getopt(argc, argv, "n:t:m:b:o:w:")) != -1) {
+		switch (opt) {
+			case 'n':
+				runs = atoi(optarg);
+				break;
+			case 't':
+				tolerance = atof(optarg);
+				break;
+			case 'm':
+				min_insts = atoll(optarg);
+				break;
+			case 'b':
+				baseline = optarg;
+				break;
+			case 'o':
+				results = optarg;
+				break;
+			case 'w':
+				work = optarg;
+				break;
+			default:
+				bench_usage();
+				return 1;
+		}
+	}
+	if (optind != argc - 1 || runs < 1) {
+		bench_usage();
+		return 1;
+	}
+	// the simulations run in their own directories
+	if (realpath(argv[optind], root) == NULL || realpath(work, work_path) == NULL) {
+		printf("bench: couldn't find %s or %s\n", argv[optind], work);
+		return 1;
+	}
+
+	for (i = 0; i < BENCH_NR_SIMS; i++)
+		bench_sim(&bench_sims[i], root, work_path, runs);
+	bench_write(results);
+	bench_print();
+	if (baseline == NULL)
+		return 0;
+	failed = bench_compare(baseline, tolerance, min_insts);
+	if (failed) {
+		printf("bench: %d throughput regressions\n", failed);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * SP ASM: synthetic benchmark programs
+ *
+ * long_alu.bin - nested alu loop, about 240K instructions
+ * long_mem.bin - load/add/store passes over a 1000 word array, about 200K instructions
+ * halt.bin     - a single HLT, the startup time of a simulator
+ *
+ * the programs use only the instructions of the lab 1 iss, so every
+ * simulator runs them and leaves the same memory image.
+ *
+ * usage: long directory
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ADD 0
+#define SUB 1
+#define LSF 2
+#define RSF 3
+#define AND 4
+#define OR  5
+#define XOR 6
+#define LHI 7
+#define LD 8
+#define ST 9
+#define JLT 16
+#define JLE 17
+#define JEQ 18
+#define JNE 19
+#define JIN 20
+#define HLT 24
+
+#define MEM_SIZE_BITS	(16)
+#define MEM_SIZE	(1 << MEM_SIZE_BITS)
+#define MEM_MASK	(MEM_SIZE - 1)
+unsigned int mem[MEM_SIZE];
+
+int pc = 0;
+
+static void asm_cmd(int opcode, int dst, int src0, int src1, int immediate)
+{
+	int inst;
+
+	inst = ((opcode & 0x1f) << 25) | ((dst & 7) << 22) | ((src0 & 7) << 19) | ((src1 & 7) << 16) | (immediate & 0xffff);
+	mem[pc++] = inst;
+}
+
+static void write_program(char *dir, char *program_name, int last_addr)
+{
+	char path[1024];
+	FILE *fp;
+	int addr;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, program_name);
+	fp = fopen(path, "w");
+	if (fp == NULL) {
+		printf("couldn't open file %s\n", path);
+		exit(1);
+	}
+	for (addr = 0; addr < last_addr; addr++)
+		fprintf(fp, "%08x\n", mem[addr]);
+	fclose(fp);
+}
+
+static void clear_program(void)
+{
+	int addr;
+
+	for (addr = 0; addr < MEM_SIZE; addr++)
+		mem[addr] = 0;
+	pc = 0;
+}
+
+static void assemble_long_alu(char *dir)
+{
+	clear_program();
+	asm_cmd(ADD, 2, 0, 0, 0);		// 0: R2 = 0 (sum)
+	asm_cmd(ADD, 3, 1, 0, 400);		// 1: R3 = 400 (outer count)
+	asm_cmd(ADD, 4, 0, 0, 0);		// 2: R4 = 0 (i)
+	asm_cmd(ADD, 5, 1, 0, 100);		// 3: R5 = 100 (inner count)
+	asm_cmd(ADD, 2, 2, 4, 0);		// 4: R2 += R4
+	asm_cmd(XOR, 6, 2, 4, 0);		// 5: R6 = R2 ^ R4
+	asm_cmd(LSF, 6, 6, 1, 1);		// 6: R6 <<= 1
+	asm_cmd(ADD, 2, 2, 6, 0);		// 7: R2 += R6
+	asm_cmd(ADD, 4, 4, 1, 1);		// 8: R4++
+	asm_cmd(JLT, 0, 4, 5, 4);		// 9: if R4 < R5 jump to 4
+	asm_cmd(SUB, 3, 3, 1, 1);		// 10: R3--
+	asm_cmd(JNE, 0, 3, 0, 2);		// 11: if R3 != 0 jump to 2
+	asm_cmd(ST, 0, 2, 1, 1000);		// 12: mem[1000] = R2
+	asm_cmd(HLT, 0, 0, 0, 0);		// 13: HALT
+	write_program(dir, "long_alu.bin", 1001);
+}
+
+static void assemble_long_mem(char *dir)
+{
+	clear_program();
+	asm_cmd(ADD, 2, 1, 0, 2000);		// 0: R2 = 2000 (array)
+	asm_cmd(ADD, 3, 1, 0, 3000);		// 1: R3 = 3000 (array end)
+	asm_cmd(ST, 0, 2, 2, 0);		// 2: mem[R2] = R2
+	asm_cmd(ADD, 2, 2, 1, 1);		// 3: R2++
+	asm_cmd(JLT, 0, 2, 3, 2);		// 4: if R2 < R3 jump to 2
+	asm_cmd(ADD, 4, 1, 0, 40);		// 5: R4 = 40 (passes)
+	asm_cmd(ADD, 2, 1, 0, 2000);		// 6: R2 = 2000
+	asm_cmd(LD, 5, 0, 2, 0);		// 7: R5 = mem[R2]
+	asm_cmd(ADD, 5, 5, 4, 0);		// 8: R5 += R4
+	asm_cmd(ST, 0, 5, 2, 0);		// 9: mem[R2] = R5
+	asm_cmd(ADD, 2, 2, 1, 1);		// 10: R2++
+	asm_cmd(JLT, 0, 2, 3, 7);		// 11: if R2 < R3 jump to 7
+	asm_cmd(SUB, 4, 4, 1, 1);		// 12: R4--
+	asm_cmd(JNE, 0, 4, 0, 6);		// 13: if R4 != 0 jump to 6
+	asm_cmd(HLT, 0, 0, 0, 0);		// 14: HALT
+	write_program(dir, "long_mem.bin", pc);
+}
+
+static void assemble_halt(char *dir)
+{
+	clear_program();
+	asm_cmd(HLT, 0, 0, 0, 0);		// 0: HALT
+	write_program(dir, "halt.bin", pc);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		printf("usage: long directory\n");
+		return -1;
+	}
+	assemble_long_alu(argv[1]);
+	assemble_long_mem(argv[1]);
+	assemble_halt(argv[1]);
+	return 0;
+}